@@ -3,6 +3,19 @@
 #include "unity.h"
 #include "utest.h"
 #include "gnss.h"
+#include "gnss_track.h"
+#include "gnss_archive.h"
+#include "gnss_codec.h"
+#include "gnss_capture.h"
+#include "gnss_geodesy.h"
+#include "gnss_epoch.h"
+#include "gnss_broadcast.h"
+#include "gnss_ephemeris.h"
+#include "gnss_geofence.h"
+#include "gnss_simplify.h"
+#include "gnss_stationary.h"
+#include "seqlock.h"
+#include <math.h>
 
 using namespace utest::v1;
 
@@ -13,10 +26,69 @@ using namespace utest::v1;
 // How long to wait for a GNSS result
 #define GNSS_WAIT_SECONDS 120
 
+// Archive written by the archive test, needs a mounted file system
+#ifndef GNSS_TEST_ARCHIVE_PATH
+#define GNSS_TEST_ARCHIVE_PATH "/fs/gnss_test"
+#endif
+
+// Capture written by the capture index test, needs a mounted file system
+#ifndef GNSS_TEST_CAPTURE_PATH
+#define GNSS_TEST_CAPTURE_PATH "/fs/gnss_capture"
+#endif
+
 // ----------------------------------------------------------------
 // PRIVATE VARIABLES
 // ----------------------------------------------------------------
 
+// Encoded track
+static uint8_t gTrack[4096];
+static int gTrackLength = 0;
+
+// Archive under test and the records returned by a query
+static GnssArchiveWriter *gpArchiveWriter = NULL;
+static uint32_t gArchiveNext = 0;
+static int gArchiveRecords = 0;
+
+// Receiver output and its compressed form
+static char gCapture[4096];
+static uint8_t gCompressed[2048];
+static int gCompressedLength = 0;
+
+// Large enough that the writer is often caught in the middle of a write
+typedef struct {
+    uint32_t value[256];
+} tSeqLockTest;
+
+// Value published by the seqlock writer thread
+static SeqLock<tSeqLockTest> *gpSeqLock = NULL;
+static volatile bool gSeqLockStop = false;
+
+// GPS subframes 1 to 3 of SV 5, 24 data bits per word in bits 29 to 6
+static const uint32_t gGpsSubframes[3][10] = {
+    {0x22C00000, 0x21FC0100, 0x0BB00000, 0x00000000, 0x00000000,
+     0x00000000, 0x00003D40, 0x0A997D00, 0x003FFD00, 0x3D22FA00},
+    {0x22C00000, 0x21FC2200, 0x0ABECB80, 0x0BB4F080, 0x156FCB80,
+     0x3DB5C080, 0x1D4C21C0, 0x088F6840, 0x03B3D240, 0x197D0000},
+    {0x22C00000, 0x21FC4300, 0x0018B400, 0x0F885E40, 0x3FF4CA00,
+     0x1DCD7C80, 0x054E1240, 0x2580B480, 0x3FE91800, 0x0ABDC900}
+};
+
+// Epochs published by the assembler
+static tGNSS_EPOCH gEpoch;
+static int gEpochCount = 0;
+
+// Fixes kept by the track simplifier
+static tGNSS_SIMPLIFY_POINT *gpSimplifyKept = NULL;
+static int gSimplifyKeptCount = 0;
+
+// Solutions passed by the stationary filter
+static int gStationaryReason = GNSS_STATIONARY_NONE;
+static int gStationaryCount = 0;
+
+// Events of the geofence engine
+static tGNSS_GEOFENCE_EVENT gGeofenceEvent;
+static int gGeofenceEventCount = 0;
+
 // ----------------------------------------------------------------
 // PRIVATE FUNCTIONS
 // ----------------------------------------------------------------
@@ -46,6 +118,132 @@ static void printHex (char * pData, uint32_t lenData)
     }
 }
 
+// Collect the blocks of the track encoder
+static void trackSink(const uint8_t *pBlock, int length)
+{
+    TEST_ASSERT(gTrackLength + length <= (int) sizeof (gTrack));
+    memcpy(gTrack + gTrackLength, pBlock, length);
+    gTrackLength += length;
+}
+
+// Append the blocks of the track encoder to the archive
+static void archiveSink(const uint8_t *pBlock, int length)
+{
+    gpArchiveWriter->append(pBlock, length);
+}
+
+// Check that a query returns consecutive records
+static void archiveQuery(const tGNSS_TRACK_COLUMNS *pColumns, int first, int last)
+{
+    for (int x = first; x < last; x++, gArchiveRecords++) {
+        TEST_ASSERT_EQUAL_UINT32(gArchiveNext, pColumns->itow[x]);
+        gArchiveNext += 1000;
+    }
+}
+
+// Collect the output of the capture encoder
+static void codecSink(const uint8_t *pData, int length)
+{
+    TEST_ASSERT(gCompressedLength + length <= (int) sizeof (gCompressed));
+    memcpy(gCompressed + gCompressedLength, pData, length);
+    gCompressedLength += length;
+}
+
+// Collect the epochs of the assembler
+static void epochSink(const tGNSS_EPOCH *pEpoch)
+{
+    gEpoch = *pEpoch;
+    gEpochCount++;
+}
+
+// Collect the fixes kept by the track simplifier
+static void simplifySink(const tGNSS_SIMPLIFY_POINT *pPoint)
+{
+    gpSimplifyKept[gSimplifyKeptCount++] = *pPoint;
+}
+
+// Distance of a fix to a segment in m, flat earth at the start of the segment
+static double segmentDistance(const tGNSS_SIMPLIFY_POINT *pPoint,
+                              const tGNSS_SIMPLIFY_POINT *pStart, const tGNSS_SIMPLIFY_POINT *pEnd)
+{
+    double scale = cos(pStart->lat * 1e-7 * M_PI / 180);
+    double px = (pPoint->lon - pStart->lon) * scale / 89.83;
+    double py = (pPoint->lat - pStart->lat) / 89.83;
+    double ex = (pEnd->lon - pStart->lon) * scale / 89.83;
+    double ey = (pEnd->lat - pStart->lat) / 89.83;
+    double len2 = ex * ex + ey * ey;
+    double t = (len2 > 0) ? (px * ex + py * ey) / len2 : 0;
+
+    if (t < 0)
+        t = 0;
+    if (t > 1)
+        t = 1;
+    return sqrt((px - t * ex) * (px - t * ex) + (py - t * ey) * (py - t * ey));
+}
+
+// Collect the solutions passed by the stationary filter
+static void stationarySink(const tUBX_NAV_PVT *pPvt, int reason)
+{
+    (void) pPvt;
+    gStationaryReason = reason;
+    gStationaryCount++;
+}
+
+// A valid 3D fix at a distance north of a fixed point
+static void makePvt(tUBX_NAV_PVT *pPvt, uint32_t itow, int32_t north_mm, int32_t speed)
+{
+    memset(pPvt, 0, sizeof (*pPvt));
+    pPvt->itow = itow;
+    pPvt->fixType = 0x03;
+    pPvt->flag1 = 0x01;
+    pPvt->lat = 481234567 + (int32_t)(GNSS_M_TO_UNITS(north_mm) / 1000);
+    pPvt->lon = 163456789;
+    pPvt->speed = speed;
+}
+
+// Collect the geofence events
+static void geofenceSink(const tGNSS_GEOFENCE_EVENT *pEvent)
+{
+    gGeofenceEvent = *pEvent;
+    gGeofenceEventCount++;
+}
+
+// Publish all fields equal to a counter until stopped
+static void seqLockWriter()
+{
+    tSeqLockTest *pValue = new tSeqLockTest;
+
+    for (uint32_t n = 1; !gSeqLockStop; n++) {
+        for (int x = 0; x < 256; x++) {
+            pValue->value[x] = n;
+        }
+        gpSeqLock->write(*pValue);
+    }
+    delete pValue;
+}
+
+// Build a UBX frame, returns its length
+static int makeUbx(char *pBuf, uint8_t cls, uint8_t id, const char *pPayload, int length)
+{
+    uint8_t ca = 0;
+    uint8_t cb = 0;
+
+    pBuf[0] = 0xB5;
+    pBuf[1] = 0x62;
+    pBuf[2] = cls;
+    pBuf[3] = id;
+    pBuf[4] = length & 0xFF;
+    pBuf[5] = length >> 8;
+    memcpy(pBuf + 6, pPayload, length);
+    for (int x = 2; x < length + 6; x++) {
+        ca += pBuf[x];
+        cb += ca;
+    }
+    pBuf[length + 6] = ca;
+    pBuf[length + 7] = cb;
+    return length + 8;
+}
+
 // ----------------------------------------------------------------
 // TESTS
 // ----------------------------------------------------------------
@@ -117,10 +315,17 @@ void test_serial_time() {
     bool gotTime = false;
     char buffer[256];
     int returnCode;
+#ifdef GNSS_FIXED_POINT
+    int32_t latitude;
+    int32_t longitude;
+    int32_t elevation;
+    int32_t speed;
+#else
     double latitude;
     double longitude;
     double elevation;
     double speed;
+#endif
 
     printf("GNSS: powering up and waiting up to %d second(s) for something to happen.\n", GNSS_WAIT_SECONDS);
     pGnss->init();
@@ -151,9 +356,13 @@ void test_serial_time() {
                             ch == 'A')
                         {
                             gotLatLong = true;
+#ifdef GNSS_FIXED_POINT
+                            printf("\nGNSS: location %d %d %c.\n", (int) latitude, (int) longitude, ch);
+#else
                             latitude *= 60000;
                             longitude *= 60000;
                             printf("\nGNSS: location %.5f %.5f %c.\n", latitude, longitude, ch);
+#endif
                         }
                     }
                     else if (_CHECK_TALKER("GGA") || _CHECK_TALKER("GNS"))
@@ -168,19 +377,35 @@ void test_serial_time() {
                             printf("\nGNSS: time is %.6s.", pTimeString);
                         }
 
+#ifdef GNSS_FIXED_POINT
+                        if (pGnss->getNmeaFixed(9, buffer, length, elevation, 1)) // altitude msl [0.1 m]
+                        {
+                            gotElevation = true;
+                            printf("\nGNSS: elevation: %d dm.", (int) elevation);
+                        }
+#else
                         if (pGnss->getNmeaItem(9, buffer, length, elevation)) // altitude msl [m]
                         {
                             gotElevation = true;
                             printf("\nGNSS: elevation: %.1f.", elevation);
                         }
+#endif
                     }
                     else if (_CHECK_TALKER("VTG"))
                     {
+#ifdef GNSS_FIXED_POINT
+                        if (pGnss->getNmeaFixed(7, buffer, length, speed, 1)) // speed [0.1 km/h]
+                        {
+                            gotSpeed = true;
+                            printf("\nGNSS: speed: %d x 0.1 km/h.", (int) speed);
+                        }
+#else
                         if (pGnss->getNmeaItem(7, buffer, length, speed)) // speed [km/h]
                         {
                             gotSpeed = true;
                             printf("\nGNSS: speed: %.1f.", speed);
                         }
+#endif
                     }
                 }
             }
@@ -196,6 +421,768 @@ void test_serial_time() {
     TEST_ASSERT(gotTime);
 }
 
+// Test that a track survives encoding and decoding unchanged
+void test_track() {
+    GnssTrackEncoder encoder(trackSink);
+    tGNSS_TRACK_COLUMNS *pColumns = new tGNSS_TRACK_COLUMNS;
+    tUBX_NAV_PVT pvt;
+    int offset = 0;
+    int records = 0;
+    int length;
+
+    gTrackLength = 0;
+    encoder.set_week(2000);
+    // 1 Hz fixes of a vehicle at about 10 m/s, more than one block
+    for (int x = 0; x < 300; x++) {
+        encoder.add(345600000 + (x * 1000), 481234567 + (x * 650), 163456789 - (x * 720),
+                    250000 + ((x % 7) * 10), 10000 + ((x % 5) * 100));
+    }
+    encoder.flush();
+    printf ("Track of 300 fixes encoded in %d bytes.\n", gTrackLength);
+    TEST_ASSERT(gTrackLength < 300 * 20);
+
+    while (offset < gTrackLength) {
+        length = GnssTrackDecoder::decode(gTrack + offset, gTrackLength - offset, pColumns);
+        TEST_ASSERT(length > 0);
+        TEST_ASSERT_EQUAL_INT(2000, pColumns->week);
+        for (int x = 0; x < pColumns->count; x++, records++) {
+            TEST_ASSERT_EQUAL_UINT32(345600000 + (records * 1000), pColumns->itow[x]);
+            TEST_ASSERT_EQUAL_INT32(481234567 + (records * 650), pColumns->lat[x]);
+            TEST_ASSERT_EQUAL_INT32(163456789 - (records * 720), pColumns->lon[x]);
+            TEST_ASSERT_EQUAL_INT32(250000 + ((records % 7) * 10), pColumns->height[x]);
+            TEST_ASSERT_EQUAL_INT32(10000 + ((records % 5) * 100), pColumns->speed[x]);
+        }
+        offset += length;
+    }
+    TEST_ASSERT_EQUAL_INT(300, records);
+
+    // A corrupted block is rejected, also in the header
+    gTrack[GNSS_TRACK_HEADER_SIZE] ^= 0x01;
+    TEST_ASSERT_EQUAL_INT(-1, GnssTrackDecoder::decode(gTrack, gTrackLength, pColumns));
+    gTrack[GNSS_TRACK_HEADER_SIZE] ^= 0x01;
+    gTrack[4] ^= 0x01;
+    TEST_ASSERT_EQUAL_INT(-1, GnssTrackDecoder::decode(gTrack, gTrackLength, pColumns));
+
+    // Saturday 5 May 2018 23:59:50 UTC is 8 s into GPS week 2000
+    memset(&pvt, 0, sizeof (pvt));
+    pvt.itow = 8000;
+    pvt.year = 2018;
+    pvt.month = 5;
+    pvt.day = 5;
+    pvt.hour = 23;
+    pvt.min = 59;
+    pvt.sec = 50;
+    pvt.valid = 0x03;
+    TEST_ASSERT_EQUAL_INT(1999, GnssTrackDecoder::gps_week(2018, 5, 5));
+    TEST_ASSERT_EQUAL_INT(2000, GnssTrackEncoder::gps_week(&pvt));
+    pvt.itow = 604790000;
+    pvt.hour = 23;
+    pvt.sec = 32;
+    TEST_ASSERT_EQUAL_INT(1999, GnssTrackEncoder::gps_week(&pvt));
+
+    // Fixes without a valid date and time are skipped
+    gTrackLength = 0;
+    pvt.valid = 0x01;
+    encoder.add(&pvt);
+    encoder.flush();
+    TEST_ASSERT_EQUAL_INT(0, gTrackLength);
+
+    delete pColumns;
+}
+
+// Test that the archive continues after a torn append and finds time ranges
+void test_archive() {
+    GnssArchiveWriter *pWriter = new GnssArchiveWriter;
+    GnssArchiveReader *pReader = new GnssArchiveReader;
+    GnssTrackEncoder encoder(archiveSink);
+    char path[GNSS_ARCHIVE_PATH_SIZE];
+    FILE *fp;
+
+    gpArchiveWriter = pWriter;
+    snprintf(path, sizeof (path), "%s.idx", GNSS_TEST_ARCHIVE_PATH);
+    remove(path);
+    remove(GNSS_TEST_ARCHIVE_PATH);
+    if (!pWriter->open(GNSS_TEST_ARCHIVE_PATH)) {
+        delete pWriter;
+        delete pReader;
+        TEST_IGNORE_MESSAGE("No file system for the archive");
+    }
+    // A new archive is empty
+    TEST_ASSERT(pReader->open(GNSS_TEST_ARCHIVE_PATH));
+    TEST_ASSERT_EQUAL_UINT32(0, pReader->blocks());
+    pReader->close();
+
+    encoder.set_week(2000);
+    for (int x = 0; x < 300; x++) {
+        encoder.add(x * 1000, 481234567 + x, 163456789 - x, 250000, 10000);
+    }
+    encoder.flush();
+    pWriter->close();
+
+    // A power loss in the middle of an append
+    fp = fopen(path, "ab");
+    TEST_ASSERT(fp != NULL);
+    fwrite("torn", 1, 4, fp);
+    fclose(fp);
+    fp = fopen(GNSS_TEST_ARCHIVE_PATH, "ab");
+    TEST_ASSERT(fp != NULL);
+    fwrite("unindexed block", 1, 15, fp);
+    fclose(fp);
+
+    TEST_ASSERT(pWriter->open(GNSS_TEST_ARCHIVE_PATH));
+    for (int x = 300; x < 600; x++) {
+        encoder.add(x * 1000, 481234567 + x, 163456789 - x, 250000, 10000);
+    }
+    encoder.flush();
+    pWriter->close();
+    TEST_ASSERT_EQUAL_UINT32(0, pWriter->failed());
+
+    TEST_ASSERT(pReader->open(GNSS_TEST_ARCHIVE_PATH));
+    printf ("Archive of 600 fixes in %u blocks.\n", (unsigned int) pReader->blocks());
+    gArchiveNext = 0;
+    gArchiveRecords = 0;
+    TEST_ASSERT_EQUAL_INT(600, pReader->query(GNSS_ARCHIVE_TIME(2000, 0), GNSS_ARCHIVE_TIME(2000, 599000), archiveQuery));
+    TEST_ASSERT_EQUAL_INT(600, gArchiveRecords);
+    gArchiveNext = 123000;
+    gArchiveRecords = 0;
+    TEST_ASSERT_EQUAL_INT(350, pReader->query(GNSS_ARCHIVE_TIME(2000, 123000), GNSS_ARCHIVE_TIME(2000, 472000), archiveQuery));
+    TEST_ASSERT_EQUAL_INT(350, gArchiveRecords);
+    TEST_ASSERT_EQUAL_INT(0, pReader->query(GNSS_ARCHIVE_TIME(2001, 0), GNSS_ARCHIVE_TIME(2002, 0), archiveQuery));
+    pReader->close();
+
+    delete pWriter;
+    delete pReader;
+}
+
+// Check that two files have the same content
+static bool sameFiles(const char *pPath1, const char *pPath2)
+{
+    FILE *fp1 = fopen(pPath1, "rb");
+    FILE *fp2 = fopen(pPath2, "rb");
+    bool same = (fp1 != NULL) && (fp2 != NULL);
+    char buf1[64];
+    char buf2[64];
+    int n;
+
+    while (same && ((n = fread(buf1, 1, sizeof (buf1), fp1)) > 0)) {
+        same = ((int) fread(buf2, 1, n, fp2) == n) && !memcmp(buf1, buf2, n);
+    }
+    same = same && (fread(buf2, 1, 1, fp2) == 0);
+    if (fp1)
+        fclose(fp1);
+    if (fp2)
+        fclose(fp2);
+    return same;
+}
+
+// Test that the parallel capture index equals the serial one and that
+// the iTOW is found after the version field of the messages that have one
+void test_capture_index() {
+    GnssCaptureIndex *pIndex = new GnssCaptureIndex;
+    tGNSS_CAPTURE_ENTRY e;
+    char serial[GNSS_ARCHIVE_PATH_SIZE];
+    char parallel[GNSS_ARCHIVE_PATH_SIZE];
+    char payload[92];
+    FILE *fp = fopen(GNSS_TEST_CAPTURE_PATH, "wb");
+    int size = 0;
+    uint32_t x;
+
+    if (fp == NULL) {
+        delete pIndex;
+        TEST_IGNORE_MESSAGE("No file system for the capture");
+    }
+    snprintf(serial, sizeof (serial), "%s.idx1", GNSS_TEST_CAPTURE_PATH);
+    snprintf(parallel, sizeof (parallel), "%s.idx4", GNSS_TEST_CAPTURE_PATH);
+
+    // NAV-HPPOSLLH, NAV-SVIN, NAV-PVT and a sentence with a wrong checksum
+    // per epoch, noise in between
+    memset(payload, 0, sizeof (payload));
+    for (x = 0; x < 300; x++) {
+        uint32_t itow = 345600000 + (x * 1000);
+        int length;
+
+        payload[0] = 0x00;                      // version
+        payload[3] = 0x5A;                      // reserved, not part of the iTOW
+        memcpy(payload + 4, &itow, 4);
+        length = makeUbx(gCapture, 0x01, 0x14, payload, 36);
+        length += makeUbx(gCapture + length, 0x01, 0x3B, payload, 40);
+        memset(payload, 0, 8);
+        memcpy(payload, &itow, 4);
+        length += makeUbx(gCapture + length, 0x01, 0x07, payload, sizeof (payload));
+        length += sprintf(gCapture + length, "$GPTXT,01,01,02,%03u*00\r\n", (unsigned int) x);
+        if ((x % 7) == 3) {
+            memcpy(gCapture + length, "\xB5\x62noise", 7);
+            length += 7;
+        }
+        TEST_ASSERT_EQUAL_INT(length, (int) fwrite(gCapture, 1, length, fp));
+        size += length;
+    }
+    fclose(fp);
+
+    TEST_ASSERT_EQUAL_INT(900, GnssCaptureIndex::build(GNSS_TEST_CAPTURE_PATH, serial, 1));
+    TEST_ASSERT_EQUAL_INT(900, GnssCaptureIndex::build(GNSS_TEST_CAPTURE_PATH, parallel, 4, 2 * GNSS_CAPTURE_MSG_SIZE));
+    printf ("Capture of %d bytes indexed serially and in %d chunks.\n", size,
+            (size + 2 * GNSS_CAPTURE_MSG_SIZE - 1) / (2 * GNSS_CAPTURE_MSG_SIZE));
+    TEST_ASSERT(sameFiles(serial, parallel));
+
+    TEST_ASSERT(pIndex->open(GNSS_TEST_CAPTURE_PATH, parallel));
+    TEST_ASSERT_EQUAL_UINT32(900, pIndex->count());
+    for (x = 0; x < pIndex->count(); x++) {
+        TEST_ASSERT(pIndex->entry(x, &e));
+        TEST_ASSERT_EQUAL_UINT32(345600000 + ((x / 3) * 1000), e.time);
+    }
+    x = pIndex->find_epoch(345600000 + 150500);
+    TEST_ASSERT_EQUAL_UINT32(151 * 3, x);
+    TEST_ASSERT(pIndex->entry(x, &e));
+    TEST_ASSERT_EQUAL_UINT8(0x14, e.id);
+    pIndex->close();
+
+    remove(serial);
+    remove(parallel);
+    remove(GNSS_TEST_CAPTURE_PATH);
+    delete pIndex;
+}
+
+// Test that receiver output is restored bit by bit from the compressed form
+void test_codec() {
+    GnssCaptureEncoder encoder(codecSink);
+    GnssCaptureDecoder *pDecoder = new GnssCaptureDecoder;
+    char msg[256];
+    char payload[92];
+    int lengths[64];
+    int count = 0;
+    int size = 0;
+    int offset = 0;
+    int ret;
+    int length;
+
+    gCompressedLength = 0;
+    memset(payload, 0, sizeof (payload));
+    for (int x = 0; x < 20; x++) {
+        // UBX-NAV-PVT moving north east
+        uint32_t itow = 345600000 + (x * 1000);
+        int32_t lon = 163456789 + (x * 720);
+        int32_t lat = 481234567 + (x * 650) + (x % 3);
+        memcpy(payload, &itow, 4);
+        memcpy(payload + 24, &lon, 4);
+        memcpy(payload + 28, &lat, 4);
+        payload[20] = 0x03;
+        payload[23] = 9 + (x % 4);
+        lengths[count] = makeUbx(gCapture + size, 0x01, 0x07, payload, sizeof (payload));
+        size += lengths[count++];
+
+        // GGA with the same position
+        char body[96];
+        uint8_t crc = 0;
+        snprintf(body, sizeof (body), "GPGGA,%06d.00,4807.%05d,N,01620.%05d,E,1,%02d,0.9,%d.5,M,46.9,M,,",
+                 92000 + x, 40734 + (x * 39), 74073 + (x * 43), 9 + (x % 4), 545 + (x % 2));
+        for (char *pCh = body; *pCh; pCh++)
+            crc ^= *pCh;
+        lengths[count] = sprintf(gCapture + size, "$%s*%02X\r\n", body, crc);
+        size += lengths[count++];
+    }
+    // Noise between messages
+    memcpy(gCapture + size, "\xB5\x62noise", 7);
+    lengths[count] = 7;
+    size += lengths[count++];
+    TEST_ASSERT(size <= (int) sizeof (gCapture));
+
+    for (int x = 0, y = 0; x < count; y += lengths[x++])
+        encoder.encode(gCapture + y, ((x & 1) ? GnssParser::NMEA : GnssParser::UBX) | lengths[x]);  // noise falls back to a raw record
+    encoder.flush();
+    printf ("Capture of %d bytes compressed to %d bytes.\n", size, gCompressedLength);
+    TEST_ASSERT(gCompressedLength * 4 < size);
+
+    // The first record is the stream header
+    size = 0;
+    for (int x = 0; offset < gCompressedLength;) {
+        length = pDecoder->decode(gCompressed + offset, gCompressedLength - offset, msg, sizeof (msg), &ret);
+        TEST_ASSERT(length > 0);
+        offset += length;
+        if (ret == 0)
+            continue;
+        TEST_ASSERT_EQUAL_INT(lengths[x], LENGTH(ret));
+        TEST_ASSERT_EQUAL_INT(0, memcmp(gCapture + size, msg, lengths[x]));
+        size += lengths[x++];
+    }
+
+    delete pDecoder;
+}
+
+// Test that UBX-NAV-EOE closes an epoch
+void test_epoch() {
+    GnssSerial *pGnss = new GnssSerial();
+    GnssEpochAssembler assembler(pGnss, GNSS_EPOCH_PVT | GNSS_EPOCH_STATUS);
+    char msg[128];
+    char payload[92];
+    uint32_t itow = 345600000;
+    int length;
+
+    gEpochCount = 0;
+    assembler.attach(epochSink);
+    memset(payload, 0, sizeof (payload));
+    memcpy(payload, &itow, 4);
+    payload[20] = 0x03;
+    length = makeUbx(msg, 0x01, 0x07, payload, sizeof (payload));
+    TEST_ASSERT(assembler.process(msg, GnssParser::UBX | length));
+    TEST_ASSERT_EQUAL_INT(0, gEpochCount);
+
+    // The 4 byte end of epoch, UBX-NAV-STATUS is missing
+    length = makeUbx(msg, 0x01, 0x61, payload, 4);
+    TEST_ASSERT(assembler.process(msg, GnssParser::UBX | length));
+    TEST_ASSERT_EQUAL_INT(1, gEpochCount);
+    TEST_ASSERT_EQUAL_UINT32(itow, gEpoch.itow);
+    TEST_ASSERT_EQUAL_INT(GNSS_EPOCH_PVT, gEpoch.content);
+    TEST_ASSERT(!gEpoch.complete);
+    TEST_ASSERT_EQUAL_INT(3, gEpoch.pvt.fixType);
+    TEST_ASSERT_EQUAL_INT(1, assembler.incomplete_count());
+
+    delete pGnss;
+}
+
+// Test that a reader racing with the writer retries and never sees a torn value
+void test_seqlock() {
+    tSeqLockTest *pValue = new tSeqLockTest;
+    Thread writer(osPriorityBelowNormal, 1024);
+    uint32_t last = 0;
+    int consistent = 0;
+    int busy = 0;
+
+    gpSeqLock = new SeqLock<tSeqLockTest>;
+    gSeqLockStop = false;
+    TEST_ASSERT(!gpSeqLock->read(*pValue));
+
+    writer.start(seqLockWriter);
+    for (int x = 0; x < 500; x++) {
+        if (gpSeqLock->read(*pValue, 2)) {
+            for (int y = 1; y < 256; y++) {
+                TEST_ASSERT_EQUAL_UINT32(pValue->value[0], pValue->value[y]);
+            }
+            TEST_ASSERT(pValue->value[0] >= last);
+            last = pValue->value[0];
+            consistent++;
+        } else {
+            busy++;
+        }
+        // The writer runs meanwhile and is interrupted when the reader wakes up
+        thread_sleep_for(1);
+    }
+    gSeqLockStop = true;
+    writer.join();
+    printf ("%d consistent reads, %d reads found the writer busy.\n", consistent, busy);
+    TEST_ASSERT(consistent > 0);
+    TEST_ASSERT(busy > 0);
+
+    // Once the writer stopped the last value is read
+    TEST_ASSERT(gpSeqLock->read(*pValue, 0));
+    TEST_ASSERT_EQUAL_UINT32(gpSeqLock->sequence(), pValue->value[0]);
+
+    delete gpSeqLock;
+    gpSeqLock = NULL;
+    delete pValue;
+}
+
+// Test that an overrun subscriber counts the lost messages
+void test_broadcast() {
+    GnssBroadcast<4, 32> *pRing = new GnssBroadcast<4, 32>;
+    GnssBroadcast<4, 32>::Subscriber all(pRing);
+    GnssBroadcast<4, 32>::Subscriber nmea(pRing, GNSS_BROADCAST_NMEA);
+    char msg[64];
+    char buf[32];
+    int length;
+    int ret;
+
+    // Ten messages into four slots
+    for (int x = 0; x < 10; x++) {
+        length = sprintf(msg, "$GPTXT,%02d*00\r\n", x);
+        TEST_ASSERT(pRing->publish(NULL, msg, GnssParser::NMEA | length));
+    }
+    TEST_ASSERT_EQUAL_UINT32(10, all.lag());
+
+    // Continues with the oldest message that can't be overwritten by the next publish
+    for (int x = 7; x < 10; x++) {
+        ret = all.get(buf, sizeof (buf));
+        TEST_ASSERT_EQUAL_INT(GnssParser::NMEA, PROTOCOL(ret));
+        sprintf(msg, "$GPTXT,%02d*00\r\n", x);
+        TEST_ASSERT_EQUAL_INT((int) strlen(msg), LENGTH(ret));
+        TEST_ASSERT_EQUAL_INT(0, memcmp(msg, buf, LENGTH(ret)));
+    }
+    TEST_ASSERT_EQUAL_INT(GnssParser::WAIT, all.get(buf, sizeof (buf)));
+    TEST_ASSERT_EQUAL_UINT32(7, all.overflow());
+    TEST_ASSERT_EQUAL_UINT32(0, all.lag());
+
+    // Too large for a slot
+    memset(msg, 'x', 40);
+    TEST_ASSERT(!pRing->publish(NULL, msg, GnssParser::NMEA | 40));
+    TEST_ASSERT_EQUAL_UINT32(1, pRing->dropped());
+    TEST_ASSERT_EQUAL_INT(GnssParser::WAIT, all.get(buf, sizeof (buf)));
+
+    // The second subscriber was overrun the same way
+    length = sprintf(msg, "$GPTXT,%02d*00\r\n", 7);
+    TEST_ASSERT_EQUAL_INT(GnssParser::NMEA | length, nmea.get(buf, sizeof (buf)));
+    TEST_ASSERT_EQUAL_UINT32(7, nmea.overflow());
+
+    delete pRing;
+}
+
+// Test the GPS ephemeris decoding against a known subframe set
+void test_ephemeris() {
+    GnssEphemerisCache *pCache = new GnssEphemerisCache;
+    tUBX_RXM_SFRBX frame;
+    const tGNSS_EPHEMERIS *pEph;
+
+    memset(&frame, 0, sizeof (frame));
+    frame.gnssId = GNSS_ID_GPS;
+    frame.svId = 5;
+    frame.numWords = 10;
+    for (int x = 0; x < 3; x++) {
+        memcpy(frame.dwrd, gGpsSubframes[x], sizeof (gGpsSubframes[x]));
+        TEST_ASSERT_EQUAL_INT((x == 2) ? 1 : 0, pCache->add_sfrbx(&frame));
+    }
+    TEST_ASSERT_EQUAL_INT(1, pCache->count());
+    pEph = pCache->get(GNSS_ID_GPS, 5, 42);
+    TEST_ASSERT(pEph != NULL);
+
+    TEST_ASSERT_EQUAL_INT(187, pEph->week);
+    TEST_ASSERT_EQUAL_INT(0, pEph->health);
+    TEST_ASSERT_EQUAL_INT32(-11, pEph->tgd);
+    TEST_ASSERT_EQUAL_UINT32(417600, pEph->toc);
+    TEST_ASSERT_EQUAL_INT32(-12, pEph->af1);
+    TEST_ASSERT_EQUAL_INT32(-187654, pEph->af0);
+    TEST_ASSERT_EQUAL_INT32(-1234, pEph->crs);
+    TEST_ASSERT_EQUAL_INT32(11987, pEph->deln);
+    TEST_ASSERT_EQUAL_INT32(-1034567890, pEph->M0);
+    TEST_ASSERT_EQUAL_INT32(-2345, pEph->cuc);
+    TEST_ASSERT_EQUAL_UINT32(41234567, pEph->e);
+    TEST_ASSERT_EQUAL_INT32(8765, pEph->cus);
+    TEST_ASSERT_EQUAL_UINT32(2702102345UL, pEph->sqrtA);
+    TEST_ASSERT_EQUAL_UINT32(417600, pEph->toe);
+    TEST_ASSERT_EQUAL_INT32(98, pEph->cic);
+    TEST_ASSERT_EQUAL_INT32(-801234567, pEph->OMG0);
+    TEST_ASSERT_EQUAL_INT32(-45, pEph->cis);
+    TEST_ASSERT_EQUAL_INT32(678901234, pEph->i0);
+    TEST_ASSERT_EQUAL_INT32(5432, pEph->crc);
+    TEST_ASSERT_EQUAL_INT32(1234567890, pEph->omg);
+    TEST_ASSERT_EQUAL_INT32(-23456, pEph->OMGd);
+    TEST_ASSERT_EQUAL_INT32(-567, pEph->idot);
+
+    // The same ephemeris again is not stored twice
+    TEST_ASSERT_EQUAL_INT(0, pCache->add_sfrbx(&frame));
+
+    delete pCache;
+}
+
+// Test the integer NMEA field parsing
+void test_nmea_fixed() {
+    char gga[] = "$GPGGA,092725.00,4717.11399,N,00833.91590,E,1,08,1.01,499.6,M,48.0,M,,*5B\r\n";
+    char gll[] = "$GPGLL,3351.12345,S,15112.54321,W,235959.995,A,A*00\r\n";
+    char odd[] = "$GPXXX,-12.3456,0.0049,abc,,+7*00\r\n";
+    int32_t val;
+
+    TEST_ASSERT(GnssParser::getNmeaFixed(1, gga, sizeof (gga) - 1, val, 3));
+    TEST_ASSERT_EQUAL_INT32(92725000, val);
+    TEST_ASSERT(GnssParser::getNmeaFixed(9, gga, sizeof (gga) - 1, val, 1));
+    TEST_ASSERT_EQUAL_INT32(4996, val);
+    TEST_ASSERT(GnssParser::getNmeaFixed(9, gga, sizeof (gga) - 1, val, 3));
+    TEST_ASSERT_EQUAL_INT32(499600, val);
+    TEST_ASSERT(GnssParser::getNmeaAngle(2, gga, sizeof (gga) - 1, val));
+    TEST_ASSERT_EQUAL_INT32(472852332, val);
+    TEST_ASSERT(GnssParser::getNmeaAngle(4, gga, sizeof (gga) - 1, val));
+    TEST_ASSERT_EQUAL_INT32(85652650, val);
+    TEST_ASSERT(GnssParser::getNmeaAngle(1, gll, sizeof (gll) - 1, val));
+    TEST_ASSERT_EQUAL_INT32(-338520575, val);
+    TEST_ASSERT(GnssParser::getNmeaAngle(3, gll, sizeof (gll) - 1, val));
+    TEST_ASSERT_EQUAL_INT32(-1512090535, val);
+    TEST_ASSERT(GnssParser::getNmeaFixed(5, gll, sizeof (gll) - 1, val, 2));
+    TEST_ASSERT_EQUAL_INT32(23596000, val);
+
+    // Rounding, signs and invalid fields
+    TEST_ASSERT(GnssParser::getNmeaFixed(1, odd, sizeof (odd) - 1, val, 2));
+    TEST_ASSERT_EQUAL_INT32(-1235, val);
+    TEST_ASSERT(GnssParser::getNmeaFixed(2, odd, sizeof (odd) - 1, val, 3));
+    TEST_ASSERT_EQUAL_INT32(5, val);
+    TEST_ASSERT(GnssParser::getNmeaFixed(5, odd, sizeof (odd) - 1, val, 0));
+    TEST_ASSERT_EQUAL_INT32(7, val);
+    TEST_ASSERT_FALSE(GnssParser::getNmeaFixed(3, odd, sizeof (odd) - 1, val, 0));
+    TEST_ASSERT_FALSE(GnssParser::getNmeaFixed(4, odd, sizeof (odd) - 1, val, 0));
+    TEST_ASSERT_FALSE(GnssParser::getNmeaAngle(3, odd, sizeof (odd) - 1, val));
+
+    TEST_ASSERT_EQUAL_INT32(16384, gnss_cos_q14(0));
+    TEST_ASSERT_EQUAL_INT32(8192, gnss_cos_q14(600000000));
+    TEST_ASSERT_EQUAL_INT32(11585, gnss_cos_q14(-450000000));
+    TEST_ASSERT_EQUAL_INT32(0, gnss_cos_q14(900000000));
+
+#ifndef GNSS_FIXED_POINT
+    // Same results as the floating point parsing
+    double angle;
+    char r8[8];
+    TEST_ASSERT(GnssParser::getNmeaAngle(3, gll, sizeof (gll) - 1, angle));
+    TEST_ASSERT_EQUAL_INT32((int32_t) floor(angle * 1e7 + 0.5), -1512090535);
+    for (int x = 0; x <= 900; x++)
+        TEST_ASSERT_INT32_WITHIN(1, (int32_t) (cos(x * M_PI / 1800) * 16384 + 0.5), gnss_cos_q14(x * 1000000));
+    angle = 345600.1234;
+    memcpy(r8, &angle, sizeof (r8));
+    TEST_ASSERT_EQUAL_UINT32(345600123, ubx_r8_ms(r8));
+#endif
+}
+
+#ifndef GNSS_FIXED_POINT
+// Test the batch geodesy kernels against the C library
+void test_geodesy() {
+    const int count = 64;
+    int32_t *pLat = new int32_t[count * 6];
+    int32_t *pLon = pLat + count;
+    int32_t *pHeight = pLon + count;
+    int32_t *pLat2 = pHeight + count;
+    int32_t *pLon2 = pLat2 + count;
+    int32_t *pHeight2 = pLon2 + count;
+    double *pX = new double[count * 3];
+    double *pY = pX + count;
+    double *pZ = pY + count;
+    const double k = M_PI / 180e7;
+    double s;
+    double c;
+
+    for (int x = -400; x <= 400; x++) {
+        GnssGeodesy::sincos(x * 0.0173, &s, &c);
+        TEST_ASSERT(fabs(s - sin(x * 0.0173)) < 2e-16);
+        TEST_ASSERT(fabs(c - cos(x * 0.0173)) < 2e-16);
+        TEST_ASSERT(fabs(GnssGeodesy::atan2(x, 117.0 - x) - atan2(x, 117.0 - x)) < 1e-15);
+    }
+
+    // Positions all over the earth, the second ones about 1 km away
+    for (int x = 0; x < count; x++) {
+        pLat[x] = -899000000 + x * 28537113;
+        pLon[x] = (int32_t) (-1799000000LL + x * 57108911LL);
+        pHeight[x] = -1000000 + x * 800000;
+        pLat2[x] = pLat[x] + 6500 - (x % 9) * 1500;
+        pLon2[x] = pLon[x] - 7000 + (x % 7) * 2000;
+    }
+
+    GnssGeodesy::llh_to_ecef(pLat, pLon, pHeight, count, pX, pY, pZ);
+    for (int x = 0; x < count; x++) {
+        double lat = pLat[x] * k;
+        double lon = pLon[x] * k;
+        double e2 = (2.0 - 1.0 / 298.257223563) / 298.257223563;
+        double n = 6378137.0 / sqrt(1.0 - e2 * sin(lat) * sin(lat));
+        double h = pHeight[x] * 1e-3;
+        TEST_ASSERT(fabs(pX[x] - (n + h) * cos(lat) * cos(lon)) < 1e-8);
+        TEST_ASSERT(fabs(pY[x] - (n + h) * cos(lat) * sin(lon)) < 1e-8);
+        TEST_ASSERT(fabs(pZ[x] - (n * (1.0 - e2) + h) * sin(lat)) < 1e-8);
+    }
+    GnssGeodesy::ecef_to_llh(pX, pY, pZ, count, pLat2, pLon2, pHeight2);
+    for (int x = 0; x < count; x++) {
+        TEST_ASSERT_EQUAL_INT32(pLat[x], pLat2[x]);
+        TEST_ASSERT_EQUAL_INT32(pLon[x], pLon2[x]);
+        TEST_ASSERT_EQUAL_INT32(pHeight[x], pHeight2[x]);
+        pLat2[x] = pLat[x] + 6500 - (x % 9) * 1500;
+        pLon2[x] = pLon[x] - 7000 + (x % 7) * 2000;
+    }
+
+    GnssGeodesy::distance(pLat, pLon, pLat2, pLon2, count, pX);
+    GnssGeodesy::bearing(pLat, pLon, pLat2, pLon2, count, pY);
+    for (int x = 0; x < count; x++) {
+        double lat1 = pLat[x] * k;
+        double lat2 = pLat2[x] * k;
+        double dLon = ((double) pLon2[x] - pLon[x]) * k;
+        double h = pow(sin((lat2 - lat1) / 2), 2) + cos(lat1) * cos(lat2) * pow(sin(dLon / 2), 2);
+        double m = 2 * GNSS_GEODESY_EARTH_RADIUS * atan2(sqrt(h), sqrt(1.0 - h));
+        double deg = atan2(sin(dLon) * cos(lat2), cos(lat1) * sin(lat2) - sin(lat1) * cos(lat2) * cos(dLon)) * 180.0 / M_PI;
+        TEST_ASSERT(fabs(pX[x] - m) < 1e-8 + m * 1e-12);
+        deg = fabs(pY[x] - ((deg < 0) ? deg + 360.0 : deg));
+        TEST_ASSERT((deg < 1e-7) || (deg > 360.0 - 1e-7));
+    }
+
+    // One degree north along a meridian, in steps
+    for (int x = 0; x < count; x++) {
+        pLat[x] = 475000000 + (x * 10000000) / (count - 1);
+        pLon[x] = 163456789;
+    }
+    double total = GnssGeodesy::odometer(pLat, pLon, count, pX);
+    TEST_ASSERT(fabs(total - GNSS_GEODESY_EARTH_RADIUS * M_PI / 180) < 1e-6);
+    TEST_ASSERT(total == pX[count - 1]);
+
+    delete[] pX;
+    delete[] pLat;
+}
+#endif
+
+// Test entering and leaving the stationary state and the duplicate suppression
+void test_stationary() {
+    GnssStationaryFilter filter(stationarySink, 300, 15, 10, 60);
+    tUBX_NAV_PVT pvt;
+    int x;
+
+    gStationaryCount = 0;
+    // Still with up to 3 m of jitter, every solution passes until 10 s have gone by
+    for (x = 0; x < 10; x++) {
+        makePvt(&pvt, 345600000 + (x * 1000), ((x % 3) - 1) * 3000, 100);
+        TEST_ASSERT_EQUAL_INT(GNSS_STATIONARY_MOVING, filter.add(&pvt));
+        // The same epoch again is dropped
+        TEST_ASSERT_EQUAL_INT(GNSS_STATIONARY_NONE, filter.add(&pvt));
+    }
+    TEST_ASSERT(!filter.stationary());
+    makePvt(&pvt, 345600000 + (x * 1000), 0, 100);
+    TEST_ASSERT_EQUAL_INT(GNSS_STATIONARY_START, filter.add(&pvt));
+    TEST_ASSERT(filter.stationary());
+
+    // Only a heartbeat after 60 s and the change of the fix flags pass
+    for (x = 11; x <= 70; x++) {
+        makePvt(&pvt, 345600000 + (x * 1000), ((x % 3) - 1) * 3000, 100);
+        TEST_ASSERT_EQUAL_INT((x == 70) ? GNSS_STATIONARY_HEARTBEAT : GNSS_STATIONARY_NONE, filter.add(&pvt));
+    }
+    makePvt(&pvt, 345600000 + (x * 1000), 0, 100);
+    pvt.flag1 |= 0x02;
+    TEST_ASSERT_EQUAL_INT(GNSS_STATIONARY_FIX_CHANGE, filter.add(&pvt));
+    TEST_ASSERT_EQUAL_INT(GNSS_STATIONARY_NONE, filter.add(&pvt));
+    TEST_ASSERT(filter.stationary());
+    TEST_ASSERT_EQUAL_INT(13, gStationaryCount);
+
+    // One fix above the speed limit is tolerated, the second one in a row is motion
+    makePvt(&pvt, 345600000 + (++x * 1000), 0, 400);
+    pvt.flag1 |= 0x02;
+    TEST_ASSERT_EQUAL_INT(GNSS_STATIONARY_NONE, filter.add(&pvt));
+    makePvt(&pvt, 345600000 + (++x * 1000), 0, 400);
+    pvt.flag1 |= 0x02;
+    TEST_ASSERT_EQUAL_INT(GNSS_STATIONARY_END, filter.add(&pvt));
+    TEST_ASSERT(!filter.stationary());
+    makePvt(&pvt, 345600000 + (++x * 1000), 0, 400);
+    TEST_ASSERT_EQUAL_INT(GNSS_STATIONARY_MOVING, filter.add(&pvt));
+    TEST_ASSERT_EQUAL_INT(GNSS_STATIONARY_MOVING, gStationaryReason);
+
+    // Stationary again, then a jump out of the radius at low speed
+    for (x++; !filter.stationary(); x++) {
+        makePvt(&pvt, 345600000 + (x * 1000), 0, 0);
+        filter.add(&pvt);
+    }
+    makePvt(&pvt, 345600000 + (x * 1000), 20000, 0);
+    TEST_ASSERT_EQUAL_INT(GNSS_STATIONARY_END, filter.add(&pvt));
+    TEST_ASSERT(!filter.stationary());
+    TEST_ASSERT_EQUAL_UINT32(gStationaryCount, filter.passed());
+}
+
+// Test that every dropped fix is within the error of the simplified track
+void test_simplify() {
+    const int count = 400;
+    tGNSS_SIMPLIFY_POINT *pTrack = new tGNSS_SIMPLIFY_POINT[count];
+    GnssTrackSimplifier simplifier(simplifySink, 10, 0);
+    double north = 0;
+    double east = 0;
+    double heading = 0;
+    double worst = 0;
+    int k = 0;
+
+    gpSimplifyKept = new tGNSS_SIMPLIFY_POINT[count];
+    gSimplifyKeptCount = 0;
+    // 15 m/s with straight parts, curves of different radius and up to 2 m of noise
+    for (int x = 0; x < count; x++) {
+        if ((x % 100) >= 60)
+            heading += ((x / 100) % 2) ? 0.05 : -0.12;
+        north += 15 * cos(heading);
+        east += 15 * sin(heading);
+        pTrack[x].itow = 345600000 + (x * 1000);
+        pTrack[x].lat = 481234567 + (int32_t)((north + ((x * 7919) % 9 - 4) * 0.5) * 89.83);
+        pTrack[x].lon = 163456789 + (int32_t)((east + ((x * 104729) % 9 - 4) * 0.5) * 89.83 / cos(48.12 * M_PI / 180));
+        pTrack[x].height = 250000;
+        pTrack[x].speed = 15000;
+        simplifier.add(&pTrack[x]);
+    }
+    simplifier.flush();
+    printf ("%d of %d fixes kept.\n", gSimplifyKeptCount, count);
+    TEST_ASSERT_EQUAL_UINT32(count, simplifier.added());
+    TEST_ASSERT_EQUAL_UINT32(gSimplifyKeptCount, simplifier.kept());
+    TEST_ASSERT(gSimplifyKeptCount < count / 4);
+    TEST_ASSERT_EQUAL_UINT32(pTrack[0].itow, gpSimplifyKept[0].itow);
+    TEST_ASSERT_EQUAL_UINT32(pTrack[count - 1].itow, gpSimplifyKept[gSimplifyKeptCount - 1].itow);
+
+    // The kept fixes are a subset in order, the others lie near their segment
+    for (int x = 0; x < count; x++) {
+        while ((k < gSimplifyKeptCount - 1) && (gpSimplifyKept[k + 1].itow <= pTrack[x].itow))
+            k++;
+        if (gpSimplifyKept[k].itow == pTrack[x].itow) {
+            TEST_ASSERT_EQUAL_INT32(pTrack[x].lat, gpSimplifyKept[k].lat);
+            TEST_ASSERT_EQUAL_INT32(pTrack[x].lon, gpSimplifyKept[k].lon);
+            continue;
+        }
+        TEST_ASSERT(k < gSimplifyKeptCount - 1);
+        double d = segmentDistance(&pTrack[x], &gpSimplifyKept[k], &gpSimplifyKept[k + 1]);
+        if (d > worst)
+            worst = d;
+    }
+    printf ("Largest distance of a dropped fix %.2f m.\n", worst);
+    TEST_ASSERT(worst <= 10.1);
+
+    delete[] gpSimplifyKept;
+    gpSimplifyKept = NULL;
+    delete[] pTrack;
+}
+
+// Test a concave polygon and the grid lookup of the geofence engine
+void test_geofence() {
+    // U shaped polygon of about 2 x 3 km, open to the north
+    const int32_t d = 100000;
+    const int32_t lat0 = 480000000;
+    const int32_t lon0 = 160000000;
+    const int32_t lat[] = {lat0, lat0, lat0 + 3 * d, lat0 + 3 * d, lat0 + d, lat0 + d, lat0 + 3 * d, lat0 + 3 * d};
+    const int32_t lon[] = {lon0, lon0 + 3 * d, lon0 + 3 * d, lon0 + 2 * d, lon0 + 2 * d, lon0 + d, lon0 + d, lon0};
+    GnssGeofence *pFence = new GnssGeofence(4, 8);
+
+    gGeofenceEventCount = 0;
+    pFence->attach(geofenceSink);
+    TEST_ASSERT_EQUAL_INT(1, pFence->add_polygon(7, lat, lon, 8));
+    // In the notch
+    TEST_ASSERT_EQUAL_INT(0, pFence->update(1000, lat0 + 2 * d, lon0 + d + d / 2));
+    // In the left arm
+    TEST_ASSERT_EQUAL_INT(1, pFence->update(2000, lat0 + 2 * d, lon0 + d / 2));
+    TEST_ASSERT_EQUAL_INT(GNSS_GEOFENCE_ENTER, gGeofenceEvent.event);
+    TEST_ASSERT_EQUAL_INT(7, gGeofenceEvent.id);
+    TEST_ASSERT(pFence->inside(7));
+    // In the base, then back in the notch
+    TEST_ASSERT_EQUAL_INT(0, pFence->update(3000, lat0 + d / 2, lon0 + d + d / 2));
+    TEST_ASSERT_EQUAL_INT(1, pFence->update(4000, lat0 + 2 * d, lon0 + d + d / 2));
+    TEST_ASSERT_EQUAL_INT(GNSS_GEOFENCE_EXIT, gGeofenceEvent.event);
+    TEST_ASSERT(!pFence->inside(7));
+    // Within the hysteresis of the base edge, then clearly inside
+    TEST_ASSERT_EQUAL_INT(0, pFence->update(5000, lat0 + d - 300, lon0 + d + d / 2));
+    TEST_ASSERT_EQUAL_INT(1, pFence->update(6000, lat0 + d - 2000, lon0 + d + d / 2));
+    TEST_ASSERT_EQUAL_INT(3, gGeofenceEventCount);
+    delete pFence;
+
+    // 10 x 10 circles about 5 km apart and one of 2 km over most of them
+    pFence = new GnssGeofence(101, 0);
+    gGeofenceEventCount = 0;
+    pFence->attach(geofenceSink);
+    for (int x = 0; x < 100; x++) {
+        TEST_ASSERT_EQUAL_INT(1, pFence->add_circle(x, lat0 + (x / 10) * 50000, lon0 + (x % 10) * 50000, 100));
+    }
+    TEST_ASSERT_EQUAL_INT(1, pFence->add_circle(1000, lat0 + 225000, lon0 + 225000, 2000));
+    TEST_ASSERT_EQUAL_INT(2, pFence->update(1000, lat0 + 150000, lon0 + 350000));
+    TEST_ASSERT(pFence->inside(37));
+    TEST_ASSERT(pFence->inside(1000));
+    TEST_ASSERT(!pFence->inside(36));
+    printf ("%d of 101 fences tested.\n", pFence->tested());
+    TEST_ASSERT(pFence->tested() < 10);
+    // Outside the grid only the fences it was inside of are tested
+    TEST_ASSERT_EQUAL_INT(2, pFence->update(2000, lat0 - 1000000, lon0));
+    TEST_ASSERT_EQUAL_INT(2, pFence->tested());
+    TEST_ASSERT_EQUAL_INT(0, pFence->update(3000, lat0 - 1000000, lon0));
+    TEST_ASSERT_EQUAL_INT(0, pFence->tested());
+    TEST_ASSERT_EQUAL_INT(4, gGeofenceEventCount);
+    delete pFence;
+
+    // 40 x 40 circles about 2 km apart, more fences than GNSS_GEOFENCE_MAX_ITEMS
+    pFence = new GnssGeofence(1600, 0);
+    for (int x = 0; x < 1600; x++) {
+        TEST_ASSERT_EQUAL_INT(1, pFence->add_circle(x, lat0 + (x / 40) * 20000, lon0 + (x % 40) * 20000, 100));
+    }
+    TEST_ASSERT_EQUAL_INT(0, pFence->update(1000, lat0 + 210000, lon0 + 410000));
+    TEST_ASSERT_EQUAL_INT(1, pFence->update(2000, lat0 + 200000, lon0 + 400000));
+    TEST_ASSERT(pFence->inside(420));
+    printf ("%d of 1600 fences tested.\n", pFence->tested());
+    TEST_ASSERT(pFence->tested() < 10);
+    delete pFence;
+}
+
 // ----------------------------------------------------------------
 // TEST ENVIRONMENT
 // ----------------------------------------------------------------
@@ -211,6 +1198,21 @@ utest::v1::status_t test_setup(const size_t number_of_cases) {
 Case cases[] = {
     Case("Ubx command", test_serial_ubx),
     Case("Get time", test_serial_time),
+    Case("Track format", test_track),
+    Case("Track archive", test_archive),
+    Case("Capture codec", test_codec),
+    Case("Capture index", test_capture_index),
+    Case("Epoch assembly", test_epoch),
+    Case("Seqlock", test_seqlock),
+    Case("Broadcast overrun", test_broadcast),
+    Case("Ephemeris decoding", test_ephemeris),
+#ifndef GNSS_FIXED_POINT
+    Case("Geodesy kernels", test_geodesy),
+#endif
+    Case("NMEA fixed point", test_nmea_fixed),
+    Case("Stationary filter", test_stationary),
+    Case("Track simplification", test_simplify),
+    Case("Geofence", test_geofence),
 };
 
 Specification specification(test_setup, cases);
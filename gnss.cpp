@@ -27,10 +27,20 @@
 
 #ifdef UBLOX_WEARABLE_FRAMEWORK
 #include "SDCardModel.h"
+#elif defined(GNSS_TRACE_LEVEL)
+#define SEND_LOGGING_MESSAGE GNSS_TRACE_MESSAGE
 #else
 #define SEND_LOGGING_MESSAGE printf
 #endif
 
+#ifdef UBLOX_WEARABLE_FRAMEWORK
+static int _sdCardWrite(const void *buf, int len)
+{
+    GET_SDCARD_INSTANCE->write(logging_file_name, (void *)buf, len);
+    return len;
+}
+#endif
+
 GnssParser::GnssParser(void)
 {
     // Create the enable pin but set everything to disabled
@@ -77,112 +87,6 @@ void GnssParser::_powerOn(void)
     thread_sleep_for(1);
 }
 
-int GnssParser::_getMessage(Pipe<char>* pipe, char* buf, int len)
-{
-    int unkn = 0;
-    int sz = pipe->size();
-    int fr = pipe->free();
-    if (len > sz)
-        len = sz;
-    while (len > 0)
-    {
-        // NMEA protocol
-        pipe->set(unkn);
-        int nmea = _parseNmea(pipe,len);
-        if ((nmea != NOT_FOUND) && (unkn > 0))
-            return UNKNOWN | pipe->get(buf,unkn);
-        if (nmea == WAIT && fr)
-            return WAIT;
-        if (nmea > 0)
-            return NMEA | pipe->get(buf,nmea);
-        // UBX protocol
-
-        pipe->set(unkn);
-        int ubx = _parseUbx(pipe,len);
-        if ((ubx != NOT_FOUND) && (unkn > 0))
-            return UNKNOWN | pipe->get(buf,unkn);
-        if (ubx == WAIT && fr)
-            return WAIT;
-        if (ubx > 0)
-            return UBX | pipe->get(buf,ubx);
-
-        // UNKNOWN
-        unkn ++;
-        len--;
-    }
-    if (unkn > 0)
-        return UNKNOWN | pipe->get(buf,unkn);
-    return WAIT;
-}
-
-int GnssParser::_parseNmea(Pipe<char>* pipe, int len)
-{
-    int o = 0;
-    int c = 0;
-    char ch;
-    if (++o > len)                      return WAIT;
-    if ('$' != pipe->next())            return NOT_FOUND;
-    // This needs to be extended by crc checking
-    for (;;)
-    {
-        if (++o > len)                  return WAIT;
-        ch = pipe->next();
-        if ('*' == ch)                  break; // crc delimiter
-        if (!isprint(ch))               return NOT_FOUND;
-        c ^= ch;
-    }
-    if (++o > len)                      return WAIT;
-    ch = _toHex[(c >> 4) & 0xF]; // high nibble
-    if (ch != pipe->next())             return NOT_FOUND;
-    if (++o > len)                      return WAIT;
-    ch = _toHex[(c >> 0) & 0xF]; // low nibble
-    if (ch != pipe->next())             return NOT_FOUND;
-    if (++o > len)                      return WAIT;
-    if ('\r' != pipe->next())           return NOT_FOUND;
-    if (++o > len)                      return WAIT;
-    if ('\n' != pipe->next())           return NOT_FOUND;
-    return o;
-}
-
-int GnssParser::_parseUbx(Pipe<char>* pipe, int l)
-{
-    int o = 0;
-    if (++o > l)                return WAIT;
-    if ('\xB5' != pipe->next()) return NOT_FOUND;
-    if (++o > l)                return WAIT;
-    if ('\x62' != pipe->next()) return NOT_FOUND;
-    o += 4;
-    if (o > l)                  return WAIT;
-    int i,j,ca,cb;
-    i = pipe->next();
-    ca  = i;
-    cb  = ca; // cls
-    i = pipe->next();
-    ca += i;
-    cb += ca; // id
-    i = pipe->next();
-    ca += i;
-    cb += ca; // len_lsb
-    j = pipe->next();
-    ca += j;
-    cb += ca; // len_msb
-    j = i + (j << 8);
-    while (j--)
-    {
-        if (++o > l)            return WAIT;
-        i = pipe->next();
-        ca += i;
-        cb += ca;
-    }
-    ca &= 0xFF;
-    cb &= 0xFF;
-    if (++o > l)                return WAIT;
-    if (ca != pipe->next())     return NOT_FOUND;
-    if (++o > l)                return WAIT;
-    if (cb != pipe->next())     return NOT_FOUND;
-    return o;
-}
-
 int GnssParser::send(const char* buf, int len)
 {
     return _send(buf, len);
@@ -229,81 +133,6 @@ int GnssParser::sendUbx(unsigned char cls, unsigned char id, const void* buf /*=
     return i;
 }
 
-const char* GnssParser::findNmeaItemPos(int ix, const char* start, const char* end)
-{
-    // Find the start
-    for (; (start < end) && (ix > 0); start ++)
-    {
-        if (*start == ',')
-            ix --;
-    }
-    // Found and check bounds
-    if ((ix == 0) && (start < end) &&
-            (*start != ',') && (*start != '*') && (*start != '\r') && (*start != '\n'))
-        return start;
-    else
-        return NULL;
-}
-
-bool GnssParser::getNmeaItem(int ix, char* buf, int len, double& val)
-{
-    char* end = &buf[len];
-    const char* pos = findNmeaItemPos(ix, buf, end);
-    // Find the start
-    if (!pos)
-        return false;
-    val = strtod(pos, &end);
-    // Restore the last character
-    return (end > pos);
-}
-
-bool GnssParser::getNmeaItem(int ix, char* buf, int len, int& val, int base /*=10*/)
-{
-    char* end = &buf[len];
-    const char* pos = findNmeaItemPos(ix, buf, end);
-    // Find the start
-    if (!pos)
-        return false;
-    val = (int)strtol(pos, &end, base);
-    return (end > pos);
-}
-
-bool GnssParser::getNmeaItem(int ix, char* buf, int len, char& val)
-{
-    const char* end = &buf[len];
-    const char* pos = findNmeaItemPos(ix, buf, end);
-    // Find the start
-    if (!pos)
-        return false;
-    // Skip leading spaces
-    while ((pos < end) && isspace(*pos))
-        pos++;
-    // Check bound
-    if ((pos < end) &&
-            (*pos != ',') && (*pos != '*') && (*pos != '\r') && (*pos != '\n'))
-    {
-        val = *pos;
-        return true;
-    }
-    return false;
-}
-
-bool GnssParser::getNmeaAngle(int ix, char* buf, int len, double& val)
-{
-    char ch;
-    if (getNmeaItem(ix,buf,len,val) && getNmeaItem(ix+1,buf,len,ch) &&
-            ((ch == 'S') || (ch == 'N') || (ch == 'E') || (ch == 'W')))
-    {
-        val *= 0.01;
-        int i = (int)val;
-        val = (val - i) / 0.6 + i;
-        if (ch == 'S' || ch == 'W')
-            val = -val;
-        return true;
-    }
-    return false;
-}
-
 int GnssParser::enable_ubx() {
     unsigned char ubx_cfg_prt[]= {
         // See https://www.u-blox.com/sites/default/files/products/documents/u-blox8-M8_ReceiverDescrProtSpec_UBX-13003221.pdf
@@ -311,7 +140,8 @@ int GnssParser::enable_ubx() {
         0x00,                   // Reserved - 0
         0x00, 0x00,             // txReady - 0 thres, pin 0, pol 0, en 0
         0xC0, 0x08, 0x00, 0x00, // mode - 1 stop bit, no parity, 8 bit
-        0x00, 0xC2, 0x01, 0x00, // baud - 115200
+        (unsigned char)(GNSS_TARGET_BAUD & 0xFF), (unsigned char)((GNSS_TARGET_BAUD >> 8) & 0xFF),
+        (unsigned char)((GNSS_TARGET_BAUD >> 16) & 0xFF), 0x00, // baud - GNSS_TARGET_BAUD (115200)
         0x23, 0x00,             // inProtoMask - Ubx, Nmea, Rtcm3
         0x03, 0x00,             // outProtoMask - Ubx, Nmea
         0x00, 0x00,             // flags
@@ -325,7 +155,7 @@ int GnssParser::enable_ubx() {
         length = sendUbx(0x06, 0x00, ubx_cfg_prt, sizeof(ubx_cfg_prt));
         if(length >= (int)(sizeof(ubx_cfg_prt) + UBX_FRAME_SIZE))
         {
-            thread_sleep_for(1000);
+            // No fixed wait, the caller switches its own baud rate once the frame is sent
             break;
         }
         else
@@ -362,6 +192,28 @@ eUBX_MESSAGE GnssParser::get_ubx_message(char *buff) {
                 return_value = UBX_NAV_SAT;
             }
             break;
+            case 0x61: {
+                return_value = UBX_NAV_EOE;
+            }
+            break;
+            default:
+            {
+                return_value = UNKNOWN_UBX;
+            }
+            break;
+            }
+        }
+        break;
+        case RXM: {
+            switch (buff[MSG_ID_INDEX]) {
+            case 0x15: {
+                return_value = UBX_RXM_RAWX;
+            }
+            break;
+            case 0x13: {
+                return_value = UBX_RXM_SFRBX;
+            }
+            break;
             default:
             {
                 return_value = UNKNOWN_UBX;
@@ -388,6 +240,20 @@ eUBX_MESSAGE GnssParser::get_ubx_message(char *buff) {
             }
         }
         break;
+        case MON: {
+            switch (buff[MSG_ID_INDEX]) {
+            case 0x32: {
+                return_value = UBX_MON_BATCH;
+            }
+            break;
+            default:
+            {
+                return_value = UNKNOWN_UBX;
+            }
+            break;
+            }
+        }
+        break;
         case LOG: {
             switch (buff[MSG_ID_INDEX]) {
             case 0x11: {
@@ -468,6 +334,11 @@ tUBX_NAV_PVT GnssParser::decode_ubx_nav_pvt_msg(char *buf) {
 
     return_decoded_msg.day = buf[index++];
 
+    return_decoded_msg.hour = buf[index++];
+    return_decoded_msg.min = buf[index++];
+    return_decoded_msg.sec = buf[index++];
+    return_decoded_msg.valid = buf[index++];
+
     // Go to Fix type
     index = UBX_PAYLOAD_INDEX + 20;
     return_decoded_msg.fixType = buf[index++];
@@ -505,6 +376,10 @@ tUBX_LOG_BATCH GnssParser::decode_ubx_log_batch_msg(char *buf) {
     tUBX_LOG_BATCH return_decoded_msg;
     uint8_t index = UBX_PAYLOAD_INDEX;
 
+    // move index msgCnt
+    index = UBX_PAYLOAD_INDEX + 2;
+    return_decoded_msg.msgCnt = ubx_u2(&buf[index]);
+
     // move index itow
     index = UBX_PAYLOAD_INDEX + 4;
 
@@ -552,6 +427,89 @@ tUBX_LOG_BATCH GnssParser::decode_ubx_log_batch_msg(char *buf) {
     return return_decoded_msg;
 }
 
+int GnssParser::decode_ubx_rxm_rawx_msg(char *buf, int length, tUBX_RXM_RAWX *epoch) {
+    const char *payload = &buf[UBX_PAYLOAD_INDEX];
+    const char *meas = payload + 16;
+    int numMeas = (uint8_t)payload[11];
+    int i;
+
+    if(length != (UBX_FRAME_SIZE + 16 + (32*numMeas))) {
+        return -1;
+    }
+    if(numMeas > UBX_RXM_RAWX_MAX_MEAS) {
+        numMeas = UBX_RXM_RAWX_MAX_MEAS;
+    }
+
+    epoch->rcvTow = ubx_r8(payload);
+    epoch->week = ubx_u2(payload + 8);
+    epoch->leapS = (int8_t)payload[10];
+    epoch->numMeas = numMeas;
+    epoch->recStat = payload[12];
+
+    // One pass per observable keeps the writes sequential in each column
+    for (i = 0; i < numMeas; i++)
+        epoch->prMes[i] = ubx_r8(meas + 32*i);
+    for (i = 0; i < numMeas; i++)
+        epoch->cpMes[i] = ubx_r8(meas + 32*i + 8);
+    for (i = 0; i < numMeas; i++)
+        epoch->doMes[i] = ubx_r4(meas + 32*i + 16);
+    for (i = 0; i < numMeas; i++) {
+        const char *m = meas + 32*i;
+        epoch->gnssId[i] = m[20];
+        epoch->svId[i] = m[21];
+        epoch->sigId[i] = m[22];
+        epoch->freqId[i] = m[23];
+        epoch->locktime[i] = ubx_u2(m + 24);
+        epoch->cno[i] = m[26];
+        epoch->prStdev[i] = m[27] & 0x0F;
+        epoch->cpStdev[i] = m[28] & 0x0F;
+        epoch->doStdev[i] = m[29] & 0x0F;
+        epoch->trkStat[i] = m[30];
+    }
+
+    return numMeas;
+}
+
+int GnssParser::decode_ubx_rxm_sfrbx_msg(char *buf, int length, tUBX_RXM_SFRBX *frame) {
+    const char *payload = &buf[UBX_PAYLOAD_INDEX];
+    int numWords = (uint8_t)payload[4];
+    int i;
+
+    if((length != (UBX_FRAME_SIZE + 8 + (4*numWords))) || (numWords > UBX_RXM_SFRBX_MAX_WORDS)) {
+        return -1;
+    }
+
+    frame->gnssId = payload[0];
+    frame->svId = payload[1];
+    frame->sigId = payload[2];
+    frame->freqId = payload[3];
+    frame->numWords = numWords;
+    frame->chn = payload[5];
+    frame->version = payload[6];
+    for (i = 0; i < numWords; i++)
+        frame->dwrd[i] = ubx_u4(payload + 8 + 4*i);
+
+    return numWords;
+}
+
+tUBX_MON_BATCH GnssParser::decode_ubx_mon_batch_msg(char *buf) {
+    tUBX_MON_BATCH return_decoded_msg;
+    uint8_t index = UBX_PAYLOAD_INDEX;
+
+    // version and 3 bytes reserved
+    index += 4;
+
+    return_decoded_msg.fillLevel = ubx_u2(&buf[index]);
+    index += 2;
+    return_decoded_msg.dropsAll = ubx_u2(&buf[index]);
+    index += 2;
+    return_decoded_msg.dropsSinceMon = ubx_u2(&buf[index]);
+    index += 2;
+    return_decoded_msg.nextMsgCnt = ubx_u2(&buf[index]);
+
+    return return_decoded_msg;
+}
+
 tUBX_NAV_STATUS GnssParser::decode_ubx_nav_status_msg(char *buf) {
 
     tUBX_NAV_STATUS return_decoded_msg;
@@ -567,8 +525,9 @@ tUBX_NAV_STATUS GnssParser::decode_ubx_nav_status_msg(char *buf) {
 
     return_decoded_msg.flags = buf[index++];
 
-    // move to ttff
-    index+=2;
+    // move to flags2
+    index++;
+    return_decoded_msg.flags2 = buf[index++];
 
     return_decoded_msg.ttff = buf[index++];
     return_decoded_msg.ttff |= (buf[index++] << 8);
@@ -595,10 +554,74 @@ tUBX_NAV_SAT GnssParser::decode_ubx_nav_sat_msg(char *buf, int length) {
     else {
         return_decoded_msg.status = false;
     }
+    return_decoded_msg.itow = ubx_u4(&buf[index]);
+    return_decoded_msg.numSvs = numberSVs;
 
     return return_decoded_msg;
 }
 
+int GnssParser::decode_ubx_nav_sat_table(char *buf, int length, tUBX_NAV_SAT_TABLE *table) {
+    const uint8_t *sv = (const uint8_t *)&buf[UBX_PAYLOAD_INDEX + 8];
+    int numberSVs = (uint8_t)buf[UBX_PAYLOAD_INDEX + 5];
+    int i;
+
+    if(length != (UBX_FRAME_SIZE + 8 + (12*numberSVs))) {
+        return -1;
+    }
+    if(numberSVs > UBX_NAV_SAT_MAX_SVS) {
+        numberSVs = UBX_NAV_SAT_MAX_SVS;
+    }
+
+    table->itow = ubx_u4(&buf[UBX_PAYLOAD_INDEX]);
+    table->numSvs = numberSVs;
+
+    // One pass per field over the 12 byte records, each loop has a fixed
+    // stride and no dependencies so the compiler can unroll or vectorise it
+    for (i = 0; i < numberSVs; i++)
+        table->gnssId[i] = sv[12*i + 0];
+    for (i = 0; i < numberSVs; i++)
+        table->svId[i] = sv[12*i + 1];
+    for (i = 0; i < numberSVs; i++)
+        table->cno[i] = sv[12*i + 2];
+    for (i = 0; i < numberSVs; i++)
+        table->elev[i] = (int8_t)sv[12*i + 3];
+    for (i = 0; i < numberSVs; i++)
+        table->azim[i] = (int16_t)(sv[12*i + 4] | (sv[12*i + 5] << 8));
+    for (i = 0; i < numberSVs; i++)
+        table->prRes[i] = (int16_t)(sv[12*i + 6] | (sv[12*i + 7] << 8));
+    for (i = 0; i < numberSVs; i++)
+        table->flags[i] = (uint32_t)sv[12*i + 8] | ((uint32_t)sv[12*i + 9] << 8) |
+                          ((uint32_t)sv[12*i + 10] << 16) | ((uint32_t)sv[12*i + 11] << 24);
+
+    return numberSVs;
+}
+
+tUBX_NAV_SAT_STATS GnssParser::nav_sat_stats(const tUBX_NAV_SAT_TABLE *table) {
+    tUBX_NAV_SAT_STATS stats;
+    uint32_t cnoSum = 0;
+    uint32_t cnoSumUsed = 0;
+    uint32_t used = 0;
+    uint8_t maxCno = 0;
+    int i;
+
+    // Branch free reductions
+    for (i = 0; i < table->numSvs; i++) {
+        uint32_t isUsed = (table->flags[i] & UBX_NAV_SAT_FLAGS_SVUSED) >> 3;
+        cnoSum += table->cno[i];
+        cnoSumUsed += table->cno[i] * isUsed;
+        used += isUsed;
+        maxCno = (table->cno[i] > maxCno) ? table->cno[i] : maxCno;
+    }
+
+    stats.numSvs = table->numSvs;
+    stats.numUsed = used;
+    stats.meanCno = table->numSvs ? (cnoSum / table->numSvs) : 0;
+    stats.meanCnoUsed = used ? (cnoSumUsed / used) : 0;
+    stats.maxCno = maxCno;
+
+    return stats;
+}
+
 int GnssParser::ubx_request_batched_data(bool sendMonFirst) {
     unsigned char ubx_log_retrieve_batch[]= {0x00, 0x00, 0x00, 0x00};
 
@@ -627,7 +650,66 @@ int GnssParser::ubx_request_batched_data(bool sendMonFirst) {
     return 0;
 }
 
-const char GnssParser::_toHex[] = { '0','1','2','3','4','5','6','7','8','9','A','B','C','D','E','F' };
+void GnssParser::attach_skipped(Callback<void(const char*, int)> cb)
+{
+    _skipped = cb;
+}
+
+void GnssParser::skipped(const char *buf, int ret)
+{
+    if ((ret > 0) && _skipped)
+    {
+        _skipped(buf, ret);
+    }
+}
+
+int GnssParser::waitUbx(unsigned char cls, unsigned char id, char* buf, int len, int timeout_ms)
+{
+    Timer timer;
+    int ret;
+
+    timer.start();
+    while (timer.read_ms() < timeout_ms)
+    {
+        ret = getMessage(buf, len);
+        if ((ret > 0) && (PROTOCOL(ret) == UBX) && (LENGTH(ret) >= UBX_FRAME_SIZE) &&
+                ((unsigned char)buf[MSG_CLASS_INDEX] == cls) && ((unsigned char)buf[MSG_ID_INDEX] == id))
+        {
+            return LENGTH(ret);
+        }
+        skipped(buf, ret);
+        if (ret == WAIT)
+        {
+            thread_sleep_for(1);
+        }
+    }
+    return 0;
+}
+
+int GnssParser::waitAck(unsigned char cls, unsigned char id, int timeout_ms)
+{
+    char buf[UBX_WAIT_BUFFER_SIZE];
+    Timer timer;
+    int ret;
+
+    timer.start();
+    while (timer.read_ms() < timeout_ms)
+    {
+        ret = getMessage(buf, sizeof(buf));
+        if ((ret > 0) && (PROTOCOL(ret) == UBX) && (LENGTH(ret) >= (UBX_FRAME_SIZE + 2)) &&
+                ((unsigned char)buf[MSG_CLASS_INDEX] == ACK) &&
+                ((unsigned char)buf[UBX_PAYLOAD_INDEX] == cls) && ((unsigned char)buf[UBX_PAYLOAD_INDEX + 1] == id))
+        {
+            return (buf[MSG_ID_INDEX] == 0x01) ? 1 : 0;
+        }
+        skipped(buf, ret);
+        if (ret == WAIT)
+        {
+            thread_sleep_for(1);
+        }
+    }
+    return 0;
+}
 
 // ----------------------------------------------------------------
 // Serial Implementation
@@ -638,6 +720,9 @@ GnssSerial::GnssSerial(PinName tx /*= GNSSTXD  */, PinName rx /*= GNSSRXD */, in
     SerialPipe(tx, rx, baudrate, rxSize, txSize)
 {
     baud(baudrate);
+#ifdef UBLOX_WEARABLE_FRAMEWORK
+    _sdLog.start(_sdCardWrite);
+#endif
 }
 
 GnssSerial::~GnssSerial(void)
@@ -647,52 +732,90 @@ GnssSerial::~GnssSerial(void)
 
 bool GnssSerial::init()
 {
-    Timer timer;
-    int size;
+    static const int baudrates[] = { GNSS_TARGET_BAUD, 9600, 38400, 57600, 230400, 19200 };
+    const int count = sizeof(baudrates) / sizeof(baudrates[0]);
+    int found = 0;
 
     // Power up and enable the module
     _powerOn();
 
-    // Send a byte to wakup the device again
-    putc(0xFF);
-    // Wait until we get some bytes
-    size = _pipeRx.size();
-
-    timer.start();
-    while ((timer.read_ms() < 1000) && (size == _pipeRx.size())) {
-        // Nothing, just wait
+    // Two passes as the receiver may still be booting during the first one
+    for (int i = 0; (i < 2 * count) && !found; i++)
+    {
+        baud(baudrates[i % count]);
+        // Send a byte to wakup the device again
+        putc(0xFF);
+        if (_verifyLink(GNSS_PROBE_TIMEOUT_MS))
+            found = baudrates[i % count];
     }
-    timer.stop();
 
+    if (!found)
+        return false;
+
+    // Also sent at the target rate, the UBX output may be disabled. The new
+    // rate is applied once the message was sent.
     enable_ubx();
+    _flushTx(found);
+    if (found != GNSS_TARGET_BAUD)
+        baud(GNSS_TARGET_BAUD);
 
-    baud(115200);
+    return _verifyLink(GNSS_PROBE_TIMEOUT_MS, true);
+}
 
-    thread_sleep_for(1);
+bool GnssSerial::_verifyLink(int timeout_ms, bool ubx)
+{
+    // UBX-CFG-PRT poll for the UART port. The reply only comes if UBX is in
+    // the outProtoMask of the port, otherwise the probe relies on the NMEA
+    // output, and finds nothing if that is disabled too.
+    const unsigned char ubx_cfg_prt_poll[] = { 0x01 };
+    char buf[UBX_WAIT_BUFFER_SIZE];
+    Timer timer;
+    int ret;
 
-    // Send a byte to wakup the device again
-    putc(0xFF);
+    // Drop what was received at a wrong rate
+    while (_pipeRx.readable())
+        _pipeRx.getc();
 
-    // Wait until we get some bytes
-    size = _pipeRx.size();
+    sendUbx(0x06, 0x00, ubx_cfg_prt_poll, sizeof(ubx_cfg_prt_poll));
 
     timer.start();
-    while ((timer.read_ms() < 1000) && (size == _pipeRx.size())) {
-        // Nothing, just wait
+    while (timer.read_ms() < timeout_ms)
+    {
+        ret = getMessage(buf, sizeof(buf));
+        if ((ret > 0) && (PROTOCOL(ret) == UBX) && (!ubx || ((buf[2] == 0x06) && (buf[3] == 0x00))))
+            return true;
+        if ((ret > 0) && (PROTOCOL(ret) == NMEA) && !ubx)
+            return true;
+        if (ret == WAIT)
+            thread_sleep_for(1);
     }
+    return false;
+}
 
-    return (size != _pipeRx.size());
+void GnssSerial::_flushTx(int baudrate)
+{
+    while (_pipeTx.readable()) {
+        // Nothing, just wait
+    }
+    // Last character still in the shift register (10 bits)
+    thread_sleep_for((10000 / baudrate) + 1);
 }
 
 int GnssSerial::getMessage(char* buf, int len)
 {
-    return _getMessage(&_pipeRx, buf, len);
+    int ret = _getMessage(&_pipeRx, buf, len);
+#ifdef UBLOX_WEARABLE_FRAMEWORK
+    if (ret > 0)
+        _sdLog.log(GNSS_SDLOG_RX, buf, LENGTH(ret));
+#endif
+    return ret;
 }
 
 int GnssSerial::_send(const void* buf, int len)
 {
 #ifdef UBLOX_WEARABLE_FRAMEWORK
-    GET_SDCARD_INSTANCE->write(logging_file_name, (void *)buf, len);
+    // Only copied, the card is written by the logger thread
+    _sdLog.log(GNSS_SDLOG_TX, buf, len);
 #endif
     return put((const char*)buf, len, true /*=blocking*/);
 }
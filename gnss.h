@@ -23,8 +23,12 @@
  */
 
 #include "mbed.h"
-#include "pipe.h"
+#include "gnss_framer.h"
 #include "serial_pipe.h"
+#include "gnss_trace.h"
+#ifdef UBLOX_WEARABLE_FRAMEWORK
+#include "gnss_sdlog.h"
+#endif
 
 #if defined (TARGET_UBLOX_C030) || defined (TARGET_UBLOX_C027)
 # define GNSS_IF(onboard, shield) onboard
@@ -39,18 +43,73 @@
 # define GNSSBAUD GPSBAUD
 #endif
 
-#define UBX_FRAME_SIZE 8
 #define RETRY 5
-#define SYNC_CHAR_INDEX_1 0
-#define SYNC_CHAR_INDEX_2 1
-#define MSG_CLASS_INDEX 2
-#define MSG_ID_INDEX 3
-#define UBX_LENGTH_INDEX 4
-#define UBX_PAYLOAD_INDEX 6
+#define UBX_WAIT_BUFFER_SIZE 512
+#define GNSS_TARGET_BAUD 115200
+#define GNSS_PROBE_TIMEOUT_MS 100
+
+/* Define GNSS_FIXED_POINT for targets without a floating point unit: NMEA
+ * fields are then only parsed to scaled integers and the floating point
+ * parts (the double NMEA getters, GnssGeodesy and the satellite positions
+ * of GnssEphemerisCache) are left out, so no soft-float routines are linked.
+ */
 
-enum eUBX_MSG_CLASS {NAV = 0x01, ACK = 0x05, LOG = 0x21};
+/** Cosine of a latitude with integer operations only, to scale longitude
+ * differences to distances.
+ * @param lat latitude, scaling 1e-7 deg.
+ * @return cos(lat) * 2^14, within 1 of the exact value.
+ */
+static inline int32_t gnss_cos_q14(int32_t lat)
+{
+    const int64_t one = 1LL << 30;
+    int64_t a = (lat < 0) ? -(int64_t)lat : lat;
+    if (a > 900000000)
+        a = 900000000;
+    int64_t x = (a * 8048910509LL) >> 32;              // rad * 2^30
+    int64_t x2 = (x * x) >> 30;
+
+    // Taylor series to x^10, Horner form
+    int64_t t = one - x2 / 90;
+    t = one - ((x2 * t) >> 30) / 56;
+    t = one - ((x2 * t) >> 30) / 30;
+    t = one - ((x2 * t) >> 30) / 12;
+    t = one - ((x2 * t) >> 30) / 2;
+    return (int32_t)((t + (1 << 15)) >> 16);
+}
+
+/* Local units of the integer distance code: 1e-7 deg of latitude, about
+ * 11 mm. Longitude differences are scaled with gnss_cos_q14().
+ */
+#define GNSS_M_TO_UNITS(m) ((int64_t)(m) * 8983 / 100)   // 1e-7 deg of latitude per m
+#define GNSS_COS_SHIFT 14                                 // scaling of gnss_cos_q14()
+#define GNSS_FAR (1LL << 30)                              // beyond any local distance
 
-enum eUBX_MESSAGE  {UBX_LOG_BATCH, UBX_ACK_ACK, UBX_ACK_NAK, UBX_NAV_ODO, UBX_NAV_PVT, UBX_NAV_STATUS, UBX_NAV_SAT, UNKNOWN_UBX};
+/** Integer square root.
+ * @param x the value.
+ * @return the square root rounded down.
+ */
+static inline uint64_t gnss_isqrt(uint64_t x)
+{
+    uint64_t r = 0;
+    uint64_t b = 1ULL << 62;
+
+    while (b > x)
+        b >>= 2;
+    while (b) {
+        if (x >= r + b) {
+            x -= r + b;
+            r = (r >> 1) + b;
+        } else {
+            r >>= 1;
+        }
+        b >>= 2;
+    }
+    return r;
+}
+
+enum eUBX_MSG_CLASS {NAV = 0x01, RXM = 0x02, ACK = 0x05, CFG = 0x06, MON = 0x0A, LOG = 0x21};
+
+enum eUBX_MESSAGE  {UBX_LOG_BATCH, UBX_ACK_ACK, UBX_ACK_NAK, UBX_NAV_ODO, UBX_NAV_PVT, UBX_NAV_STATUS, UBX_NAV_SAT, UBX_NAV_EOE, UBX_MON_BATCH, UBX_RXM_RAWX, UBX_RXM_SFRBX, UNKNOWN_UBX};
 
 typedef struct UBX_ACK_ACK {
     uint8_t msg_class;
@@ -78,6 +137,10 @@ typedef struct UBX_NAV_PVT {
     int32_t lat; // scaling 1e-7
     int32_t height;
     int32_t speed;
+    uint8_t hour; // UTC time of day
+    uint8_t min;
+    uint8_t sec;
+    uint8_t valid; // validDate, validTime, fullyResolved and validMag.
 
 } tUBX_NAV_PVT;
 
@@ -89,6 +152,7 @@ typedef struct UBX_LOG_BATCH {
     uint32_t distance;
     uint32_t totalDistance;
     uint32_t distanceSTD;
+    uint16_t msgCnt;
 
 } tUBX_LOG_BATCH;
 
@@ -102,23 +166,103 @@ typedef struct UBX_CFG_BATCH {
 
 } tUBX_CFG_BATCH;
 
+typedef struct UBX_MON_BATCH {
+    uint16_t fillLevel;
+    uint16_t dropsAll;
+    uint16_t dropsSinceMon;
+    uint16_t nextMsgCnt;
+
+} tUBX_MON_BATCH;
+
 typedef struct UBX_NAV_STATUS {
     uint32_t itow;
     uint8_t fix;
     uint8_t flags;
     uint32_t ttff;
     uint32_t msss;
+    uint8_t flags2; // psmState in bits 0..1
 
 } tUBX_NAV_STATUS;
 
 typedef struct UBX_NAV_SAT {
     bool status;
+    uint32_t itow;
+    uint8_t numSvs;
 
 } tUBX_NAV_SAT;
 
+#define UBX_NAV_SAT_MAX_SVS 64
+#define UBX_NAV_SAT_FLAGS_SVUSED 0x00000008
+
+/** UBX-NAV-SAT satellites as structure of arrays, one array per field
+ */
+typedef struct UBX_NAV_SAT_TABLE {
+    uint32_t itow;
+    uint8_t numSvs;
+    uint8_t gnssId[UBX_NAV_SAT_MAX_SVS];
+    uint8_t svId[UBX_NAV_SAT_MAX_SVS];
+    uint8_t cno[UBX_NAV_SAT_MAX_SVS];     // dBHz
+    int8_t elev[UBX_NAV_SAT_MAX_SVS];     // deg
+    int16_t azim[UBX_NAV_SAT_MAX_SVS];    // deg
+    int16_t prRes[UBX_NAV_SAT_MAX_SVS];   // scaling 0.1 m
+    uint32_t flags[UBX_NAV_SAT_MAX_SVS];  // qualityInd, svUsed, health, ...
+
+} tUBX_NAV_SAT_TABLE;
+
+typedef struct UBX_NAV_SAT_STATS {
+    uint8_t numSvs;
+    uint8_t numUsed;       // satellites used in the navigation solution
+    uint8_t meanCno;       // dBHz, all tracked satellites
+    uint8_t meanCnoUsed;   // dBHz, satellites used in the solution
+    uint8_t maxCno;        // dBHz
+
+} tUBX_NAV_SAT_STATS;
+
+#define UBX_RXM_RAWX_MAX_MEAS 64
+
+/** UBX-RXM-RAWX measurements of one epoch, one contiguous array per observable.
+ *  The caller owns the structure and reuses it from epoch to epoch.
+ *  A full frame is 16 + 32 * numMeas bytes, size the GnssSerial rx pipe accordingly.
+ */
+typedef struct UBX_RXM_RAWX {
+    double rcvTow;     // s
+    uint16_t week;
+    int8_t leapS;
+    uint8_t numMeas;
+    uint8_t recStat;
+    double prMes[UBX_RXM_RAWX_MAX_MEAS];       // pseudorange, m
+    double cpMes[UBX_RXM_RAWX_MAX_MEAS];       // carrier phase, cycles
+    float doMes[UBX_RXM_RAWX_MAX_MEAS];        // doppler, Hz
+    uint8_t gnssId[UBX_RXM_RAWX_MAX_MEAS];
+    uint8_t svId[UBX_RXM_RAWX_MAX_MEAS];
+    uint8_t sigId[UBX_RXM_RAWX_MAX_MEAS];
+    uint8_t freqId[UBX_RXM_RAWX_MAX_MEAS];
+    uint16_t locktime[UBX_RXM_RAWX_MAX_MEAS];  // ms
+    uint8_t cno[UBX_RXM_RAWX_MAX_MEAS];        // dBHz
+    uint8_t prStdev[UBX_RXM_RAWX_MAX_MEAS];    // scaling 0.01 * 2^n m
+    uint8_t cpStdev[UBX_RXM_RAWX_MAX_MEAS];    // scaling 0.004 cycles
+    uint8_t doStdev[UBX_RXM_RAWX_MAX_MEAS];    // scaling 0.002 * 2^n Hz
+    uint8_t trkStat[UBX_RXM_RAWX_MAX_MEAS];
+
+} tUBX_RXM_RAWX;
+
+#define UBX_RXM_SFRBX_MAX_WORDS 16
+
+typedef struct UBX_RXM_SFRBX {
+    uint8_t gnssId;
+    uint8_t svId;
+    uint8_t sigId;
+    uint8_t freqId;
+    uint8_t numWords;
+    uint8_t chn;
+    uint8_t version;
+    uint32_t dwrd[UBX_RXM_SFRBX_MAX_WORDS];
+
+} tUBX_RXM_SFRBX;
+
 /** Basic GNSS parser class.
 */
-class GnssParser
+class GnssParser : public GnssFramer
 {
 public:
     /** Constructor.
@@ -128,19 +272,6 @@ public:
      */
     virtual ~GnssParser(void);
 
-    enum {
-        // getLine Responses
-        WAIT      = -1, //!< wait for more incoming data (the start of a message was found, or no data available)
-        NOT_FOUND =  0, //!< a parser concluded the the current offset of the pipe doe not contain a valid message
-
-#define LENGTH(x)   (x & 0x00FFFF)  //!< extract/mask the length
-#define PROTOCOL(x) (x & 0xFF0000)  //!< extract/mask the type
-
-        UNKNOWN   = 0x000000,       //!< message type is unknown
-        UBX       = 0x100000,       //!< message if of protocol NMEA
-        NMEA      = 0x200000        //!< message if of protocol UBX
-    };
-
     /** Get a line from the physical interface. This function
      * needs to be implemented in the inherited class.
      * @param buf the buffer to store it.
@@ -187,52 +318,7 @@ public:
     */
     void cutOffPower(void);
 
-    /** get the first character of a NMEA field.
-     * @param ix the index of the field to find.
-     * @param start the start of the buffer.
-     * @param end the end of the buffer.
-     * @return the pointer to the first character of the field.
-     */
-    static const char* findNmeaItemPos(int ix, const char* start, const char* end);
-
-    /** Extract a double value from a buffer containing a NMEA message.
-     * @param ix the index of the field to extract.
-     * @param buf the NMEA message.
-     * @param len the size of the NMEA message.
-     * @param val the extracted value.
-     * @return true if successful, false otherwise.
-     */
-    static bool getNmeaItem(int ix, char* buf, int len, double& val);
-
-    /** Extract a interger value from a buffer containing a NMEA message.
-     * @param ix the index of the field to extract.
-     * @param buf the NMEA message.
-     * @param len the size of the NMEA message.
-     * @param val the extracted value.
-     * @param base the numeric base to be used (e.g. 8, 10 or 16).
-     * @return true if successful, false otherwise.
-     */
-    static bool getNmeaItem(int ix, char* buf, int len, int& val, int base/*=10*/);
-
-    /** Extract a char value from a buffer containing a NMEA message.
-     * @param ix the index of the field to extract.
-     * @param buf the NMEA message.
-     * @param len the size of the NMEA message.
-     * @param val the extracted value.
-     * @return true if successful, false otherwise.
-     */
-    static bool getNmeaItem(int ix, char* buf, int len, char& val);
-
-    /** Extract a latitude/longitude value from a buffer containing a NMEA message.
-     * @param ix the index of the field to extract (will extract ix and ix + 1),
-     * @param buf the NMEA message,
-     * @param len the size of the NMEA message,
-     * @param val the extracted latitude or longitude,
-     * @return true if successful, false otherwise.
-     */
-    static bool getNmeaAngle(int ix, char* buf, int len, double& val);
-
-    /** Enable UBX messages.
+    /** Enable UBX messages and switch the UART to GNSS_TARGET_BAUD.
      * @param none
      * @return 1 if successful, false otherwise.
      */
@@ -268,6 +354,24 @@ public:
      */
     tUBX_LOG_BATCH decode_ubx_log_batch_msg(char *);
 
+    /** Method to decode UBX_RXM_RAWX into the per-observable arrays of an epoch
+     * @param buff the UXB message, int length, tUBX_RXM_RAWX to fill
+     * @return number of measurements decoded, -1 if the length does not match
+     */
+    int decode_ubx_rxm_rawx_msg(char *, int, tUBX_RXM_RAWX *);
+
+    /** Method to decode UBX_RXM_SFRBX
+     * @param buff the UXB message, int length, tUBX_RXM_SFRBX to fill
+     * @return number of data words decoded, -1 if the length does not match
+     */
+    int decode_ubx_rxm_sfrbx_msg(char *, int, tUBX_RXM_SFRBX *);
+
+    /** Method to parse contents of UBX_MON_BATCH and return decoded msg
+     * @param buff the UXB message
+     * @return tUBX_MON_BATCH
+     */
+    tUBX_MON_BATCH decode_ubx_mon_batch_msg(char *);
+
     /** Method to parse contents of UBX_NAV_STATUS and return decoded msg
      * @param buff the UXB message
      * @return tUBX_NAV_STATUS
@@ -280,44 +384,61 @@ public:
      */
     tUBX_NAV_SAT decode_ubx_nav_sat_msg(char *, int);
 
+    /** Method to decode all satellites of UBX_NAV_SAT into a table
+     * @param buff the UXB message, int length, tUBX_NAV_SAT_TABLE to fill
+     * @return number of satellites decoded, -1 if the length does not match
+     */
+    int decode_ubx_nav_sat_table(char *, int, tUBX_NAV_SAT_TABLE *);
+
+    /** Method to compute statistics over a decoded UBX_NAV_SAT table
+     * @param tUBX_NAV_SAT_TABLE the decoded satellites
+     * @return tUBX_NAV_SAT_STATS
+     */
+    static tUBX_NAV_SAT_STATS nav_sat_stats(const tUBX_NAV_SAT_TABLE *);
+
     /** Method to send UBX LOG-RETRIEVEBATCH msg. This message is used to request batched data.
      * @param bool
      * @return int
      */
     int ubx_request_batched_data(bool sendMonFirst = false);
 
-protected:
-    /** Power on the GNSS module.
-    */
-    void _powerOn(void);
+    /** Attach a function that gets the messages received by waitUbx() and
+     * waitAck() which are not the awaited one. Without it these are dropped.
+     * @param cb function called with the message buffer and the getMessage() return value.
+     */
+    void attach_skipped(Callback<void(const char*, int)> cb);
 
-    /** Get a line from the physical interface.
-     * @param pipe the receiveing pipe to parse messages .
-     * @param buf the buffer to store it.
-     * @param len size of the buffer.
-     * @return type and length if something was found,
-     *         WAIT if not enough data is available,
-     *         NOT_FOUND if nothing was found.
+    /** Pass a message received while waiting for another one to the
+     * function attached with attach_skipped(), for classes that wait on
+     * their own.
+     * @param buf the message.
+     * @param ret the getMessage() return value.
      */
-    static int _getMessage(Pipe<char>* pipe, char* buf, int len);
+    void skipped(const char *buf, int ret);
 
-    /** Check if the current offset of the pipe contains a NMEA message.
-     * @param pipe the receiveing pipe to parse messages.
-     * @param len numer of bytes to parse at maximum.
-     * @return length if something was found (including the NMEA frame),
-     *         WAIT if not enough data is available,
-     *         NOT_FOUND if nothing was found.
+    /** Wait for a specific UBX message. Other messages received in the
+     * meantime are passed to the function attached with attach_skipped().
+     * @param cls the UBX class id to wait for.
+     * @param id the UBX message id to wait for.
+     * @param buf the buffer to store the message (at least the size of the rx pipe).
+     * @param len size of the buffer.
+     * @param timeout_ms maximum time to wait in milliseconds.
+     * @return length of the message if found, 0 on timeout.
      */
-    static int _parseNmea(Pipe<char>* pipe, int len);
+    int waitUbx(unsigned char cls, unsigned char id, char* buf, int len, int timeout_ms);
 
-    /** Check if the current offset of the pipe contains a UBX message.
-     * @param pipe the receiveing pipe to parse messages.
-     * @param len numer of bytes to parse at maximum.
-     * @return length if something was found (including the UBX frame),
-     *         WAIT if not enough data is available,
-     *         NOT_FOUND if nothing was found.
+    /** Wait for the UBX-ACK-ACK or UBX-ACK-NAK of a message sent before.
+     * @param cls the UBX class id of the sent message.
+     * @param id the UBX message id of the sent message.
+     * @param timeout_ms maximum time to wait in milliseconds.
+     * @return 1 if acknowledged, 0 if not acknowledged or timeout.
      */
-    static int _parseUbx(Pipe<char>* pipe, int len);
+    int waitAck(unsigned char cls, unsigned char id, int timeout_ms);
+
+protected:
+    /** Power on the GNSS module.
+    */
+    void _powerOn(void);
 
     /** Write bytes to the physical interface. This function
      * needs to be implemented by the inherited class.
@@ -327,8 +448,8 @@ protected:
      */
     virtual int _send(const void* buf, int len) = 0;
 
-    static const char _toHex[16]; //!< num to hex conversion
     DigitalInOut *_gnssEnable;    //!< IO pin that enables GNSS
+    Callback<void(const char*, int)> _skipped; //!< sink for messages not awaited while waiting
 };
 
 /** GNSS class which uses a serial port as physical interface.
@@ -354,6 +475,9 @@ public:
     virtual ~GnssSerial(void);
 
     /** Initialise the GNSS device.
+     * Probes the candidate baud rates until the receiver answers with a
+     * valid UBX or NMEA frame and switches it to GNSS_TARGET_BAUD if needed.
+     * Returns as soon as the link at the target rate is verified.
      * @return true if successful, otherwise false.
      */
     virtual bool init();
@@ -374,6 +498,25 @@ protected:
      * @return bytes written.
      */
     virtual int _send(const void* buf, int len);
+
+    /** Check that the receiver answers at the current baud rate.
+     * Discards pending input, polls the port configuration and waits
+     * for the first valid UBX or NMEA frame. The poll is only answered when
+     * UBX output is enabled on the port.
+     * @param timeout_ms maximum time to wait in milliseconds.
+     * @param ubx true to accept only the UBX-CFG-PRT reply, to check UBX output.
+     * @return true if a valid frame was received, otherwise false.
+     */
+    bool _verifyLink(int timeout_ms, bool ubx = false);
+
+    /** Wait until the transmit pipe and the UART have sent all bytes.
+     * @param baudrate the current baud rate.
+     */
+    void _flushTx(int baudrate);
+
+#ifdef UBLOX_WEARABLE_FRAMEWORK
+    GnssSdLogger _sdLog;          //!< copy of the traffic on the SD card
+#endif
 };
 
 #endif
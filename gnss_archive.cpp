@@ -0,0 +1,353 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file gnss_archive.cpp
+ * This file implements the time indexed track archive.
+ */
+
+#include "gnss_archive.h"
+
+#ifdef GNSS_ARCHIVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static void index_path(char *buf, const char *path)
+{
+    snprintf(buf, GNSS_ARCHIVE_PATH_SIZE, "%s.idx", path);
+}
+
+// Open for update, create if missing
+static FILE *open_update(const char *path)
+{
+    FILE *f = fopen(path, "r+b");
+
+    if (f == NULL)
+        f = fopen(path, "w+b");
+    return f;
+}
+
+// Position at the new end, bytes behind it are overwritten by the next append
+static bool cut(FILE *f, long size)
+{
+#ifdef GNSS_ARCHIVE_MMAP
+    fflush(f);
+    if (ftruncate(fileno(f), size) != 0)
+        return false;
+#endif
+    return fseek(f, size, SEEK_SET) == 0;
+}
+
+// iTOW of the first record, the first delta of a block starts at zero
+static bool first_itow(const uint8_t *block, int len, uint32_t *itow)
+{
+    int32_t v;
+
+    if (GnssTrackDecoder::get_varint(&block[GNSS_TRACK_HEADER_SIZE], block + len, &v) < 0)
+        return false;
+    *itow = (uint32_t)v;
+    return true;
+}
+
+// ----------------------------------------------------------------
+// Writer
+// ----------------------------------------------------------------
+
+GnssArchiveWriter::GnssArchiveWriter(void) :
+    _data(NULL), _index(NULL), _offset(0), _indexEnd(0), _last(0), _failed(0)
+{
+}
+
+GnssArchiveWriter::~GnssArchiveWriter(void)
+{
+    close();
+}
+
+bool GnssArchiveWriter::open(const char *path)
+{
+    char idx[GNSS_ARCHIVE_PATH_SIZE];
+    tGNSS_ARCHIVE_INDEX e;
+    long dataSize;
+    long size;
+
+    close();
+    index_path(idx, path);
+    _data = open_update(path);
+    _index = open_update(idx);
+    if ((_data == NULL) || (_index == NULL)) {
+        close();
+        return false;
+    }
+
+    // Continue after the last complete entry whose block was written
+    fseek(_data, 0, SEEK_END);
+    dataSize = ftell(_data);
+    fseek(_index, 0, SEEK_END);
+    size = (ftell(_index) / sizeof(e)) * sizeof(e);
+    _offset = 0;
+    _last = 0;
+    for (; size > 0; size -= sizeof(e)) {
+        if ((fseek(_index, size - sizeof(e), SEEK_SET) != 0) || (fread(&e, sizeof(e), 1, _index) != 1)) {
+            close();
+            return false;
+        }
+        if (((long)e.offset + (long)e.length) <= dataSize) {
+            _offset = e.offset + e.length;
+            _last = e.time;
+            break;
+        }
+    }
+    if (!cut(_index, size) || !cut(_data, _offset)) {
+        close();
+        return false;
+    }
+    _indexEnd = size;
+    return true;
+}
+
+void GnssArchiveWriter::close(void)
+{
+    if (_data)
+        fclose(_data);
+    if (_index)
+        fclose(_index);
+    _data = NULL;
+    _index = NULL;
+}
+
+void GnssArchiveWriter::append(const uint8_t *block, int len)
+{
+    tGNSS_ARCHIVE_INDEX e;
+    uint32_t itow;
+
+    if ((_data == NULL) || (len < GNSS_TRACK_HEADER_SIZE) || !first_itow(block, len, &itow)) {
+        _failed++;
+        return;
+    }
+    e.time = GNSS_ARCHIVE_TIME(block[4] | (block[5] << 8), itow);
+    e.offset = _offset;
+    e.length = len;
+    if (e.time < _last) {
+        _failed++;
+        return;
+    }
+
+    // Data first, the index never points behind the end of the archive.
+    // A partial write is cut off again, as by open() after a power loss.
+    if ((fwrite(block, 1, len, _data) != (size_t)len) || (fflush(_data) != 0) ||
+            (fwrite(&e, sizeof(e), 1, _index) != 1) || (fflush(_index) != 0)) {
+        _failed++;
+        if (!cut(_index, _indexEnd) || !cut(_data, _offset))
+            close();            // further appends are refused
+        return;
+    }
+    _offset += len;
+    _indexEnd += sizeof(e);
+    _last = e.time;
+}
+
+// ----------------------------------------------------------------
+// Reader
+// ----------------------------------------------------------------
+
+GnssArchiveReader::GnssArchiveReader(void) :
+    _entries(0), _data(NULL), _index(NULL)
+{
+}
+
+GnssArchiveReader::~GnssArchiveReader(void)
+{
+    close();
+}
+
+#ifdef GNSS_ARCHIVE_MMAP
+
+// An empty file is valid and not mapped, *map stays NULL
+static bool map_file(const char *path, const void **map, size_t *size)
+{
+    struct stat st;
+    void *p;
+    int fd = ::open(path, O_RDONLY);
+
+    *map = NULL;
+    *size = 0;
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    if (st.st_size == 0) {
+        ::close(fd);
+        return true;
+    }
+    p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    *map = p;
+    *size = st.st_size;
+    return true;
+}
+
+bool GnssArchiveReader::open(const char *path)
+{
+    char idx[GNSS_ARCHIVE_PATH_SIZE];
+
+    close();
+    index_path(idx, path);
+    const void *data;
+    const void *index = NULL;
+    bool mapped = map_file(path, &data, &_dataSize) && map_file(idx, &index, &_indexSize);
+
+    _data = (const uint8_t *)data;
+    _index = (const tGNSS_ARCHIVE_INDEX *)index;
+    if (!mapped) {
+        close();
+        return false;
+    }
+    // Queries jump around in the index and read blocks once
+    if (_index)
+        madvise((void *)_index, _indexSize, MADV_RANDOM);
+    _entries = _indexSize / sizeof(tGNSS_ARCHIVE_INDEX);
+    return true;
+}
+
+void GnssArchiveReader::close(void)
+{
+    if (_data)
+        munmap((void *)_data, _dataSize);
+    if (_index)
+        munmap((void *)_index, _indexSize);
+    _data = NULL;
+    _index = NULL;
+    _entries = 0;
+}
+
+bool GnssArchiveReader::_entry(uint32_t i, tGNSS_ARCHIVE_INDEX *e)
+{
+    *e = _index[i];
+    return true;
+}
+
+const uint8_t *GnssArchiveReader::_block(const tGNSS_ARCHIVE_INDEX *e)
+{
+    if (((size_t)e->offset + e->length) > _dataSize)
+        return NULL;
+    return _data + e->offset;
+}
+
+#else
+
+bool GnssArchiveReader::open(const char *path)
+{
+    char idx[GNSS_ARCHIVE_PATH_SIZE];
+
+    close();
+    index_path(idx, path);
+    _data = fopen(path, "rb");
+    _index = fopen(idx, "rb");
+    if ((_data == NULL) || (_index == NULL)) {
+        close();
+        return false;
+    }
+    fseek(_index, 0, SEEK_END);
+    _entries = ftell(_index) / sizeof(tGNSS_ARCHIVE_INDEX);
+    return true;
+}
+
+void GnssArchiveReader::close(void)
+{
+    if (_data)
+        fclose(_data);
+    if (_index)
+        fclose(_index);
+    _data = NULL;
+    _index = NULL;
+    _entries = 0;
+}
+
+bool GnssArchiveReader::_entry(uint32_t i, tGNSS_ARCHIVE_INDEX *e)
+{
+    return (fseek(_index, i * sizeof(*e), SEEK_SET) == 0) && (fread(e, sizeof(*e), 1, _index) == 1);
+}
+
+const uint8_t *GnssArchiveReader::_block(const tGNSS_ARCHIVE_INDEX *e)
+{
+    if ((e->length > sizeof(_buf)) || (fseek(_data, e->offset, SEEK_SET) != 0) ||
+            (fread(_buf, 1, e->length, _data) != e->length))
+        return NULL;
+    return _buf;
+}
+
+#endif
+
+uint32_t GnssArchiveReader::_find(uint64_t time)
+{
+    tGNSS_ARCHIVE_INDEX e;
+    uint32_t lo = 0;
+    uint32_t hi = _entries;
+
+    // First entry starting after the time, the block before may contain it
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (!_entry(mid, &e))
+            return 0;
+        if (e.time <= time)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (lo > 0) ? lo - 1 : 0;
+}
+
+int GnssArchiveReader::query(uint64_t from, uint64_t to, GnssArchiveCallback cb)
+{
+    tGNSS_ARCHIVE_INDEX e;
+    int n = 0;
+
+    for (uint32_t i = _find(from); (i < _entries) && _entry(i, &e) && (e.time <= to); i++)
+    {
+        const uint8_t *block = _block(&e);
+        if ((block == NULL) || (GnssTrackDecoder::decode(block, e.length, &_cols) <= 0))
+            return -1;
+
+        // iTOW wraps at the end of the week
+        uint64_t week = e.time - _cols.itow[0];
+        int first = -1;
+        int last = 0;
+        for (int r = 0; r < _cols.count; r++) {
+            uint64_t t = week + _cols.itow[r];
+            if (_cols.itow[r] < _cols.itow[0])
+                t += GNSS_ARCHIVE_WEEK_MS;
+            if ((t >= from) && (t <= to)) {
+                if (first < 0)
+                    first = r;
+                last = r + 1;
+            }
+        }
+        if (first >= 0) {
+            cb(&_cols, first, last);
+            n += last - first;
+        }
+    }
+    return n;
+}
+
+// End Of File
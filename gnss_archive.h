@@ -0,0 +1,169 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GNSS_ARCHIVE_H
+#define GNSS_ARCHIVE_H
+
+/**
+ * @file gnss_archive.h
+ * This file defines a time indexed archive of track blocks (gnss_track.h).
+ * The blocks are appended to <path>, and for every block an entry with
+ * its first GPS time and file offset is appended to <path>.idx. Range
+ * queries binary search the index and only read the blocks in range.
+ * The files are written in the byte order of the host. Without mbed the
+ * archive builds on the host with gnss_track.cpp and gnss_framer.cpp.
+ */
+
+#include "gnss_track.h"
+
+#if !defined(__MBED__) && (defined(__unix__) || defined(__APPLE__))
+#define GNSS_ARCHIVE_MMAP   // the reader maps the files, fread otherwise
+#endif
+
+#ifdef __MBED__
+typedef Callback<void(const tGNSS_TRACK_COLUMNS *, int, int)> GnssArchiveCallback;
+#else
+#include <functional>
+typedef std::function<void(const tGNSS_TRACK_COLUMNS *, int, int)> GnssArchiveCallback;
+#endif
+
+#define GNSS_ARCHIVE_WEEK_MS 604800000ULL
+#define GNSS_ARCHIVE_PATH_SIZE 128
+
+/** GPS time in ms since the start of week 0.
+ */
+#define GNSS_ARCHIVE_TIME(week, itow) ((uint64_t)(week) * GNSS_ARCHIVE_WEEK_MS + (itow))
+
+typedef struct GNSS_ARCHIVE_INDEX {
+    uint64_t time;     // GNSS_ARCHIVE_TIME of the first record
+    uint32_t offset;   // of the block in the archive
+    uint32_t length;   // of the block
+
+} tGNSS_ARCHIVE_INDEX;
+
+/** Archive writer.
+ * append() has the signature of the GnssTrackEncoder sink.
+ */
+class GnssArchiveWriter
+{
+public:
+    /** Constructor.
+     */
+    GnssArchiveWriter(void);
+
+    /** Destructor, closes the archive.
+     */
+    ~GnssArchiveWriter(void);
+
+    /** Open an archive for appending, it is created if needed. A torn
+     * index entry and data behind the last indexed block, left by a
+     * power loss, are cut off.
+     * @param path the archive file name.
+     * @return true if successful, false otherwise.
+     */
+    bool open(const char *path);
+
+    /** Close the archive.
+     */
+    void close(void);
+
+    /** Append a block. Blocks older than the last one are rejected as
+     * the index must be sorted. After a failed write both files are cut
+     * back to the last block, if that fails too the archive is closed.
+     * @param block the block.
+     * @param len the length of the block.
+     */
+    void append(const uint8_t *block, int len);
+
+    /** Number of blocks rejected or not written.
+     * @return the counter.
+     */
+    uint32_t failed(void) const { return _failed; }
+
+private:
+    FILE *_data;
+    FILE *_index;
+    uint32_t _offset;     //!< size of the archive
+    long _indexEnd;       //!< size of the index
+    uint64_t _last;       //!< time of the last block
+    uint32_t _failed;
+};
+
+/** Archive reader.
+ */
+class GnssArchiveReader
+{
+public:
+    /** Constructor.
+     */
+    GnssArchiveReader(void);
+
+    /** Destructor, closes the archive.
+     */
+    ~GnssArchiveReader(void);
+
+    /** Open an archive.
+     * @param path the archive file name.
+     * @return true if successful, false otherwise.
+     */
+    bool open(const char *path);
+
+    /** Close the archive.
+     */
+    void close(void);
+
+    /** Number of blocks in the archive.
+     * @return the number of index entries.
+     */
+    uint32_t blocks(void) const { return _entries; }
+
+    /** Get the records between two times, the callback is called for
+     * every block in range with the index range of the matching records.
+     * @param from first GNSS_ARCHIVE_TIME (included).
+     * @param to last GNSS_ARCHIVE_TIME (included).
+     * @param cb the callback, receives the block and the first and last + 1 record.
+     * @return number of records, -1 if a block is invalid.
+     */
+    int query(uint64_t from, uint64_t to, GnssArchiveCallback cb);
+
+protected:
+    /** Find the last block starting at or before a time.
+     * @param time the GNSS_ARCHIVE_TIME.
+     * @return the index entry number, 0 if all blocks start later.
+     */
+    uint32_t _find(uint64_t time);
+
+    bool _entry(uint32_t i, tGNSS_ARCHIVE_INDEX *e);
+    const uint8_t *_block(const tGNSS_ARCHIVE_INDEX *e);
+
+private:
+    uint32_t _entries;
+#ifdef GNSS_ARCHIVE_MMAP
+    const uint8_t *_data;
+    size_t _dataSize;
+    const tGNSS_ARCHIVE_INDEX *_index;
+    size_t _indexSize;
+#else
+    FILE *_data;
+    FILE *_index;
+    uint8_t _buf[GNSS_TRACK_BLOCK_SIZE];
+#endif
+    tGNSS_TRACK_COLUMNS _cols;
+};
+
+#endif
+
+// End Of File
@@ -0,0 +1,431 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file gnss_assist.cpp
+ * This file implements the upload of AssistNow (UBX-MGA) assistance data.
+ */
+
+#include "gnss_assist.h"
+
+#define UBX_CLASS_MGA       0x13
+#define UBX_ID_MGA_ANO      0x20
+#define UBX_ID_MGA_INI      0x40
+#define UBX_ID_MGA_ACK      0x60
+#define UBX_ID_MGA_DBD      0x80
+
+#define DBD_FILE_MAGIC      0x44424447 // "GDBD"
+#define DBD_FILE_VERSION    1
+
+GnssAssist::GnssAssist(GnssOperations *gnss, int window) :
+    _gnss(gnss), _window(window), _count(0), _first(0)
+{
+    if ((_window < 1) || (_window > GNSS_ASSIST_WINDOW))
+        _window = GNSS_ASSIST_WINDOW;
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+int GnssAssist::enable_ack_aiding(void)
+{
+    if (_gnss->has_cfg_valset()) {
+        const tUBX_CFG_KEYVAL item = {UBX_CFG_NAVSPG_ACKAIDING, 1};
+        return _gnss->cfg_valset(&item, 1, UBX_CFG_LAYER_RAM);
+    }
+
+    // UBX-CFG-NAVX5 version 2, only the ackAiding field is applied
+    unsigned char ubx_cfg_navx5[40];
+    memset(ubx_cfg_navx5, 0, sizeof(ubx_cfg_navx5));
+    ubx_cfg_navx5[0] = 0x02;  // version
+    ubx_cfg_navx5[2] = 0x00;  // mask1 - ackAid
+    ubx_cfg_navx5[3] = 0x04;
+    ubx_cfg_navx5[17] = 0x01; // ackAiding
+
+    if (_gnss->sendUbx(0x06, 0x23, ubx_cfg_navx5, sizeof(ubx_cfg_navx5)) < (int)(sizeof(ubx_cfg_navx5) + UBX_FRAME_SIZE))
+        return 0;
+    return _gnss->waitAck(0x06, 0x23, 500);
+}
+
+void GnssAssist::begin(void)
+{
+    memset(&_stats, 0, sizeof(_stats));
+    _count = 0;
+    _first = 0;
+}
+
+bool GnssAssist::_waitWindow(int room)
+{
+    char buf[UBX_WAIT_BUFFER_SIZE];
+    Timer timer;
+    int ret;
+
+    timer.start();
+    while ((_window - _count) < room)
+    {
+        if (timer.read_ms() >= GNSS_ASSIST_ACK_TIMEOUT_MS) {
+            // No acknowledge at all, ack aiding is probably disabled
+            _stats.lost += _count;
+            _count = 0;
+            return false;
+        }
+
+        ret = _gnss->getMessage(buf, sizeof(buf));
+        if (ret == GnssParser::WAIT) {
+            thread_sleep_for(1);
+            continue;
+        }
+        if ((ret <= 0) || (PROTOCOL(ret) != GnssParser::UBX) || (LENGTH(ret) < (UBX_FRAME_SIZE + 8)) ||
+                ((uint8_t)buf[MSG_CLASS_INDEX] != UBX_CLASS_MGA) || ((uint8_t)buf[MSG_ID_INDEX] != UBX_ID_MGA_ACK)) {
+            _gnss->skipped(buf, ret);
+            continue;
+        }
+
+        // UBX-MGA-ACK-DATA0: type, version, infoCode, msgId, msgPayloadStart[4]
+        const char *ack = &buf[UBX_PAYLOAD_INDEX];
+        for (int n = 0; n < _count; n++) {
+            tOUTSTANDING *o = &_outstanding[(_first + n) % GNSS_ASSIST_WINDOW];
+            if ((o->msgId == (uint8_t)ack[3]) && !memcmp(o->payloadStart, &ack[4], 4)) {
+                // Acknowledges come in order, older messages were dropped
+                _stats.lost += n;
+                if (ack[0] == 0x01)
+                    _stats.acked++;
+                else
+                    _stats.nacked++;
+                _first = (_first + n + 1) % GNSS_ASSIST_WINDOW;
+                _count -= n + 1;
+                timer.reset();
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+int GnssAssist::push(const char *frame, int len)
+{
+    tOUTSTANDING *o;
+
+    if (len < UBX_FRAME_SIZE)
+        return 0;
+    _waitWindow(1);
+
+    o = &_outstanding[(_first + _count) % GNSS_ASSIST_WINDOW];
+    o->msgId = frame[MSG_ID_INDEX];
+    memset(o->payloadStart, 0, sizeof(o->payloadStart));
+    memcpy(o->payloadStart, &frame[UBX_PAYLOAD_INDEX], (len - UBX_FRAME_SIZE) < 4 ? (len - UBX_FRAME_SIZE) : 4);
+    _count++;
+
+    if (_gnss->send(frame, len) < len)
+        return 0;
+    _stats.sent++;
+    return 1;
+}
+
+int GnssAssist::finish(tGNSS_ASSIST_STATS *stats)
+{
+    _waitWindow(_window);
+    if (stats)
+        *stats = _stats;
+    return _stats.acked;
+}
+
+static int _buildFrame(char *frame, unsigned char cls, unsigned char id, const unsigned char *payload, int len)
+{
+    int ca = 0;
+    int cb = 0;
+
+    frame[0] = 0xB5;
+    frame[1] = 0x62;
+    frame[2] = cls;
+    frame[3] = id;
+    frame[4] = len & 0xFF;
+    frame[5] = (len >> 8) & 0xFF;
+    memcpy(&frame[UBX_PAYLOAD_INDEX], payload, len);
+    for (int i = 2; i < UBX_PAYLOAD_INDEX + len; i++) {
+        ca += (uint8_t)frame[i];
+        cb += ca;
+    }
+    frame[UBX_PAYLOAD_INDEX + len] = ca & 0xFF;
+    frame[UBX_PAYLOAD_INDEX + len + 1] = cb & 0xFF;
+    return len + UBX_FRAME_SIZE;
+}
+
+int GnssAssist::send_time(time_t utc, uint16_t accuracy_s)
+{
+    unsigned char ubx_mga_ini_time_utc[24];
+    char frame[sizeof(ubx_mga_ini_time_utc) + UBX_FRAME_SIZE];
+    struct tm *t = gmtime(&utc);
+
+    if (t == NULL)
+        return 0;
+    memset(ubx_mga_ini_time_utc, 0, sizeof(ubx_mga_ini_time_utc));
+    ubx_mga_ini_time_utc[0] = 0x10;                          // type TIME_UTC
+    ubx_mga_ini_time_utc[2] = 0x00;                          // ref - on receipt of message
+    ubx_mga_ini_time_utc[3] = 0x80;                          // leapSecs - unknown
+    ubx_mga_ini_time_utc[4] = (t->tm_year + 1900) & 0xFF;
+    ubx_mga_ini_time_utc[5] = ((t->tm_year + 1900) >> 8) & 0xFF;
+    ubx_mga_ini_time_utc[6] = t->tm_mon + 1;
+    ubx_mga_ini_time_utc[7] = t->tm_mday;
+    ubx_mga_ini_time_utc[8] = t->tm_hour;
+    ubx_mga_ini_time_utc[9] = t->tm_min;
+    ubx_mga_ini_time_utc[10] = t->tm_sec;
+    ubx_mga_ini_time_utc[16] = accuracy_s & 0xFF;            // tAccS
+    ubx_mga_ini_time_utc[17] = (accuracy_s >> 8) & 0xFF;
+
+    return push(frame, _buildFrame(frame, UBX_CLASS_MGA, UBX_ID_MGA_INI, ubx_mga_ini_time_utc, sizeof(ubx_mga_ini_time_utc)));
+}
+
+int GnssAssist::send_position(const tGNSS_ASSIST_POSITION *pos)
+{
+    unsigned char ubx_mga_ini_pos_llh[20];
+    char frame[sizeof(ubx_mga_ini_pos_llh) + UBX_FRAME_SIZE];
+    int32_t alt = pos->height / 10;      // cm
+    uint32_t acc = pos->acc * 100;       // cm
+
+    memset(ubx_mga_ini_pos_llh, 0, sizeof(ubx_mga_ini_pos_llh));
+    ubx_mga_ini_pos_llh[0] = 0x01;       // type POS_LLH
+    for (int i = 0; i < 4; i++) {
+        ubx_mga_ini_pos_llh[4 + i] = (pos->lat >> (8 * i)) & 0xFF;
+        ubx_mga_ini_pos_llh[8 + i] = (pos->lon >> (8 * i)) & 0xFF;
+        ubx_mga_ini_pos_llh[12 + i] = (alt >> (8 * i)) & 0xFF;
+        ubx_mga_ini_pos_llh[16 + i] = (acc >> (8 * i)) & 0xFF;
+    }
+
+    return push(frame, _buildFrame(frame, UBX_CLASS_MGA, UBX_ID_MGA_INI, ubx_mga_ini_pos_llh, sizeof(ubx_mga_ini_pos_llh)));
+}
+
+int GnssAssist::_readFrame(FILE *fp, char *buf, int len)
+{
+    int c;
+
+    for (;;) {
+        // Find the sync characters
+        if ((c = fgetc(fp)) == EOF)
+            return 0;
+        if (c != 0xB5)
+            continue;
+        if ((c = fgetc(fp)) == EOF)
+            return 0;
+        if (c != 0x62)
+            continue;
+
+        buf[SYNC_CHAR_INDEX_1] = 0xB5;
+        buf[SYNC_CHAR_INDEX_2] = 0x62;
+        if (fread(&buf[MSG_CLASS_INDEX], 1, 4, fp) != 4)
+            return 0;
+        int size = ubx_u2(&buf[UBX_LENGTH_INDEX]) + UBX_FRAME_SIZE;
+        if (size > len) {
+            fseek(fp, size - UBX_PAYLOAD_INDEX, SEEK_CUR);
+            continue;
+        }
+        if (fread(&buf[UBX_PAYLOAD_INDEX], 1, size - UBX_PAYLOAD_INDEX, fp) != (size_t)(size - UBX_PAYLOAD_INDEX))
+            return 0;
+
+        int ca = 0;
+        int cb = 0;
+        for (int i = 2; i < size - 2; i++) {
+            ca += (uint8_t)buf[i];
+            cb += ca;
+        }
+        if (((ca & 0xFF) == (uint8_t)buf[size - 2]) && ((cb & 0xFF) == (uint8_t)buf[size - 1]))
+            return size;
+    }
+}
+
+int GnssAssist::upload(const char *path, time_t utc, const tGNSS_ASSIST_POSITION *pos, tGNSS_ASSIST_STATS *stats)
+{
+    char frame[GNSS_ASSIST_FRAME_SIZE];
+    struct tm today = {};
+    bool dated = false;
+    FILE *fp;
+    int len;
+
+    fp = fopen(path, "rb");
+    if (fp == NULL)
+        return -1;
+
+    begin();
+    if (utc) {
+        const struct tm *t = gmtime(&utc);
+        if (t != NULL) {
+            today = *t;
+            dated = true;
+        }
+        send_time(utc);
+    }
+    if (pos)
+        send_position(pos);
+
+    while ((len = _readFrame(fp, frame, sizeof(frame))) > 0)
+    {
+        _stats.read++;
+        if ((uint8_t)frame[MSG_CLASS_INDEX] != UBX_CLASS_MGA) {
+            _stats.skipped++;
+            continue;
+        }
+        // Time and position from the file are older than ours
+        if (((uint8_t)frame[MSG_ID_INDEX] == UBX_ID_MGA_INI) && (utc || pos)) {
+            _stats.skipped++;
+            continue;
+        }
+        // AssistNow Offline: only the orbit predictions of today
+        if (((uint8_t)frame[MSG_ID_INDEX] == UBX_ID_MGA_ANO) && dated && (len >= UBX_FRAME_SIZE + 7) &&
+                (((uint8_t)frame[UBX_PAYLOAD_INDEX + 4] != (today.tm_year - 100)) ||
+                 ((uint8_t)frame[UBX_PAYLOAD_INDEX + 5] != (today.tm_mon + 1)) ||
+                 ((uint8_t)frame[UBX_PAYLOAD_INDEX + 6] != today.tm_mday))) {
+            _stats.skipped++;
+            continue;
+        }
+        push(frame, len);
+    }
+    fclose(fp);
+
+    return finish(stats);
+}
+
+// ----------------------------------------------------------------
+// Navigation database: header, payloads with a 16 bit length, CRC-32
+// ----------------------------------------------------------------
+
+int GnssAssist::dbd_save(const char *path, int timeout_ms)
+{
+    char buf[UBX_WAIT_BUFFER_SIZE];
+    char tmp[GNSS_DBD_PATH_SIZE];
+    uint32_t header[3] = { DBD_FILE_MAGIC, DBD_FILE_VERSION, 0 };
+    uint32_t crc = 0;
+    FILE *fp = NULL;
+    Timer timer, idle;
+    int ok = 1;
+    int ret;
+
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp))
+        return -1;
+    if (_gnss->sendUbx(UBX_CLASS_MGA, UBX_ID_MGA_DBD) < UBX_FRAME_SIZE)
+        return -1;
+
+    timer.start();
+    idle.start();
+    while (ok && (timer.read_ms() < timeout_ms) && (idle.read_ms() < GNSS_DBD_IDLE_MS))
+    {
+        ret = _gnss->getMessage(buf, sizeof(buf));
+        if (ret == GnssParser::WAIT) {
+            thread_sleep_for(1);
+            continue;
+        }
+        if ((ret <= 0) || (PROTOCOL(ret) != GnssParser::UBX) ||
+                ((uint8_t)buf[MSG_CLASS_INDEX] != UBX_CLASS_MGA) || ((uint8_t)buf[MSG_ID_INDEX] != UBX_ID_MGA_DBD)) {
+            _gnss->skipped(buf, ret);
+            continue;
+        }
+
+        // Open the file with the first message, keeps the old one otherwise
+        if (fp == NULL) {
+            fp = fopen(tmp, "wb");
+            if (fp == NULL)
+                return -1;
+            ok = (fwrite(header, sizeof(header), 1, fp) == 1);
+        }
+        uint16_t len = LENGTH(ret) - UBX_FRAME_SIZE;
+        ok = ok && (fwrite(&len, sizeof(len), 1, fp) == 1) &&
+             (fwrite(&buf[UBX_PAYLOAD_INDEX], 1, len, fp) == len);
+        crc = gnss_crc32(crc, &len, sizeof(len));
+        crc = gnss_crc32(crc, &buf[UBX_PAYLOAD_INDEX], len);
+        header[2]++;
+        idle.reset();
+    }
+
+    if (fp == NULL)
+        return 0;
+    // Only an idle gap ends the dump, at the timeout the receiver may still be sending
+    ok = ok && (idle.read_ms() >= GNSS_DBD_IDLE_MS);
+    ok = ok && (fwrite(&crc, sizeof(crc), 1, fp) == 1);
+    ok = ok && (fseek(fp, 0, SEEK_SET) == 0) && (fwrite(header, sizeof(header), 1, fp) == 1);
+    ok = (fclose(fp) == 0) && ok;
+    if (ok && (rename(tmp, path) != 0)) {
+        // Not every file system replaces an existing file
+        remove(path);
+        ok = (rename(tmp, path) == 0);
+    }
+    if (!ok) {
+        remove(tmp);
+        return -1;
+    }
+
+    return (int)header[2];
+}
+
+int GnssAssist::dbd_restore(const char *path, tGNSS_ASSIST_STATS *stats)
+{
+    char frame[UBX_WAIT_BUFFER_SIZE];
+    unsigned char payload[UBX_WAIT_BUFFER_SIZE - UBX_FRAME_SIZE];
+    uint32_t header[3];
+    uint32_t crc = 0;
+    uint32_t stored;
+    uint16_t len;
+    FILE *fp = fopen(path, "rb");
+
+    if (fp == NULL)
+        return -1;
+    if ((fread(header, sizeof(header), 1, fp) != 1) ||
+            (header[0] != DBD_FILE_MAGIC) || (header[1] != DBD_FILE_VERSION)) {
+        fclose(fp);
+        return -1;
+    }
+    // Check the whole file before sending anything
+    for (uint32_t i = 0; i < header[2]; i++) {
+        if ((fread(&len, sizeof(len), 1, fp) != 1) || (len > sizeof(payload)) ||
+                (fread(payload, 1, len, fp) != len)) {
+            fclose(fp);
+            return -1;
+        }
+        crc = gnss_crc32(crc, &len, sizeof(len));
+        crc = gnss_crc32(crc, payload, len);
+    }
+    if ((fread(&stored, sizeof(stored), 1, fp) != 1) || (stored != crc)) {
+        fclose(fp);
+        return -1;
+    }
+
+    fseek(fp, sizeof(header), SEEK_SET);
+    begin();
+    for (uint32_t i = 0; i < header[2]; i++) {
+        if ((fread(&len, sizeof(len), 1, fp) != 1) || (fread(payload, 1, len, fp) != len))
+            break;
+        _stats.read++;
+        push(frame, _buildFrame(frame, UBX_CLASS_MGA, UBX_ID_MGA_DBD, payload, len));
+    }
+    fclose(fp);
+
+    return finish(stats);
+}
+
+int GnssAssist::save_and_cut_off_power(const char *path)
+{
+    int ret = dbd_save(path);
+
+    _gnss->cutOffPower();
+    return ret;
+}
+
+int GnssAssist::power_on_and_restore(const char *path, tGNSS_ASSIST_STATS *stats)
+{
+    // init() powers the module on and restores the link
+    if (!_gnss->init())
+        return -1;
+    enable_ack_aiding();
+    return dbd_restore(path, stats);
+}
+
+// End Of File
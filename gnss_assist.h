@@ -0,0 +1,182 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GNSS_ASSIST_H
+#define GNSS_ASSIST_H
+
+/**
+ * @file gnss_assist.h
+ * This file defines the upload of AssistNow (UBX-MGA) assistance data.
+ */
+
+#include "gnss_operations.h"
+#include <time.h>
+
+#define GNSS_ASSIST_WINDOW 8
+#define GNSS_ASSIST_ACK_TIMEOUT_MS 1000
+#define GNSS_ASSIST_FRAME_SIZE 256
+#define GNSS_DBD_IDLE_MS 500
+#define GNSS_DBD_TIMEOUT_MS 10000
+#define GNSS_DBD_PATH_SIZE 128
+
+typedef struct GNSS_ASSIST_POSITION {
+    int32_t lon;     // scaling 1e-7
+    int32_t lat;     // scaling 1e-7
+    int32_t height;  // mm
+    uint32_t acc;    // m
+
+} tGNSS_ASSIST_POSITION;
+
+typedef struct GNSS_ASSIST_STATS {
+    int read;       // frames read from the file
+    int skipped;    // frames not relevant for the current time
+    int sent;       // frames sent to the receiver
+    int acked;      // frames accepted by the receiver
+    int nacked;     // frames rejected by the receiver
+    int lost;       // frames without UBX-MGA-ACK-DATA0 before the timeout
+
+} tGNSS_ASSIST_STATS;
+
+/** AssistNow upload engine.
+ * Streams UBX-MGA messages to the receiver with up to GNSS_ASSIST_WINDOW
+ * messages waiting for their UBX-MGA-ACK-DATA0. Other messages received
+ * meanwhile go to the function attached with GnssParser::attach_skipped().
+ */
+class GnssAssist
+{
+public:
+    /** Constructor.
+     * @param gnss the receiver.
+     * @param window maximum number of messages without acknowledge.
+     */
+    GnssAssist(GnssOperations *gnss, int window = GNSS_ASSIST_WINDOW);
+
+    /** Enable UBX-MGA-ACK-DATA0 output, required for the flow control.
+     * Uses UBX-CFG-VALSET on generation 9 receivers and UBX-CFG-NAVX5 otherwise.
+     * @return 1 if successful, 0 otherwise.
+     */
+    int enable_ack_aiding(void);
+
+    /** Upload an AssistNow Online or Offline file.
+     * Sends the current time and position first (UBX-MGA-INI), then the
+     * messages of the file. UBX-MGA-ANO messages of other days and
+     * UBX-MGA-INI messages of the file are skipped. The messages are only
+     * selected by time: the orbit data in the file is not tied to a
+     * position, so the position is passed to the receiver, which uses it
+     * to choose the satellites to search, and is not used as a filter.
+     * @param path the file with the UBX-MGA frames.
+     * @param utc the current UTC time, 0 if unknown.
+     * @param pos the approximate position, NULL if unknown.
+     * @param stats optional statistics.
+     * @return number of frames accepted, -1 if the file cannot be read.
+     */
+    int upload(const char *path, time_t utc, const tGNSS_ASSIST_POSITION *pos, tGNSS_ASSIST_STATS *stats = NULL);
+
+    /** Send UBX-MGA-INI-TIME_UTC.
+     * @param utc the current UTC time.
+     * @param accuracy_s time accuracy (s).
+     * @return 1 if sent, 0 otherwise.
+     */
+    int send_time(time_t utc, uint16_t accuracy_s = 2);
+
+    /** Send UBX-MGA-INI-POS_LLH.
+     * @param pos the approximate position.
+     * @return 1 if sent, 0 otherwise.
+     */
+    int send_position(const tGNSS_ASSIST_POSITION *pos);
+
+    /** Start a flow controlled transfer, resets the statistics.
+     */
+    void begin(void);
+
+    /** Send a complete UBX frame, waits while the window is full.
+     * @param frame the frame including sync characters and checksum.
+     * @param len the length of the frame.
+     * @return 1 if sent, 0 otherwise.
+     */
+    int push(const char *frame, int len);
+
+    /** Wait for the outstanding acknowledges and end the transfer.
+     * @param stats optional statistics.
+     * @return number of frames accepted.
+     */
+    int finish(tGNSS_ASSIST_STATS *stats = NULL);
+
+    /** Poll the navigation database (UBX-MGA-DBD) and write it to a file.
+     * The dump ends when the receiver stays silent for GNSS_DBD_IDLE_MS.
+     * It is written to path.tmp first, which replaces an existing file only
+     * once the dump ended this way and the file is complete.
+     * @param path the file name.
+     * @param timeout_ms maximum duration of the dump.
+     * @return number of messages written, 0 if the receiver returned no data,
+     *         -1 on failure or if the dump did not end within timeout_ms.
+     */
+    int dbd_save(const char *path, int timeout_ms = GNSS_DBD_TIMEOUT_MS);
+
+    /** Write a navigation database saved by dbd_save() back to the receiver.
+     * The file is checked completely before the first message is sent.
+     * @param path the file name.
+     * @param stats optional statistics.
+     * @return number of messages accepted, -1 if the file is invalid.
+     */
+    int dbd_restore(const char *path, tGNSS_ASSIST_STATS *stats = NULL);
+
+    /** Save the navigation database, then cut off the power supply.
+     * @param path the file name.
+     * @return number of messages saved, -1 on failure.
+     */
+    int save_and_cut_off_power(const char *path);
+
+    /** Power on the receiver and restore the navigation database.
+     * @param path the file name.
+     * @param stats optional statistics.
+     * @return number of messages accepted, -1 on failure.
+     */
+    int power_on_and_restore(const char *path, tGNSS_ASSIST_STATS *stats = NULL);
+
+protected:
+    /** Read the next valid UBX frame from a file.
+     * @param fp the file.
+     * @param buf the buffer to store the frame.
+     * @param len size of the buffer.
+     * @return length of the frame, 0 at the end of the file.
+     */
+    static int _readFrame(FILE *fp, char *buf, int len);
+
+    /** Process received messages until the window has room or timeout.
+     * @param room number of free window slots required.
+     * @return true if there is room, false on timeout.
+     */
+    bool _waitWindow(int room);
+
+    GnssOperations *_gnss;
+    tGNSS_ASSIST_STATS _stats;
+
+private:
+    typedef struct {
+        uint8_t msgId;
+        uint8_t payloadStart[4];
+    } tOUTSTANDING;
+
+    int _window;
+    int _count;                                  //!< outstanding messages
+    int _first;                                  //!< oldest outstanding message
+    tOUTSTANDING _outstanding[GNSS_ASSIST_WINDOW];
+};
+
+#endif
+
+// End Of File
@@ -0,0 +1,191 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GNSS_BROADCAST_H
+#define GNSS_BROADCAST_H
+
+/**
+ * @file gnss_broadcast.h
+ * This file defines a broadcast ring that hands every message received
+ * from the GNSS to any number of subscribers.
+ */
+
+#include "gnss.h"
+#include <atomic>
+
+/** Filter bits of a subscriber, one bit per eUBX_MESSAGE plus NMEA
+ */
+#define GNSS_BROADCAST_UBX(type)  (1UL << (type))
+#define GNSS_BROADCAST_NMEA       (1UL << 31)
+#define GNSS_BROADCAST_ALL        0xFFFFFFFFUL
+
+/** Broadcast ring.
+ * The parsing thread writes each message once into one of SLOTS slots
+ * of SIZE bytes. Every subscriber follows with its own cursor, a slow
+ * subscriber is overrun and counts the lost messages instead of
+ * stalling the writer.
+ */
+template <int SLOTS, int SIZE>
+class GnssBroadcast
+{
+public:
+    /** Constructor
+     */
+    GnssBroadcast(void) : _head(0), _dropped(0)
+    {
+        for (int i = 0; i < SLOTS; i++)
+            _slots[i].seq.store(0, std::memory_order_relaxed);
+    }
+
+    // writing thread/context API (single writer)
+    //-------------------------------------------------------------
+
+    /** Publish a message returned by getMessage.
+     * @param parser the parser used to classify the message.
+     * @param buf the message.
+     * @param ret the return value of getMessage (protocol and length).
+     * @return true if published, false if the message was too large.
+     */
+    bool publish(GnssParser *parser, char *buf, int ret)
+    {
+        int len = LENGTH(ret);
+        uint32_t n = _head.load(std::memory_order_relaxed) + 1;
+        Slot &slot = _slots[(n - 1) % SLOTS];
+
+        if ((ret <= 0) || (len > SIZE)) {
+            _dropped++;
+            return false;
+        }
+
+        slot.seq.store(2 * n - 1, std::memory_order_relaxed); // odd: write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.len = len;
+        slot.protocol = PROTOCOL(ret);
+        slot.type = (PROTOCOL(ret) == GnssParser::NMEA) ? GNSS_BROADCAST_NMEA :
+                    (PROTOCOL(ret) == GnssParser::UBX) ? GNSS_BROADCAST_UBX(parser->get_ubx_message(buf)) : 0;
+        memcpy(slot.data, buf, len);
+        slot.seq.store(2 * n, std::memory_order_release);
+        _head.store(n, std::memory_order_release);
+        return true;
+    }
+
+    /** Number of messages not published because they were too large.
+     * @return the counter.
+     */
+    uint32_t dropped(void) const { return _dropped; }
+
+    /** Subscriber, owned and used by a single reading thread.
+     */
+    class Subscriber
+    {
+    public:
+        /** Constructor, starts with the next published message.
+         * @param ring the broadcast ring to follow.
+         * @param filter combination of GNSS_BROADCAST_UBX(type) and GNSS_BROADCAST_NMEA.
+         */
+        Subscriber(GnssBroadcast *ring, uint32_t filter = GNSS_BROADCAST_ALL) :
+            _ring(ring), _filter(filter), _overflow(0)
+        {
+            _cursor = ring->_head.load(std::memory_order_acquire) + 1;
+        }
+
+        /** Get the next message matching the filter.
+         * @param buf the buffer to store it.
+         * @param len size of the buffer.
+         * @return type and length like getMessage, or
+         *         GnssParser::WAIT if no message is available.
+         */
+        int get(char *buf, int len)
+        {
+            for (;;) {
+                uint32_t head = _ring->_head.load(std::memory_order_acquire);
+                if (_cursor > head)
+                    return GnssParser::WAIT;
+
+                Slot &slot = _ring->_slots[(_cursor - 1) % SLOTS];
+                uint32_t s1 = slot.seq.load(std::memory_order_acquire);
+                if (s1 != 2 * _cursor) {
+                    _skip(head);
+                    continue;
+                }
+                uint32_t type = slot.type;
+                int size = slot.len;
+                int protocol = slot.protocol;
+                bool match = (type & _filter) && (size <= len);
+                if (match)
+                    memcpy(buf, slot.data, size);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.seq.load(std::memory_order_relaxed) != s1) {
+                    // overwritten while copying
+                    _skip(_ring->_head.load(std::memory_order_acquire));
+                    continue;
+                }
+                _cursor++;
+                if (match)
+                    return protocol | size;
+            }
+        }
+
+        /** Number of messages published but not yet read.
+         * @return the lag.
+         */
+        uint32_t lag(void) const
+        {
+            return _ring->_head.load(std::memory_order_acquire) + 1 - _cursor;
+        }
+
+        /** Number of messages lost because the subscriber was overrun.
+         * @return the counter.
+         */
+        uint32_t overflow(void) const { return _overflow; }
+
+    private:
+        void _skip(uint32_t head)
+        {
+            // Continue with the oldest message that is still safe to read
+            uint32_t oldest = (head >= (uint32_t)SLOTS) ? head - SLOTS + 2 : 1;
+            if (oldest > _cursor) {
+                _overflow += oldest - _cursor;
+                _cursor = oldest;
+            } else {
+                _overflow++;
+                _cursor++;
+            }
+        }
+
+        GnssBroadcast *_ring;
+        uint32_t _filter;
+        uint32_t _cursor;   //!< number of the next message to read
+        uint32_t _overflow; //!< lost messages
+    };
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> seq; //!< 2n once message n is written, odd while writing
+        int len;
+        int protocol;
+        uint32_t type;
+        char data[SIZE];
+    };
+
+    Slot _slots[SLOTS];
+    std::atomic<uint32_t> _head; //!< number of the last published message
+    uint32_t _dropped;
+};
+
+#endif
+
+// End Of File
@@ -0,0 +1,484 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file gnss_capture.cpp
+ * This file implements the capture reader and the offset index.
+ */
+
+#include "gnss_capture.h"
+#include <stdlib.h>
+
+#ifdef GNSS_CAPTURE_THREADS
+#include <atomic>
+#include <ctype.h>
+#include <thread>
+#include <vector>
+#endif
+
+#define CAPTURE_INDEX_MAGIC   0x58494347 // "GCIX"
+#define CAPTURE_INDEX_VERSION 2
+#define CAPTURE_INDEX_HEADER  16
+
+// ----------------------------------------------------------------
+// Reader
+// ----------------------------------------------------------------
+
+GnssCaptureReader::GnssCaptureReader(FILE *fp, uint64_t offset) :
+    _fp(fp), _pipe(GNSS_CAPTURE_PIPE_SIZE), _offset(offset), _next(offset), _eof(false)
+{
+    _chunk = new char[GNSS_CAPTURE_READ_SIZE];
+}
+
+GnssCaptureReader::~GnssCaptureReader(void)
+{
+    delete[] _chunk;
+}
+
+int GnssCaptureReader::getMessage(char *buf, int len)
+{
+    int ret;
+
+    // Keep the pipe full, the recognisers only wait for more data if it is not
+    while (!_eof && (_pipe.free() > 0)) {
+        int n = _pipe.free();
+        if (n > GNSS_CAPTURE_READ_SIZE)
+            n = GNSS_CAPTURE_READ_SIZE;
+        n = fread(_chunk, 1, n, _fp);
+        if (n <= 0)
+            _eof = true;
+        else
+            _pipe.put(_chunk, n);
+    }
+    if (_pipe.size() == 0)
+        return NOT_FOUND;
+
+    ret = _getMessage(&_pipe, buf, len);
+    if (ret == WAIT) {
+        // No more data at the end of the capture, skip to the next sync
+        // character, complete messages may follow a false or truncated start
+        int n = 1;
+        int sz = _pipe.size();
+        _pipe.set(1);
+        while ((n < sz) && (n < len)) {
+            char ch = _pipe.next();
+            if ((ch == '$') || (ch == '\xB5'))
+                break;
+            n++;
+        }
+        ret = UNKNOWN | _pipe.get(buf, (n < len) ? n : len);
+    }
+    _offset = _next;
+    _next += LENGTH(ret);
+    return ret;
+}
+
+bool GnssCaptureReader::describe(const char *buf, int ret, tGNSS_CAPTURE_ENTRY *e)
+{
+    int len = LENGTH(ret);
+
+    memset(e, 0, sizeof(*e));
+    e->length = len;
+    e->time = GNSS_CAPTURE_NO_TIME;
+    e->protocol = PROTOCOL(ret) >> 20;
+
+    if (PROTOCOL(ret) == GnssFramer::UBX) {
+        e->cls = buf[MSG_CLASS_INDEX];
+        e->id = buf[MSG_ID_INDEX];
+        int payload = len - UBX_FRAME_SIZE;
+        int o = ubx_itow_offset(e->cls, e->id);
+        // iTOW of the navigation messages, rcvTow of UBX-RXM-RAWX
+        if (o >= 0) {
+            if (payload >= o + 4)
+                e->time = ubx_u4(&buf[UBX_PAYLOAD_INDEX + o]);
+        } else if ((e->cls == 0x02) && (e->id == 0x15) && (payload >= 8)) {
+            e->time = ubx_r8_ms(&buf[UBX_PAYLOAD_INDEX]);
+        }
+        return true;
+    }
+
+    if (PROTOCOL(ret) == GnssFramer::NMEA) {
+        // $ttFFF,...
+        if (len > 6)
+            memcpy(e->name, &buf[3], 3);
+        int ix = !strncmp(e->name, "GLL", 3) ? 5 :
+                 (!strncmp(e->name, "GGA", 3) || !strncmp(e->name, "RMC", 3) ||
+                  !strncmp(e->name, "GNS", 3) || !strncmp(e->name, "ZDA", 3)) ? 1 : 0;
+        int32_t t;
+        if (ix && GnssFramer::getNmeaFixed(ix, (char *)buf, len, t, 3)) {
+            int hms = t / 1000;
+            e->time = (((hms / 10000) * 3600 + ((hms / 100) % 100) * 60 + (hms % 100)) * 1000) + (t % 1000);
+            e->flags |= GNSS_CAPTURE_UTC;
+        }
+        return true;
+    }
+
+    return false;
+}
+
+// ----------------------------------------------------------------
+// Index
+// ----------------------------------------------------------------
+
+GnssCaptureIndex::GnssCaptureIndex(void) :
+    _capture(NULL), _index(NULL), _count(0)
+{
+}
+
+GnssCaptureIndex::~GnssCaptureIndex(void)
+{
+    close();
+}
+
+#ifdef GNSS_CAPTURE_THREADS
+
+// Length of a valid frame at p, 0 if there is none, -1 if more data is needed
+static int frame_at(const uint8_t *p, int n)
+{
+    if ((n >= 1) && (p[0] == 0xB5)) {
+        if (n < UBX_PAYLOAD_INDEX)
+            return -1;
+        if (p[1] != 0x62)
+            return 0;
+        int len = (p[4] | (p[5] << 8)) + UBX_FRAME_SIZE;
+        if (len > GNSS_CAPTURE_MSG_SIZE)
+            return 0;
+        if (n < len)
+            return -1;
+        uint8_t ca = 0;
+        uint8_t cb = 0;
+        for (int i = 2; i < len - 2; i++) {
+            ca += p[i];
+            cb += ca;
+        }
+        return ((ca == p[len - 2]) && (cb == p[len - 1])) ? len : 0;
+    }
+    if ((n >= 1) && (p[0] == '$')) {
+        uint8_t c = 0;
+        for (int i = 1; i < GNSS_CAPTURE_MSG_SIZE; i++) {
+            if (i + 4 >= n)
+                return -1;
+            if (p[i] == '*') {
+                static const char hex[] = "0123456789ABCDEF";
+                return ((p[i + 1] == hex[c >> 4]) && (p[i + 2] == hex[c & 0xF]) &&
+                        (p[i + 3] == '\r') && (p[i + 4] == '\n')) ? i + 5 : 0;
+            }
+            if (!isprint(p[i]))
+                return 0;
+            c ^= p[i];
+        }
+        return 0;
+    }
+    return (n >= 1) ? 0 : -1;
+}
+
+// First offset in [from, to) with two valid frames in a row, to if none
+static uint64_t resync(FILE *fp, uint64_t from, uint64_t to, uint64_t size)
+{
+    const int window = 64 * 1024;
+    std::vector<uint8_t> buf(window + 2 * GNSS_CAPTURE_MSG_SIZE);
+
+    while (from < to) {
+        if (fseeko(fp, from, SEEK_SET) != 0)
+            return to;
+        int n = fread(&buf[0], 1, buf.size(), fp);
+        bool last = (from + n) >= size;
+        int scan = (n > window) ? window : n;
+        for (int i = 0; (i < scan) && ((from + i) < to); i++) {
+            int l1 = frame_at(&buf[i], n - i);
+            if (l1 < 0)
+                return last ? to : from + i;    // frame reaches the end of the capture
+            if (l1 == 0)
+                continue;
+            if ((from + i + l1) == size)
+                return from + i;
+            int l2 = frame_at(&buf[i + l1], n - i - l1);
+            if ((l2 > 0) || ((l2 < 0) && !last))
+                return from + i;
+        }
+        from += scan;
+        if (scan == 0)
+            break;
+    }
+    return to;
+}
+
+// Frame the messages starting in [start, end)
+static void frame_chunk(const char *path, uint64_t start, uint64_t end, std::vector<tGNSS_CAPTURE_ENTRY> *out)
+{
+    std::vector<char> buf(GNSS_CAPTURE_MSG_SIZE);
+    tGNSS_CAPTURE_ENTRY e;
+    FILE *fp = fopen(path, "rb");
+    int ret;
+
+    if ((fp == NULL) || (fseeko(fp, start, SEEK_SET) != 0)) {
+        if (fp)
+            fclose(fp);
+        return;
+    }
+    {
+        GnssCaptureReader reader(fp, start);
+        while ((ret = reader.getMessage(&buf[0], buf.size())) > 0) {
+            if (reader.offset() >= end)
+                break;
+            if (GnssCaptureReader::describe(&buf[0], ret, &e)) {
+                e.offset = reader.offset();
+                out->push_back(e);
+            }
+        }
+    }
+    fclose(fp);
+}
+
+static bool build_parallel(const char *capture, FILE *out, int threads, uint32_t chunkSize, int *count)
+{
+    FILE *fp = fopen(capture, "rb");
+    uint64_t size;
+
+    if (fp == NULL)
+        return false;
+    fseeko(fp, 0, SEEK_END);
+    size = ftello(fp);
+    fclose(fp);
+
+    if (chunkSize < 2 * GNSS_CAPTURE_MSG_SIZE)
+        chunkSize = 2 * GNSS_CAPTURE_MSG_SIZE;
+    int chunks = (int)((size + chunkSize - 1) / chunkSize);
+    std::vector<uint64_t> start(chunks + 1);
+    std::vector<std::vector<tGNSS_CAPTURE_ENTRY> > result(chunks);
+    std::vector<std::thread> pool;
+    std::atomic<int> next;
+
+    // Phase 1: resync points at the chunk boundaries
+    start[0] = 0;
+    start[chunks] = size;
+    next = 1;
+    for (int t = 0; t < threads; t++) {
+        pool.push_back(std::thread([&]() {
+            FILE *f = fopen(capture, "rb");
+            for (int k; f && ((k = next++) < chunks);)
+                start[k] = resync(f, (uint64_t)k * chunkSize, size, size);
+            if (f)
+                fclose(f);
+        }));
+    }
+    for (size_t t = 0; t < pool.size(); t++)
+        pool[t].join();
+    pool.clear();
+
+    // Phase 2: frame the chunks
+    next = 0;
+    for (int t = 0; t < threads; t++) {
+        pool.push_back(std::thread([&]() {
+            for (int k; (k = next++) < chunks;) {
+                if (start[k] < start[k + 1])
+                    frame_chunk(capture, start[k], start[k + 1], &result[k]);
+            }
+        }));
+    }
+    for (size_t t = 0; t < pool.size(); t++)
+        pool[t].join();
+
+    // Merge, a message framed across a boundary hides what the next chunk found inside it
+    uint64_t end = 0;
+    *count = 0;
+    for (int k = 0; k < chunks; k++) {
+        for (size_t i = 0; i < result[k].size(); i++) {
+            const tGNSS_CAPTURE_ENTRY *e = &result[k][i];
+            if (e->offset < end)
+                continue;
+            if (fwrite(e, sizeof(*e), 1, out) != 1)
+                return false;
+            end = e->offset + e->length;
+            (*count)++;
+        }
+        std::vector<tGNSS_CAPTURE_ENTRY>().swap(result[k]);
+    }
+    return true;
+}
+
+#endif
+
+int GnssCaptureIndex::build(const char *capture, const char *index, int threads, uint32_t chunkSize)
+{
+    const uint32_t header[4] = { CAPTURE_INDEX_MAGIC, CAPTURE_INDEX_VERSION, sizeof(tGNSS_CAPTURE_ENTRY), 0 };
+    char *buf;
+    tGNSS_CAPTURE_ENTRY e;
+    FILE *out = fopen(index, "wb");
+    FILE *in;
+    int n = 0;
+    int ok;
+    int ret;
+
+    if (out == NULL)
+        return -1;
+    ok = (fwrite(header, sizeof(header), 1, out) == 1);
+
+#ifdef GNSS_CAPTURE_THREADS
+    if (threads > 1) {
+        ok = ok && build_parallel(capture, out, threads, chunkSize, &n);
+        ok = (fclose(out) == 0) && ok;
+        return ok ? n : -1;
+    }
+#else
+    (void)threads;
+    (void)chunkSize;
+#endif
+
+    in = fopen(capture, "rb");
+    if (in == NULL) {
+        fclose(out);
+        return -1;
+    }
+    // Too large for the stack of an mbed thread
+    buf = new char[GNSS_CAPTURE_MSG_SIZE];
+    {
+        GnssCaptureReader reader(in);
+        while (ok && ((ret = reader.getMessage(buf, GNSS_CAPTURE_MSG_SIZE)) > 0)) {
+            if (!GnssCaptureReader::describe(buf, ret, &e))
+                continue;
+            e.offset = reader.offset();
+            ok = (fwrite(&e, sizeof(e), 1, out) == 1);
+            n++;
+        }
+    }
+    delete[] buf;
+    fclose(in);
+    ok = (fclose(out) == 0) && ok;
+
+    return ok ? n : -1;
+}
+
+bool GnssCaptureIndex::open(const char *capture, const char *index)
+{
+    uint32_t header[4];
+
+    close();
+    _capture = fopen(capture, "rb");
+    _index = fopen(index, "rb");
+    if ((_capture == NULL) || (_index == NULL) ||
+            (fread(header, sizeof(header), 1, _index) != 1) || (header[0] != CAPTURE_INDEX_MAGIC) ||
+            (header[1] != CAPTURE_INDEX_VERSION) || (header[2] != sizeof(tGNSS_CAPTURE_ENTRY))) {
+        close();
+        return false;
+    }
+    fseek(_index, 0, SEEK_END);
+    _count = (ftell(_index) - CAPTURE_INDEX_HEADER) / sizeof(tGNSS_CAPTURE_ENTRY);
+    return true;
+}
+
+void GnssCaptureIndex::close(void)
+{
+    if (_capture)
+        fclose(_capture);
+    if (_index)
+        fclose(_index);
+    _capture = NULL;
+    _index = NULL;
+    _count = 0;
+}
+
+bool GnssCaptureIndex::entry(uint32_t i, tGNSS_CAPTURE_ENTRY *e)
+{
+    return (i < _count) &&
+           (fseek(_index, CAPTURE_INDEX_HEADER + (long)i * sizeof(*e), SEEK_SET) == 0) &&
+           (fread(e, sizeof(*e), 1, _index) == 1);
+}
+
+int GnssCaptureIndex::read(uint32_t i, char *buf, int len)
+{
+    tGNSS_CAPTURE_ENTRY e;
+
+    if (!entry(i, &e) || (e.length > len) ||
+            (fseek(_capture, e.offset, SEEK_SET) != 0) ||
+            (fread(buf, 1, e.length, _capture) != e.length))
+        return GnssFramer::NOT_FOUND;
+    return (e.protocol << 20) | e.length;
+}
+
+uint32_t GnssCaptureIndex::find(uint8_t cls, uint8_t id, uint32_t from)
+{
+    tGNSS_CAPTURE_ENTRY e;
+
+    for (uint32_t i = from; entry(i, &e); i++) {
+        if ((e.protocol == (GnssFramer::UBX >> 20)) && (e.cls == cls) && (e.id == id))
+            return i;
+    }
+    return _count;
+}
+
+bool GnssCaptureIndex::_timed(uint32_t i, uint32_t end, uint32_t *found, tGNSS_CAPTURE_ENTRY *e)
+{
+    // Next message with a GPS time
+    for (; (i < end) && entry(i, e); i++) {
+        if ((e->time != GNSS_CAPTURE_NO_TIME) && !(e->flags & GNSS_CAPTURE_UTC)) {
+            *found = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t GnssCaptureIndex::find_epoch(uint32_t itow)
+{
+    tGNSS_CAPTURE_ENTRY e;
+    uint32_t lo = 0;
+    uint32_t hi = _count;
+    uint32_t found;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (!_timed(mid, hi, &found, &e)) {
+            hi = mid;        // nothing timed in the upper half
+        } else if (e.time < itow) {
+            lo = found + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return _timed(lo, _count, &found, &e) ? found : _count;
+}
+
+#ifdef GNSS_CAPTURE_TOOL
+// Host tool: gnss_capture <capture> [<index> [<threads>]]
+// Build: c++ -DGNSS_CAPTURE_TOOL gnss_capture.cpp gnss_framer.cpp -lpthread
+int main(int argc, char *argv[])
+{
+    char index[256];
+    int threads = 1;
+    int n;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <capture> [<index> [<threads>]]\n", argv[0]);
+        return 2;
+    }
+    if (argc > 2)
+        snprintf(index, sizeof(index), "%s", argv[2]);
+    else
+        snprintf(index, sizeof(index), "%s.idx", argv[1]);
+    if (argc > 3)
+        threads = atoi(argv[3]);
+    n = GnssCaptureIndex::build(argv[1], index, threads);
+    if (n < 0) {
+        fprintf(stderr, "cannot index %s\n", argv[1]);
+        return 1;
+    }
+    printf("%d messages indexed in %s\n", n, index);
+    return 0;
+}
+#endif
+
+// End Of File
@@ -0,0 +1,188 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GNSS_CAPTURE_H
+#define GNSS_CAPTURE_H
+
+/**
+ * @file gnss_capture.h
+ * This file defines the reading of raw receiver captures and an offset
+ * index that allows to seek to any message or epoch of a capture.
+ */
+
+#include "gnss_framer.h"
+
+#if !defined(__MBED__)
+#define GNSS_CAPTURE_THREADS            // parallel framing with std::thread
+#endif
+
+#define GNSS_CAPTURE_PIPE_SIZE 8192
+#define GNSS_CAPTURE_MSG_SIZE 4096      // largest message framed
+#define GNSS_CAPTURE_READ_SIZE 256      // file read size
+#ifndef GNSS_CAPTURE_CHUNK_SIZE
+#define GNSS_CAPTURE_CHUNK_SIZE (16 * 1024 * 1024)
+#endif
+#define GNSS_CAPTURE_NO_TIME 0xFFFFFFFF
+#define GNSS_CAPTURE_UTC 0x01           // time is UTC ms of day (NMEA)
+
+typedef struct GNSS_CAPTURE_ENTRY {
+    uint64_t offset;    // of the message in the capture
+    uint32_t time;      // iTOW (UBX) or UTC ms of day (NMEA), GNSS_CAPTURE_NO_TIME
+    uint16_t length;
+    uint8_t protocol;   // GnssFramer::UBX or GnssFramer::NMEA >> 20
+    uint8_t flags;      // GNSS_CAPTURE_UTC
+    uint8_t cls;        // UBX class
+    uint8_t id;         // UBX id
+    char name[3];       // NMEA sentence formatter, e.g. "GGA"
+    uint8_t reserved[3];
+
+} tGNSS_CAPTURE_ENTRY;
+
+/** Frames a capture with the NMEA and UBX recognisers of GnssFramer.
+ * No receiver is involved, the reader also builds on the host.
+ */
+class GnssCaptureReader : public GnssFramer
+{
+public:
+    /** Constructor.
+     * @param fp the capture, read from the current position.
+     * @param offset file offset of the current position.
+     */
+    GnssCaptureReader(FILE *fp, uint64_t offset = 0);
+
+    /** Destructor.
+     */
+    ~GnssCaptureReader(void);
+
+    /** Get the next message or block of unknown bytes.
+     * @param buf the buffer to store it.
+     * @param len size of the buffer.
+     * @return type and length, NOT_FOUND at the end of the capture.
+     */
+    int getMessage(char *buf, int len);
+
+    /** Offset of the message returned last.
+     * @return the offset in the capture.
+     */
+    uint64_t offset(void) const { return _offset; }
+
+    /** Describe a message for the index.
+     * @param buf the message.
+     * @param ret the return value of getMessage.
+     * @param e the entry to fill, except the offset.
+     * @return true for NMEA and UBX messages, false otherwise.
+     */
+    static bool describe(const char *buf, int ret, tGNSS_CAPTURE_ENTRY *e);
+
+protected:
+    FILE *_fp;
+    Pipe<char> _pipe;
+    char *_chunk;       //!< file read buffer, not on the stack of small threads
+    uint64_t _offset;
+    uint64_t _next;     //!< offset of the next message
+    bool _eof;
+
+private:
+    GnssCaptureReader(const GnssCaptureReader &);
+    GnssCaptureReader &operator=(const GnssCaptureReader &);
+};
+
+/** Offset index of a capture, written to a side file.
+ */
+class GnssCaptureIndex
+{
+public:
+    /** Constructor.
+     */
+    GnssCaptureIndex(void);
+
+    /** Destructor, closes the files.
+     */
+    ~GnssCaptureIndex(void);
+
+    /** Frame a capture once and write its index.
+     * With more than one thread the capture is split into chunks that are
+     * framed in parallel. Each chunk starts at a resync point: a valid
+     * UBX or NMEA frame followed by another valid frame. The results are
+     * merged in file order; messages a chunk framed across the end of its
+     * range win over the start of the next chunk.
+     * @param capture the capture file name.
+     * @param index the index file name.
+     * @param threads number of threads, only used with GNSS_CAPTURE_THREADS.
+     * @param chunkSize size of the chunks framed in parallel.
+     * @return number of messages indexed, -1 on failure.
+     */
+    static int build(const char *capture, const char *index, int threads = 1,
+                     uint32_t chunkSize = GNSS_CAPTURE_CHUNK_SIZE);
+
+    /** Open a capture and its index.
+     * @param capture the capture file name.
+     * @param index the index file name.
+     * @return true if successful, false otherwise.
+     */
+    bool open(const char *capture, const char *index);
+
+    /** Close the files.
+     */
+    void close(void);
+
+    /** Number of messages in the index.
+     * @return the number of entries.
+     */
+    uint32_t count(void) const { return _count; }
+
+    /** Get an index entry.
+     * @param i the message number.
+     * @param e the entry to fill.
+     * @return true if successful, false otherwise.
+     */
+    bool entry(uint32_t i, tGNSS_CAPTURE_ENTRY *e);
+
+    /** Read a message from the capture.
+     * @param i the message number.
+     * @param buf the buffer to store it.
+     * @param len size of the buffer.
+     * @return type and length as getMessage, NOT_FOUND on failure.
+     */
+    int read(uint32_t i, char *buf, int len);
+
+    /** Find the next UBX message of a type.
+     * @param cls the UBX class.
+     * @param id the UBX id.
+     * @param from the message number to start at.
+     * @return the message number, count() if there is none.
+     */
+    uint32_t find(uint8_t cls, uint8_t id, uint32_t from = 0);
+
+    /** Find the first UBX message of an epoch (binary search, the capture
+     * must not cross the end of a GPS week).
+     * @param itow the GPS time of week (ms).
+     * @return the message number of the first message with an iTOW not
+     *         before itow, count() if there is none.
+     */
+    uint32_t find_epoch(uint32_t itow);
+
+private:
+    bool _timed(uint32_t i, uint32_t end, uint32_t *found, tGNSS_CAPTURE_ENTRY *e);
+
+    FILE *_capture;
+    FILE *_index;
+    uint32_t _count;
+};
+
+#endif
+
+// End Of File
@@ -0,0 +1,695 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file gnss_codec.cpp
+ * This file implements the compression of the receiver output.
+ */
+
+#include "gnss_codec.h"
+
+#define TAG_UBX     0x00
+#define TAG_NMEA    0x40
+#define TAG_RAW     0x80
+#define TAG_TYPE    0xC0
+#define TAG_NEW     0x20    // slot assigned to a new class/id or address
+#define TAG_LENGTH  0x10    // UBX payload length follows
+#define TAG_SLOT    0x0F
+
+#define MAX_FIELDS  16
+
+static const char HEX[] = "0123456789ABCDEF";
+
+// Fields of a UBX payload coded as delta to the previous message
+typedef struct {
+    int refLen;             // bytes of the reference in use
+    int count;
+    int itow;               // 1 if off[0] is iTOW
+    int off[MAX_FIELDS];
+    uint32_t val[MAX_FIELDS];
+} tMODEL;
+
+static const uint8_t NAV_POSECEF[] = {4, 8, 12};
+static const uint8_t NAV_POSLLH[] = {4, 8, 12, 16};
+static const uint8_t NAV_PVT[] = {12, 16, 24, 28, 32, 36, 40, 44, 48, 52, 56, 60, 64, 68, 72};
+static const uint8_t NAV_STATUS[] = {8, 12};
+static const uint8_t NAV_VELNED[] = {4, 8, 12, 16, 20, 24};
+static const uint8_t NAV_HPPOSLLH[] = {8, 12, 16, 20};
+static const uint8_t NAV_RELPOSNED[] = {8, 12, 16};
+
+static inline uint32_t u4(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t zigzag(uint32_t v)
+{
+    return (v << 1) ^ (uint32_t)((int32_t)v >> 31);
+}
+
+static inline uint32_t unzigzag(uint32_t z)
+{
+    return (z >> 1) ^ (0 - (z & 1));
+}
+
+static void ubx_checksum(const uint8_t *p, int n, uint8_t *ca, uint8_t *cb)
+{
+    uint8_t a = 0;
+    uint8_t b = 0;
+    for (int i = 0; i < n; i++) {
+        a += p[i];
+        b += a;
+    }
+    *ca = a;
+    *cb = b;
+}
+
+static uint8_t nmea_checksum(const uint8_t *p, int n)
+{
+    uint8_t c = 0;
+    for (int i = 0; i < n; i++)
+        c ^= p[i];
+    return c;
+}
+
+// Value of a NMEA field of digits and decimal points, -1 if not numeric
+static int64_t number(const uint8_t *p, int n)
+{
+    int64_t v = 0;
+    int digits = 0;
+
+    for (int i = 0; i < n; i++) {
+        if (p[i] == '.')
+            continue;
+        if ((p[i] < '0') || (p[i] > '9') || (++digits > 18))
+            return -1;
+        v = v * 10 + (p[i] - '0');
+    }
+    return digits ? v : -1;
+}
+
+// Select the delta fields covered by the payload and the reference
+static void model(tMODEL *m, uint8_t cls, uint8_t id, int plen, int refLen)
+{
+    const uint8_t *offs = NULL;
+    int itow;
+    int n = 0;
+
+    if (refLen > GNSS_CODEC_PAYLOAD)
+        refLen = GNSS_CODEC_PAYLOAD;
+    m->refLen = refLen;
+    m->count = 0;
+    m->itow = 0;
+
+    itow = ubx_itow_offset(cls, id);
+    if (cls == 0x01) {
+        switch (id) {
+        case 0x01: offs = NAV_POSECEF; n = sizeof(NAV_POSECEF); break;
+        case 0x02: offs = NAV_POSLLH; n = sizeof(NAV_POSLLH); break;
+        case 0x03: offs = NAV_STATUS; n = sizeof(NAV_STATUS); break;
+        case 0x07: offs = NAV_PVT; n = sizeof(NAV_PVT); break;
+        case 0x12: offs = NAV_VELNED; n = sizeof(NAV_VELNED); break;
+        case 0x14: offs = NAV_HPPOSLLH; n = sizeof(NAV_HPPOSLLH); break;
+        case 0x3C: offs = NAV_RELPOSNED; n = sizeof(NAV_RELPOSNED); break;
+        default: break;
+        }
+    }
+    if ((itow >= 0) && (itow + 4 <= plen) && (itow + 4 <= refLen)) {
+        m->off[m->count++] = itow;
+        m->itow = 1;
+    }
+    for (int i = 0; i < n; i++) {
+        if ((offs[i] + 4 <= plen) && (offs[i] + 4 <= refLen))
+            m->off[m->count++] = offs[i];
+    }
+}
+
+// Residual of a payload byte, the delta fields are coded separately
+static inline uint8_t residual(const tMODEL *m, const uint8_t *p, const uint8_t *ref, int i)
+{
+    for (int k = 0; k < m->count; k++) {
+        if ((i >= m->off[k]) && (i < m->off[k] + 4))
+            return 0;
+    }
+    return p[i] ^ ((i < m->refLen) ? ref[i] : 0);
+}
+
+// ----------------------------------------------------------------
+// Model
+// ----------------------------------------------------------------
+
+GnssCodec::GnssCodec(void)
+{
+    reset();
+}
+
+void GnssCodec::reset(void)
+{
+    memset(_slots, 0, sizeof(_slots));
+    _stamp = 0;
+}
+
+tGNSS_CODEC_SLOT *GnssCodec::_slot(uint8_t protocol, uint8_t cls, uint8_t id, const uint8_t *key, int keyLen, bool *found)
+{
+    tGNSS_CODEC_SLOT *old = &_slots[0];
+
+    _stamp++;
+    for (int i = 0; i < GNSS_CODEC_SLOTS; i++) {
+        tGNSS_CODEC_SLOT *s = &_slots[i];
+        bool match = (s->protocol == protocol);
+        if (match && (protocol == (GnssFramer::UBX >> 20))) {
+            match = (s->cls == cls) && (s->id == id);
+        } else if (match) {
+            match = (s->length >= keyLen) && !memcmp(s->data, key, keyLen) &&
+                    ((s->length == keyLen) || (s->data[keyLen] == ','));
+        }
+        if (match) {
+            s->used = _stamp;
+            *found = true;
+            return s;
+        }
+        if (s->used < old->used)
+            old = s;
+    }
+
+    memset(old, 0, sizeof(*old));
+    old->protocol = protocol;
+    old->cls = cls;
+    old->id = id;
+    old->used = _stamp;
+    *found = false;
+    return old;
+}
+
+void GnssCodec::_store(tGNSS_CODEC_SLOT *s, const uint8_t *data, int len)
+{
+    s->length = len;
+    memcpy(s->data, data, (len < GNSS_CODEC_PAYLOAD) ? len : GNSS_CODEC_PAYLOAD);
+}
+
+#ifdef __MBED__
+
+// ----------------------------------------------------------------
+// Encoder
+// ----------------------------------------------------------------
+
+// Numeric fields of the same length with the points at the same positions
+static bool same_shape(const uint8_t *a, const uint8_t *b, int n)
+{
+    for (int i = 0; i < n; i++) {
+        if ((a[i] == '.') != (b[i] == '.'))
+            return false;
+    }
+    return true;
+}
+
+GnssCaptureEncoder::GnssCaptureEncoder(Callback<void(const uint8_t *, int)> sink) :
+    _sink(sink), _len(0), _bytes(0), _started(false)
+{
+}
+
+void GnssCaptureEncoder::encode(const char *buf, int ret)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    int len = LENGTH(ret);
+
+    if (!_started) {
+        _put('G');
+        _put('Z');
+        _put(GNSS_CODEC_VERSION);
+        _put(0);
+        _started = true;
+    }
+    if ((PROTOCOL(ret) == GnssFramer::UBX) && _ubx(p, len))
+        return;
+    if ((PROTOCOL(ret) == GnssFramer::NMEA) && _nmea(p, len))
+        return;
+    _raw(p, len);
+}
+
+void GnssCaptureEncoder::flush(void)
+{
+    if (_len > 0) {
+        _sink(_out, _len);
+        _bytes += _len;
+        _len = 0;
+    }
+}
+
+void GnssCaptureEncoder::_put(uint8_t b)
+{
+    _out[_len++] = b;
+    if (_len == GNSS_CODEC_BUFFER)
+        flush();
+}
+
+void GnssCaptureEncoder::_putVarint(uint64_t v)
+{
+    while (v >= 0x80) {
+        _put((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    _put((uint8_t)v);
+}
+
+bool GnssCaptureEncoder::_ubx(const uint8_t *buf, int len)
+{
+    int plen = len - UBX_FRAME_SIZE;
+    const uint8_t *p = &buf[UBX_PAYLOAD_INDEX];
+    tGNSS_CODEC_SLOT *s;
+    tMODEL m;
+    uint8_t ca, cb;
+    uint8_t tag;
+    bool found;
+
+    // Only frames the decoder restores exactly
+    if ((plen < 0) || (buf[0] != 0xB5) || (buf[1] != 0x62) ||
+        ((buf[UBX_LENGTH_INDEX] | (buf[UBX_LENGTH_INDEX + 1] << 8)) != plen))
+        return false;
+    ubx_checksum(&buf[MSG_CLASS_INDEX], plen + 4, &ca, &cb);
+    if ((ca != buf[len - 2]) || (cb != buf[len - 1]))
+        return false;
+
+    s = _slot(GnssFramer::UBX >> 20, buf[MSG_CLASS_INDEX], buf[MSG_ID_INDEX], NULL, 0, &found);
+    tag = TAG_UBX | (s - _slots);
+    if (!found)
+        tag |= TAG_NEW;
+    if (s->length != plen)
+        tag |= TAG_LENGTH;
+    _put(tag);
+    if (tag & TAG_NEW) {
+        _put(s->cls);
+        _put(s->id);
+    }
+    if (tag & TAG_LENGTH)
+        _putVarint(plen);
+
+    model(&m, s->cls, s->id, plen, s->length);
+    for (int k = 0; k < m.count; k++) {
+        uint32_t d = u4(&p[m.off[k]]) - u4(&s->data[m.off[k]]);
+        m.val[k] = zigzag((k < m.itow) ? d - s->dItow : d);
+    }
+
+    // Mask of the fields that changed, then their deltas
+    for (int k = 0; k < m.count; k += 8) {
+        uint8_t mask = 0;
+        for (int j = k; (j < k + 8) && (j < m.count); j++)
+            mask |= (m.val[j] != 0) << (j - k);
+        _put(mask);
+    }
+    for (int k = 0; k < m.count; k++) {
+        if (m.val[k])
+            _putVarint(m.val[k]);
+    }
+
+    // Zero runs and literals, runs shorter than 3 stay in the literals
+    for (int i = 0; i < plen;) {
+        int z = 0;
+        int l = 0;
+        while ((i + z < plen) && !residual(&m, p, s->data, i + z))
+            z++;
+        i += z;
+        while (i + l < plen) {
+            int r = 0;
+            while ((i + l + r < plen) && !residual(&m, p, s->data, i + l + r))
+                r++;
+            if ((r >= 3) || (i + l + r == plen))
+                break;
+            l += r + 1;
+        }
+        _putVarint(z);
+        _putVarint(l);
+        for (int j = 0; j < l; j++)
+            _put(residual(&m, p, s->data, i + j));
+        i += l;
+    }
+
+    s->dItow = m.itow ? (int32_t)(u4(&p[m.off[0]]) - u4(&s->data[m.off[0]])) : 0;
+    _store(s, p, plen);
+    return true;
+}
+
+bool GnssCaptureEncoder::_nmea(const uint8_t *buf, int len)
+{
+    const uint8_t *body = &buf[1];
+    int blen = len - 6;
+    uint8_t mask[GNSS_CODEC_PAYLOAD / 8 + 1];
+    tGNSS_CODEC_SLOT *s;
+    int key = 0;
+    int n = 1;
+    uint8_t c;
+    bool found;
+
+    // $body*hh\r\n, the checksum in upper case
+    if ((blen < 0) || (blen > GNSS_CODEC_PAYLOAD) || (buf[0] != '$') || (buf[len - 5] != '*') ||
+        (buf[len - 2] != '\r') || (buf[len - 1] != '\n'))
+        return false;
+    c = nmea_checksum(body, blen);
+    if ((buf[len - 4] != HEX[c >> 4]) || (buf[len - 3] != HEX[c & 0xF]))
+        return false;
+    if (memchr(body, '*', blen))
+        return false;
+
+    while ((key < blen) && (body[key] != ','))
+        key++;
+    for (int i = key; i < blen; i++)
+        n += (body[i] == ',');
+
+    s = _slot(GnssFramer::NMEA >> 20, 0, 0, body, key, &found);
+    _put(TAG_NMEA | (found ? 0 : TAG_NEW) | (s - _slots));
+    _putVarint(n);
+
+    // Compare the fields with the ones of the previous sentence
+    memset(mask, 0, sizeof(mask));
+    int a = 0;      // current field
+    int ra = 0;     // reference field
+    for (int k = 0; k < n; k++) {
+        int b = a;
+        int rb = ra;
+        while ((b < blen) && (body[b] != ','))
+            b++;
+        while ((rb < s->length) && (s->data[rb] != ','))
+            rb++;
+        if ((ra > s->length) || (b - a != rb - ra) || memcmp(&body[a], &s->data[ra], b - a))
+            mask[k >> 3] |= 1 << (k & 7);
+        a = b + 1;
+        ra = rb + 1;
+    }
+    for (int i = 0; i < (n + 7) / 8; i++)
+        _put(mask[i]);
+
+    // Changed fields, numbers of the same shape as a difference
+    a = 0;
+    ra = 0;
+    for (int k = 0; k < n; k++) {
+        int b = a;
+        int rb = ra;
+        while ((b < blen) && (body[b] != ','))
+            b++;
+        while ((rb < s->length) && (s->data[rb] != ','))
+            rb++;
+        if (mask[k >> 3] & (1 << (k & 7))) {
+            int64_t v = number(&body[a], b - a);
+            int64_t rv = ((ra <= s->length) && (b - a == rb - ra)) ? number(&s->data[ra], rb - ra) : -1;
+            if ((v >= 0) && (rv >= 0) && same_shape(&body[a], &s->data[ra], b - a)) {
+                uint64_t d = (uint64_t)(v - rv);
+                _putVarint((((d << 1) ^ (uint64_t)((int64_t)d >> 63)) << 1) | 1);
+            } else {
+                _putVarint((uint64_t)(b - a) << 1);
+                for (int i = a; i < b; i++)
+                    _put(body[i]);
+            }
+        }
+        a = b + 1;
+        ra = rb + 1;
+    }
+
+    _store(s, body, blen);
+    return true;
+}
+
+void GnssCaptureEncoder::_raw(const uint8_t *buf, int len)
+{
+    _put(TAG_RAW);
+    _putVarint(len);
+    for (int i = 0; i < len; i++)
+        _put(buf[i]);
+}
+
+#endif
+
+// ----------------------------------------------------------------
+// Decoder
+// ----------------------------------------------------------------
+
+// Bounded reader of a record
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    bool more;          // the record continues after the data
+    bool invalid;
+} tREADER;
+
+static uint8_t get_u1(tREADER *r)
+{
+    if (r->p >= r->end) {
+        r->more = true;
+        return 0;
+    }
+    return *r->p++;
+}
+
+static uint64_t get_varint(tREADER *r)
+{
+    uint64_t v = 0;
+    for (int s = 0; s < 64; s += 7) {
+        uint8_t b = get_u1(r);
+        v |= (uint64_t)(b & 0x7F) << s;
+        if (!(b & 0x80))
+            return v;
+    }
+    r->invalid = true;
+    return 0;
+}
+
+GnssCaptureDecoder::GnssCaptureDecoder(void) :
+    _started(false)
+{
+}
+
+int GnssCaptureDecoder::decode(const uint8_t *buf, int len, char *msg, int size, int *ret)
+{
+    tREADER r = { buf, buf + len, false, false };
+    uint8_t *out = (uint8_t *)msg;
+    tGNSS_CODEC_SLOT *s;
+    uint8_t tag;
+    bool isNew;
+
+    *ret = 0;
+    if (!_started) {
+        if (len < 4)
+            return 0;
+        if ((buf[0] != 'G') || (buf[1] != 'Z') || (buf[2] != GNSS_CODEC_VERSION))
+            return -1;
+        _started = true;
+        return 4;
+    }
+
+    tag = get_u1(&r);
+    if (r.more)
+        return 0;
+    if ((tag & TAG_SLOT) >= GNSS_CODEC_SLOTS)
+        return -1;
+    s = &_slots[tag & TAG_SLOT];
+    isNew = (tag & TAG_NEW) != 0;
+
+    if ((tag & TAG_TYPE) == TAG_UBX) {
+        uint8_t cls = s->cls;
+        uint8_t id = s->id;
+        int refLen = s->length;
+        int plen = s->length;
+        tMODEL m;
+
+        if (isNew) {
+            cls = get_u1(&r);
+            id = get_u1(&r);
+            refLen = 0;
+            plen = 0;
+        } else if (s->protocol != (GnssFramer::UBX >> 20)) {
+            return -1;
+        }
+        if (tag & TAG_LENGTH) {
+            uint64_t l = get_varint(&r);
+            plen = (l > 0xFFFF) ? -1 : (int)l;
+        }
+        if (r.more)
+            return 0;
+        if (r.invalid || (plen < 0) || (plen + UBX_FRAME_SIZE > size))
+            return -1;
+
+        model(&m, cls, id, plen, refLen);
+        const uint8_t *mask = r.p;
+        if (r.end - r.p < (m.count + 7) / 8)
+            return 0;
+        r.p += (m.count + 7) / 8;
+        for (int k = 0; k < m.count; k++) {
+            uint64_t v = (mask[k >> 3] & (1 << (k & 7))) ? get_varint(&r) : 0;
+            if (v > 0xFFFFFFFF)
+                r.invalid = true;
+            m.val[k] = (uint32_t)v;
+        }
+
+        // Residual into the payload area, then undo the model
+        uint8_t *p = &out[UBX_PAYLOAD_INDEX];
+        for (int i = 0; i < plen;) {
+            uint64_t z = get_varint(&r);
+            uint64_t l = get_varint(&r);
+            if (r.more)
+                return 0;
+            if (r.invalid || ((z + l) == 0) || (z > (uint64_t)(plen - i)) || (l > (uint64_t)(plen - i) - z))
+                return -1;
+            memset(&p[i], 0, z);
+            i += z;
+            if (r.end - r.p < (int)l)
+                return 0;
+            memcpy(&p[i], r.p, l);
+            r.p += l;
+            i += l;
+        }
+        for (int i = 0; i < m.refLen && i < plen; i++)
+            p[i] ^= s->data[i];
+        int32_t dItow = 0;
+        for (int k = 0; k < m.count; k++) {
+            int o = m.off[k];
+            uint32_t prev = u4(&s->data[o]);
+            uint32_t d = unzigzag(m.val[k]);
+            if (k < m.itow) {
+                d += s->dItow;
+                dItow = (int32_t)d;
+            }
+            uint32_t v = prev + d;
+            p[o] = (uint8_t)v;
+            p[o + 1] = (uint8_t)(v >> 8);
+            p[o + 2] = (uint8_t)(v >> 16);
+            p[o + 3] = (uint8_t)(v >> 24);
+        }
+
+        out[0] = 0xB5;
+        out[1] = 0x62;
+        out[MSG_CLASS_INDEX] = cls;
+        out[MSG_ID_INDEX] = id;
+        out[UBX_LENGTH_INDEX] = plen & 0xFF;
+        out[UBX_LENGTH_INDEX + 1] = plen >> 8;
+        ubx_checksum(&out[MSG_CLASS_INDEX], plen + 4, &out[plen + 6], &out[plen + 7]);
+
+        if (isNew) {
+            memset(s, 0, sizeof(*s));
+            s->protocol = GnssFramer::UBX >> 20;
+            s->cls = cls;
+            s->id = id;
+        }
+        s->dItow = dItow;
+        _store(s, p, plen);
+        *ret = GnssFramer::UBX | (plen + UBX_FRAME_SIZE);
+        return r.p - buf;
+    }
+
+    if ((tag & TAG_TYPE) == TAG_NMEA) {
+        uint8_t *body = &out[1];
+        int limit = (size - 6 < GNSS_CODEC_PAYLOAD) ? size - 6 : GNSS_CODEC_PAYLOAD;
+        int refLen = isNew ? 0 : s->length;
+        uint64_t n = get_varint(&r);
+        const uint8_t *mask = r.p;
+        int blen = 0;
+        int ra = 0;
+
+        if (r.more)
+            return 0;
+        if (r.invalid || (n == 0) || (n > (uint64_t)limit + 1))
+            return -1;
+        if (!isNew && (s->protocol != (GnssFramer::NMEA >> 20)))
+            return -1;
+        if (r.end - r.p < (int)((n + 7) / 8))
+            return 0;
+        r.p += (n + 7) / 8;
+
+        for (int k = 0; k < (int)n; k++) {
+            int rb = ra;
+            while ((rb < refLen) && (s->data[rb] != ','))
+                rb++;
+            if (k > 0) {
+                if (blen + 1 > limit)
+                    return -1;
+                body[blen++] = ',';
+            }
+            if (mask[k >> 3] & (1 << (k & 7))) {
+                uint64_t h = get_varint(&r);
+                if (r.more)
+                    return 0;
+                if (r.invalid)
+                    return -1;
+                if (h & 1) {
+                    // Difference to the number of the previous sentence
+                    int64_t rv = (ra <= refLen) ? number(&s->data[ra], rb - ra) : -1;
+                    uint64_t z = h >> 1;
+                    int64_t v = rv + (int64_t)((z >> 1) ^ (0 - (z & 1)));
+                    if ((rv < 0) || (v < 0) || (blen + rb - ra > limit))
+                        return -1;
+                    for (int i = rb - ra - 1; i >= 0; i--) {
+                        if (s->data[ra + i] == '.') {
+                            body[blen + i] = '.';
+                        } else {
+                            body[blen + i] = '0' + (v % 10);
+                            v /= 10;
+                        }
+                    }
+                    if (v != 0)
+                        return -1;
+                    blen += rb - ra;
+                } else {
+                    uint64_t l = h >> 1;
+                    if (l > (uint64_t)(limit - blen))
+                        return -1;
+                    if (r.end - r.p < (int)l)
+                        return 0;
+                    memcpy(&body[blen], r.p, l);
+                    r.p += l;
+                    blen += l;
+                }
+            } else {
+                if ((ra > refLen) || (blen + rb - ra > limit))
+                    return -1;
+                memcpy(&body[blen], &s->data[ra], rb - ra);
+                blen += rb - ra;
+            }
+            ra = rb + 1;
+        }
+
+        uint8_t c = nmea_checksum(body, blen);
+        out[0] = '$';
+        out[blen + 1] = '*';
+        out[blen + 2] = HEX[c >> 4];
+        out[blen + 3] = HEX[c & 0xF];
+        out[blen + 4] = '\r';
+        out[blen + 5] = '\n';
+
+        if (isNew) {
+            memset(s, 0, sizeof(*s));
+            s->protocol = GnssFramer::NMEA >> 20;
+        }
+        _store(s, body, blen);
+        *ret = GnssFramer::NMEA | (blen + 6);
+        return r.p - buf;
+    }
+
+    if (tag == TAG_RAW) {
+        uint64_t l = get_varint(&r);
+        if (r.more)
+            return 0;
+        if (r.invalid || (l > (uint64_t)size))
+            return -1;
+        if (r.end - r.p < (int)l)
+            return 0;
+        memcpy(out, r.p, l);
+        r.p += l;
+        *ret = GnssFramer::UNKNOWN | l;
+        return r.p - buf;
+    }
+
+    return -1;
+}
+
+// End Of File
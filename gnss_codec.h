@@ -0,0 +1,176 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GNSS_CODEC_H
+#define GNSS_CODEC_H
+
+/**
+ * @file gnss_codec.h
+ * This file defines a lossless compression of the receiver output, as
+ * framed by getMessage. A stream starts with 'G' 'Z' version 0, followed
+ * by one record per message:
+ *
+ *   UBX     tag [cls id] [length] residual
+ *   NMEA    tag fields mask changed-fields
+ *   UNKNOWN tag length bytes
+ *
+ * The tag selects one of GNSS_CODEC_SLOTS slots holding the previous
+ * message of a class/id (UBX) or sentence address (NMEA). The UBX residual
+ * is the payload XOR the previous payload, with iTOW coded as delta of
+ * delta and the position and velocity fields as zigzag deltas, then zero
+ * run length coded. NMEA sentences only carry the fields that changed,
+ * numbers as the difference to the previous value.
+ * Sync characters, lengths that did not change and the checksums are
+ * restored by the decoder, the output is identical to the input.
+ */
+
+#include "gnss_framer.h"
+#ifdef __MBED__
+#include "gnss.h"
+#endif
+
+#define GNSS_CODEC_VERSION 2
+#ifndef GNSS_CODEC_SLOTS
+#define GNSS_CODEC_SLOTS 8         // messages modelled at the same time, up to 16
+#endif
+#ifndef GNSS_CODEC_PAYLOAD
+#define GNSS_CODEC_PAYLOAD 256     // bytes of a payload used as reference
+#endif
+#define GNSS_CODEC_BUFFER 256      // output buffer of the encoder
+
+/** Previous message of a class/id or sentence address
+*/
+typedef struct GNSS_CODEC_SLOT {
+    uint8_t protocol;    // GnssFramer::UBX or GnssFramer::NMEA >> 20, 0: unused
+    uint8_t cls;         // UBX class
+    uint8_t id;          // UBX id
+    uint16_t length;     // payload (UBX) or sentence body (NMEA) length
+    int32_t dItow;       // previous iTOW step
+    uint32_t used;       // stamp of the last use
+    uint8_t data[GNSS_CODEC_PAYLOAD];
+
+} tGNSS_CODEC_SLOT;
+
+/** Model shared by the encoder and the decoder.
+ */
+class GnssCodec
+{
+public:
+    /** Forget all previous messages.
+     */
+    void reset(void);
+
+protected:
+    GnssCodec(void);
+
+    /** Select the slot for a message, a slot not used for the longest
+     * time is cleared and assigned if no slot matches.
+     * @param protocol GnssFramer::UBX or GnssFramer::NMEA >> 20.
+     * @param cls the UBX class.
+     * @param id the UBX id.
+     * @param key the NMEA address.
+     * @param keyLen the length of the address.
+     * @param found set to true if the slot held the message before.
+     * @return the slot.
+     */
+    tGNSS_CODEC_SLOT *_slot(uint8_t protocol, uint8_t cls, uint8_t id, const uint8_t *key, int keyLen, bool *found);
+
+    /** Replace the reference of a slot.
+     * @param s the slot.
+     * @param data the payload or sentence body.
+     * @param len the length.
+     */
+    static void _store(tGNSS_CODEC_SLOT *s, const uint8_t *data, int len);
+
+    uint32_t _stamp;
+    tGNSS_CODEC_SLOT _slots[GNSS_CODEC_SLOTS];
+};
+
+#ifdef __MBED__
+
+/** Streaming encoder.
+ * Needs about GNSS_CODEC_SLOTS * GNSS_CODEC_PAYLOAD bytes of RAM and
+ * passes the output to the sink in pieces of up to GNSS_CODEC_BUFFER bytes.
+ */
+class GnssCaptureEncoder : public GnssCodec
+{
+public:
+    /** Constructor.
+     * @param sink function receiving the compressed data.
+     */
+    GnssCaptureEncoder(Callback<void(const uint8_t *, int)> sink);
+
+    /** Add a message returned by getMessage.
+     * @param buf the message.
+     * @param ret the return value of getMessage (protocol and length).
+     */
+    void encode(const char *buf, int ret);
+
+    /** Pass the buffered output to the sink.
+     */
+    void flush(void);
+
+    /** Number of bytes passed to the sink so far.
+     * @return the counter.
+     */
+    uint32_t bytes(void) const { return _bytes; }
+
+private:
+    bool _ubx(const uint8_t *buf, int len);
+    bool _nmea(const uint8_t *buf, int len);
+    void _raw(const uint8_t *buf, int len);
+    void _put(uint8_t b);
+    void _putVarint(uint64_t v);
+
+    Callback<void(const uint8_t *, int)> _sink;
+    uint8_t _out[GNSS_CODEC_BUFFER];
+    int _len;
+    uint32_t _bytes;
+    bool _started;
+};
+
+#endif
+
+/** Decoder.
+ */
+class GnssCaptureDecoder : public GnssCodec
+{
+public:
+    GnssCaptureDecoder(void);
+
+    /** Decode one record.
+     * @param buf the compressed data.
+     * @param len the length of the data.
+     * @param msg the buffer to store the message.
+     * @param size size of the buffer.
+     * @param ret set to the protocol and length of the message as returned
+     *        by getMessage, 0 for the stream header.
+     * @return length of the record, 0 if more data is needed, -1 if the
+     *         record is invalid.
+     */
+    int decode(const uint8_t *buf, int len, char *msg, int size, int *ret);
+
+    /** Start a new stream.
+     */
+    void restart(void) { reset(); _started = false; }
+
+private:
+    bool _started;
+};
+
+#endif
+
+// End Of File
@@ -0,0 +1,157 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file gnss_energy.cpp
+ * This file implements the energy accounting.
+ */
+
+#include "gnss_energy.h"
+
+GnssEnergyMeter::GnssEnergyMeter(GnssParser *parser) :
+    _parser(parser)
+{
+    _timer.start();
+    reset();
+}
+
+void GnssEnergyMeter::reset(void)
+{
+    _since = _timer.read_ms();
+    _power = GNSS_POWER_FULL;
+    _psm = GNSS_PSM_ACQUISITION;
+    memset(&_totals, 0, sizeof(_totals));
+    memset(&_current, 0, sizeof(_current));
+    _current.start_ms = _since;
+    _current.state = _power;
+    _head = 0;
+    _count = 0;
+}
+
+void GnssEnergyMeter::_account(int now)
+{
+    uint32_t ms = now - _since;
+
+    _totals.power_ms[_power] += ms;
+    // The receiver state is only known while it is powered
+    if (_power != GNSS_POWER_OFF)
+        _totals.psm_ms[_psm] += ms;
+    _since = now;
+}
+
+void GnssEnergyMeter::_close(int now)
+{
+    _current.on_ms = now - _current.start_ms;
+    _ring[_head] = _current;
+    _head = (_head + 1) % GNSS_ENERGY_RING;
+    if (_count < GNSS_ENERGY_RING)
+        _count++;
+    memset(&_current, 0, sizeof(_current));
+}
+
+void GnssEnergyMeter::power_changed(eGNSS_POWER_STATE from, eGNSS_POWER_STATE to)
+{
+    int now = _timer.read_ms();
+
+    (void)from;
+    _account(now);
+    if (to == GNSS_POWER_OFF) {
+        _close(now);
+    } else if (_power == GNSS_POWER_OFF) {
+        // Wake up, the receiver acquires again
+        _current.start_ms = now;
+        _current.state = to;
+        _psm = GNSS_PSM_ACQUISITION;
+        _totals.wakes++;
+    }
+    _power = to;
+}
+
+void GnssEnergyMeter::add_tx(int len)
+{
+    _totals.bytes += len;
+    _current.bytes += len;
+}
+
+void GnssEnergyMeter::process(char *buf, int ret)
+{
+    int now = _timer.read_ms();
+    int len = LENGTH(ret);
+    bool fix = false;
+
+    if (ret <= 0)
+        return;
+    _totals.bytes += len;
+    _current.bytes += len;
+    if ((PROTOCOL(ret) != GnssParser::UBX) || (len < UBX_FRAME_SIZE))
+        return;
+
+    switch (_parser->get_ubx_message(buf)) {
+    case UBX_NAV_PVT: {
+        tUBX_NAV_PVT pvt = _parser->decode_ubx_nav_pvt_msg(buf);
+        fix = ((pvt.fixType == 0x03) || (pvt.fixType == 0x04)) && (pvt.flag1 & 0x01);
+        break;
+    }
+    case UBX_LOG_BATCH:
+        fix = true;
+        break;
+    case UBX_NAV_STATUS: {
+        tUBX_NAV_STATUS status = _parser->decode_ubx_nav_status_msg(buf);
+        eGNSS_PSM_STATE psm = (eGNSS_PSM_STATE)(status.flags2 & 0x03);
+        if (psm != _psm) {
+            _account(now);
+            _psm = psm;
+        }
+        // Prefer the receiver's own measurement, counted with the next fix
+        if ((_current.ttff_ms == 0) && !_current.fixes && (status.flags & 0x01))
+            _current.ttff_ms = status.ttff;
+        return;
+    }
+    default:
+        return;
+    }
+
+    if (!fix)
+        return;
+    _totals.fixes++;
+    if (_current.fixes++ == 0) {
+        if (_current.ttff_ms == 0)
+            _current.ttff_ms = now - _current.start_ms;
+        // Histogram with bins of < 1 s, < 2 s, < 4 s ...
+        int bin = 0;
+        for (uint32_t s = _current.ttff_ms / 1000; s && (bin < GNSS_ENERGY_TTFF_BINS - 1); s >>= 1)
+            bin++;
+        _totals.ttff[bin]++;
+    }
+}
+
+void GnssEnergyMeter::totals(tGNSS_ENERGY_TOTALS *totals)
+{
+    _account(_timer.read_ms());
+    *totals = _totals;
+}
+
+int GnssEnergyMeter::export_records(tGNSS_ENERGY_RECORD *out, int max) const
+{
+    int n = (_count < max) ? _count : max;
+    int first = (_head - n + GNSS_ENERGY_RING) % GNSS_ENERGY_RING;
+
+    for (int i = 0; i < n; i++)
+        out[i] = _ring[(first + i) % GNSS_ENERGY_RING];
+    return n;
+}
+
+// End Of File
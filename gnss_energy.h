@@ -0,0 +1,134 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GNSS_ENERGY_H
+#define GNSS_ENERGY_H
+
+/**
+ * @file gnss_energy.h
+ * This file defines the accounting of the time spent in each power state,
+ * the time to first fix and the data transferred per fix.
+ */
+
+#include "gnss_power.h"
+
+#define GNSS_ENERGY_RING 32        // wake cycles kept for export
+#define GNSS_ENERGY_TTFF_BINS 8    // < 1 s, < 2 s, < 4 s ... >= 64 s
+
+/** Receiver power save state, psmState of UBX-NAV-STATUS
+*/
+enum eGNSS_PSM_STATE {
+    GNSS_PSM_ACQUISITION,
+    GNSS_PSM_TRACKING,
+    GNSS_PSM_OPTIMIZED,
+    GNSS_PSM_INACTIVE,
+    GNSS_PSM_STATES
+};
+
+/** One wake cycle, from leaving GNSS_POWER_OFF (or the start) to the
+ * next power off
+ */
+typedef struct GNSS_ENERGY_RECORD {
+    uint32_t start_ms;   // time of the wake up
+    uint32_t on_ms;      // time until the power off
+    uint32_t ttff_ms;    // time to the first fix, 0: no fix
+    uint32_t bytes;      // bytes received and sent
+    uint16_t fixes;      // valid fixes
+    uint8_t state;       // eGNSS_POWER_STATE after the wake up
+    uint8_t reserved;
+
+} tGNSS_ENERGY_RECORD;
+
+typedef struct GNSS_ENERGY_TOTALS {
+    uint32_t power_ms[GNSS_POWER_STATES];   // time per controller state
+    uint32_t psm_ms[GNSS_PSM_STATES];       // time per receiver state
+    uint32_t ttff[GNSS_ENERGY_TTFF_BINS];   // TTFF histogram
+    uint32_t fixes;
+    uint32_t bytes;
+    uint32_t wakes;
+
+} tGNSS_ENERGY_TOTALS;
+
+/** Energy accounting.
+ * Attach power_changed() to the GnssPowerController (or call it from the
+ * own power control) and feed every message returned by getMessage to
+ * process(). Commands sent to the receiver are added with add_tx().
+ */
+class GnssEnergyMeter
+{
+public:
+    /** Constructor.
+     * @param parser the parser used to decode the messages.
+     */
+    GnssEnergyMeter(GnssParser *parser);
+
+    /** Account a power state change.
+     * @param from the previous state.
+     * @param to the new state.
+     */
+    void power_changed(eGNSS_POWER_STATE from, eGNSS_POWER_STATE to);
+
+    /** Feed a message returned by getMessage.
+     * @param buf the message.
+     * @param ret the return value of getMessage (protocol and length).
+     */
+    void process(char *buf, int ret);
+
+    /** Account bytes sent to the receiver.
+     * @param len number of bytes.
+     */
+    void add_tx(int len);
+
+    /** Get the totals, the time of the current states included.
+     * @param totals the totals to fill.
+     */
+    void totals(tGNSS_ENERGY_TOTALS *totals);
+
+    /** Mean number of bytes transferred per valid fix.
+     * @return bytes per fix, 0 if there was no fix.
+     */
+    uint32_t bytes_per_fix(void) const { return _totals.fixes ? _totals.bytes / _totals.fixes : 0; }
+
+    /** Copy the finished wake cycles, the oldest first.
+     * @param out the records to fill.
+     * @param max size of the array.
+     * @return number of records copied.
+     */
+    int export_records(tGNSS_ENERGY_RECORD *out, int max) const;
+
+    /** Reset all counters and records.
+     */
+    void reset(void);
+
+private:
+    void _account(int now);
+    void _close(int now);
+
+    GnssParser *_parser;
+    Timer _timer;
+    int _since;                           //!< time of the last accounting in ms
+    eGNSS_POWER_STATE _power;
+    eGNSS_PSM_STATE _psm;
+    tGNSS_ENERGY_TOTALS _totals;
+    tGNSS_ENERGY_RECORD _current;         //!< wake cycle in progress
+    tGNSS_ENERGY_RECORD _ring[GNSS_ENERGY_RING];
+    int _head;                            //!< next record to write
+    int _count;
+};
+
+#endif
+
+// End Of File
@@ -0,0 +1,619 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file gnss_ephemeris.cpp
+ * This file implements the ephemeris cache.
+ */
+
+#include "gnss_ephemeris.h"
+#include <math.h>
+
+#define EPH_FILE_MAGIC   0x48504547 // "GEPH"
+#define EPH_FILE_VERSION 1
+
+#define SC2RAD 3.1415926535898      // semi-circle to radian (IS-GPS-200)
+#define CLIGHT 299792458.0
+
+// ----------------------------------------------------------------
+// Bit field helpers, bit 0 is the MSB of buff[0]
+// ----------------------------------------------------------------
+
+static uint32_t getbitu(const uint8_t *buff, int pos, int len)
+{
+    uint32_t bits = 0;
+    for (int i = pos; i < pos + len; i++)
+        bits = (bits << 1) | ((buff[i / 8] >> (7 - i % 8)) & 1u);
+    return bits;
+}
+
+static int32_t getbits(const uint8_t *buff, int pos, int len)
+{
+    uint32_t bits = getbitu(buff, pos, len);
+    if ((len >= 32) || !(bits & (1u << (len - 1))))
+        return (int32_t)bits;
+    return (int32_t)(bits | (~0u << len));
+}
+
+static uint32_t getbitu2(const uint8_t *buff, int p1, int l1, int p2, int l2)
+{
+    return (getbitu(buff, p1, l1) << l2) | getbitu(buff, p2, l2);
+}
+
+static int32_t getbits2(const uint8_t *buff, int p1, int l1, int p2, int l2)
+{
+    if (getbitu(buff, p1, 1))
+        return (int32_t)((getbits(buff, p1, l1) * (1u << l2)) | getbitu(buff, p2, l2));
+    return (int32_t)getbitu2(buff, p1, l1, p2, l2);
+}
+
+static void setbitu(uint8_t *buff, int pos, int len, uint32_t data)
+{
+    uint32_t mask = 1u << (len - 1);
+    for (int i = pos; i < pos + len; i++, mask >>= 1) {
+        if (data & mask)
+            buff[i / 8] |= 1u << (7 - i % 8);
+        else
+            buff[i / 8] &= ~(1u << (7 - i % 8));
+    }
+}
+
+static uint32_t crc24q(const uint8_t *buff, int len)
+{
+    uint32_t crc = 0;
+    for (int i = 0; i < len; i++) {
+        crc ^= (uint32_t)buff[i] << 16;
+        for (int b = 0; b < 8; b++) {
+            crc <<= 1;
+            if (crc & 0x1000000)
+                crc ^= 0x1864CFB;
+        }
+    }
+    return crc & 0xFFFFFF;
+}
+
+// ----------------------------------------------------------------
+// Cache
+// ----------------------------------------------------------------
+
+GnssEphemerisCache::GnssEphemerisCache() : _tick(0)
+{
+    clear();
+}
+
+void GnssEphemerisCache::clear(void)
+{
+    memset(_eph, 0, sizeof(_eph));
+    memset(_asm, 0, sizeof(_asm));
+}
+
+int GnssEphemerisCache::_index(uint8_t gnssId, uint8_t svId)
+{
+    switch (gnssId) {
+    case GNSS_ID_GPS:
+        return ((svId >= 1) && (svId <= GNSS_EPH_MAX_GPS)) ? (svId - 1) : -1;
+    case GNSS_ID_GALILEO:
+        return ((svId >= 1) && (svId <= GNSS_EPH_MAX_GALILEO)) ? (GNSS_EPH_MAX_GPS + svId - 1) : -1;
+    case GNSS_ID_BEIDOU:
+        return ((svId >= 1) && (svId <= GNSS_EPH_MAX_BEIDOU)) ?
+               (GNSS_EPH_MAX_GPS + GNSS_EPH_MAX_GALILEO + svId - 1) : -1;
+    default:
+        return -1;
+    }
+}
+
+const tGNSS_EPHEMERIS *GnssEphemerisCache::get(uint8_t gnssId, uint8_t svId) const
+{
+    int ix = _index(gnssId, svId);
+    return ((ix >= 0) && _eph[ix].svId) ? &_eph[ix] : NULL;
+}
+
+const tGNSS_EPHEMERIS *GnssEphemerisCache::get(uint8_t gnssId, uint8_t svId, uint16_t iode) const
+{
+    const tGNSS_EPHEMERIS *eph = get(gnssId, svId);
+    return (eph && (eph->iode == iode)) ? eph : NULL;
+}
+
+int GnssEphemerisCache::count(void) const
+{
+    int n = 0;
+    for (int i = 0; i < GNSS_EPH_SLOTS; i++) {
+        if (_eph[i].svId)
+            n++;
+    }
+    return n;
+}
+
+int GnssEphemerisCache::_store(const tGNSS_EPHEMERIS *eph)
+{
+    int ix = _index(eph->gnssId, eph->svId);
+    if (ix < 0)
+        return 0;
+    if (_eph[ix].svId && (_eph[ix].iode == eph->iode) && (_eph[ix].toe == eph->toe))
+        return 0; // same ephemeris again
+    _eph[ix] = *eph;
+    return 1;
+}
+
+GnssEphemerisCache::tASSEMBLY *GnssEphemerisCache::_assembly(uint8_t gnssId, uint8_t svId)
+{
+    tASSEMBLY *lru = &_asm[0];
+
+    _tick++;
+    for (int i = 0; i < GNSS_EPH_ASSEMBLY_SLOTS; i++) {
+        if (_asm[i].svId && (_asm[i].gnssId == gnssId) && (_asm[i].svId == svId)) {
+            _asm[i].used = _tick;
+            return &_asm[i];
+        }
+        if (!_asm[i].svId || (lru->svId && (_asm[i].used < lru->used)))
+            lru = &_asm[i];
+    }
+    // Reuse a free or the least recently used slot
+    lru->gnssId = gnssId;
+    lru->svId = svId;
+    lru->mask = 0;
+    lru->used = _tick;
+    return lru;
+}
+
+int GnssEphemerisCache::process(GnssParser *parser, char *buf, int len)
+{
+    tUBX_RXM_SFRBX frame;
+
+    if (PROTOCOL(len) == GnssParser::UBX)
+        len = LENGTH(len);
+    if ((len < UBX_FRAME_SIZE) || (parser->get_ubx_message(buf) != UBX_RXM_SFRBX))
+        return 0;
+    if (parser->decode_ubx_rxm_sfrbx_msg(buf, len, &frame) < 0)
+        return 0;
+    return add_sfrbx(&frame);
+}
+
+int GnssEphemerisCache::add_sfrbx(const tUBX_RXM_SFRBX *frame)
+{
+    switch (frame->gnssId) {
+    case GNSS_ID_GPS:
+        return _add_gps(frame);
+    case GNSS_ID_GALILEO:
+        return _add_galileo(frame);
+    case GNSS_ID_BEIDOU:
+        return _add_beidou(frame);
+    default:
+        return 0;
+    }
+}
+
+// GPS LNAV: 10 words of 30 bits, the 24 data bits of each word are kept
+int GnssEphemerisCache::_add_gps(const tUBX_RXM_SFRBX *frame)
+{
+    uint8_t sub[30];
+    tGNSS_EPHEMERIS eph;
+    tASSEMBLY *a;
+    int id;
+
+    if ((frame->numWords < 10) || (_index(GNSS_ID_GPS, frame->svId) < 0))
+        return 0;
+    for (int i = 0; i < 10; i++)
+        setbitu(sub, 24 * i, 24, (frame->dwrd[i] >> 6) & 0xFFFFFF);
+    id = getbitu(sub, 43, 3);
+    if ((id < 1) || (id > 3))
+        return 0; // almanac pages are not cached
+
+    a = _assembly(GNSS_ID_GPS, frame->svId);
+    memcpy(&a->raw[(id - 1) * 30], sub, 30);
+    a->mask |= 1 << (id - 1);
+    if (a->mask != 0x07)
+        return 0;
+
+    const uint8_t *s1 = &a->raw[0];
+    const uint8_t *s2 = &a->raw[30];
+    const uint8_t *s3 = &a->raw[60];
+    uint32_t iodc = getbitu(s1, 168, 8);
+    if ((getbitu(s2, 48, 8) != iodc) || (getbitu(s3, 216, 8) != iodc)) {
+        // Subframes of different issues, start again with the latest one
+        a->mask = 1 << (id - 1);
+        return 0;
+    }
+
+    memset(&eph, 0, sizeof(eph));
+    eph.gnssId = GNSS_ID_GPS;
+    eph.svId = frame->svId;
+    eph.week = getbitu(s1, 48, 10);
+    eph.sva = getbitu(s1, 60, 4);
+    eph.health = getbitu(s1, 64, 6);
+    eph.tgd = getbits(s1, 160, 8);
+    eph.toc = getbitu(s1, 176, 16) * 16;
+    eph.af2 = getbits(s1, 192, 8);
+    eph.af1 = getbits(s1, 200, 16);
+    eph.af0 = getbits(s1, 216, 22);
+
+    eph.iode = getbitu(s2, 48, 8);
+    eph.crs = getbits(s2, 56, 16);
+    eph.deln = getbits(s2, 72, 16);
+    eph.M0 = getbits(s2, 88, 32);
+    eph.cuc = getbits(s2, 120, 16);
+    eph.e = getbitu(s2, 136, 32);
+    eph.cus = getbits(s2, 168, 16);
+    eph.sqrtA = getbitu(s2, 184, 32);
+    eph.toe = getbitu(s2, 216, 16) * 16;
+
+    eph.cic = getbits(s3, 48, 16);
+    eph.OMG0 = getbits(s3, 64, 32);
+    eph.cis = getbits(s3, 96, 16);
+    eph.i0 = getbits(s3, 112, 32);
+    eph.crc = getbits(s3, 144, 16);
+    eph.omg = getbits(s3, 160, 32);
+    eph.OMGd = getbits(s3, 192, 24);
+    eph.idot = getbits(s3, 224, 14);
+
+    a->svId = 0;
+    return _store(&eph);
+}
+
+// Galileo I/NAV: even and odd page part in 8 words, 128 bit word per page pair
+int GnssEphemerisCache::_add_galileo(const tUBX_RXM_SFRBX *frame)
+{
+    uint8_t buff[32];
+    uint8_t crc_buff[26];
+    uint8_t word[16];
+    tGNSS_EPHEMERIS eph;
+    tASSEMBLY *a;
+    int type;
+
+    if ((frame->numWords < 8) || (_index(GNSS_ID_GALILEO, frame->svId) < 0))
+        return 0;
+    for (int i = 0; i < 8; i++)
+        setbitu(buff, 32 * i, 32, frame->dwrd[i]);
+
+    // even part first, no alert pages
+    if ((getbitu(buff, 0, 1) != 0) || (getbitu(buff + 16, 0, 1) != 1) ||
+            getbitu(buff, 1, 1) || getbitu(buff + 16, 1, 1))
+        return 0;
+
+    memset(crc_buff, 0, sizeof(crc_buff));
+    for (int i = 0, j = 4; i < 15; i++, j += 8)
+        setbitu(crc_buff, j, 8, getbitu(buff, i * 8, 8));
+    for (int i = 0, j = 118; i < 11; i++, j += 8)
+        setbitu(crc_buff, j, 8, getbitu(buff + 16, i * 8, 8));
+    if (crc24q(crc_buff, 25) != getbitu(buff + 16, 82, 24))
+        return 0;
+
+    type = getbitu(buff, 2, 6);
+    if ((type < 1) || (type > 5))
+        return 0;
+    for (int i = 0; i < 14; i++)
+        word[i] = getbitu(buff, 2 + 8 * i, 8);
+    for (int i = 14; i < 16; i++)
+        word[i] = getbitu(buff, 130 + 8 * (i - 14), 8);
+
+    a = _assembly(GNSS_ID_GALILEO, frame->svId);
+    memcpy(&a->raw[(type - 1) * 16], word, 16);
+    a->mask |= 1 << (type - 1);
+    if (a->mask != 0x1F)
+        return 0;
+
+    const uint8_t *w1 = &a->raw[0];
+    const uint8_t *w2 = &a->raw[16];
+    const uint8_t *w3 = &a->raw[32];
+    const uint8_t *w4 = &a->raw[48];
+    const uint8_t *w5 = &a->raw[64];
+    uint32_t iod = getbitu(w1, 6, 10);
+    if ((getbitu(w2, 6, 10) != iod) || (getbitu(w3, 6, 10) != iod) || (getbitu(w4, 6, 10) != iod)) {
+        a->mask = 1 << (type - 1);
+        return 0;
+    }
+
+    memset(&eph, 0, sizeof(eph));
+    eph.gnssId = GNSS_ID_GALILEO;
+    eph.svId = frame->svId;
+    eph.iode = iod;
+    eph.toe = getbitu(w1, 16, 14) * 60;
+    eph.M0 = getbits(w1, 30, 32);
+    eph.e = getbitu(w1, 62, 32);
+    eph.sqrtA = getbitu(w1, 94, 32);
+
+    eph.OMG0 = getbits(w2, 16, 32);
+    eph.i0 = getbits(w2, 48, 32);
+    eph.omg = getbits(w2, 80, 32);
+    eph.idot = getbits(w2, 112, 14);
+
+    eph.OMGd = getbits(w3, 16, 24);
+    eph.deln = getbits(w3, 40, 16);
+    eph.cuc = getbits(w3, 56, 16);
+    eph.cus = getbits(w3, 72, 16);
+    eph.crc = getbits(w3, 88, 16);
+    eph.crs = getbits(w3, 104, 16);
+    eph.sva = getbitu(w3, 120, 8);
+
+    eph.cic = getbits(w4, 22, 16);
+    eph.cis = getbits(w4, 38, 16);
+    eph.toc = getbitu(w4, 54, 14) * 60;
+    eph.af0 = getbits(w4, 68, 31);
+    eph.af1 = getbits(w4, 99, 21);
+    eph.af2 = getbits(w4, 120, 6);
+
+    eph.tgd = getbits(w5, 57, 10); // BGD E1-E5b
+    eph.health = (getbitu(w5, 67, 2) << 7) | (getbitu(w5, 71, 1) << 6) |
+                 (getbitu(w5, 69, 2) << 1) | getbitu(w5, 72, 1);
+    eph.week = getbitu(w5, 73, 12);
+
+    a->svId = 0;
+    return _store(&eph);
+}
+
+// BeiDou D1 (MEO/IGSO): 10 words of 30 bits including parity, 300 bits per subframe
+int GnssEphemerisCache::_add_beidou(const tUBX_RXM_SFRBX *frame)
+{
+    uint8_t sub[38];
+    tGNSS_EPHEMERIS eph;
+    tASSEMBLY *a;
+    int id;
+
+    // GEO satellites broadcast D2 and are not decoded
+    if ((frame->numWords < 10) || (frame->svId < 6) || (frame->svId > 58))
+        return 0;
+    memset(sub, 0, sizeof(sub));
+    for (int i = 0; i < 10; i++)
+        setbitu(sub, 30 * i, 30, frame->dwrd[i] & 0x3FFFFFFF);
+    id = getbitu(sub, 15, 3);
+    if ((id < 1) || (id > 3))
+        return 0;
+
+    a = _assembly(GNSS_ID_BEIDOU, frame->svId);
+    memcpy(&a->raw[(id - 1) * 38], sub, 38);
+    a->mask |= 1 << (id - 1);
+    if (a->mask != 0x07)
+        return 0;
+
+    const uint8_t *s1 = &a->raw[0];
+    const uint8_t *s2 = &a->raw[38];
+    const uint8_t *s3 = &a->raw[76];
+    uint32_t sow1 = getbitu2(s1, 18, 8, 30, 12);
+    uint32_t sow2 = getbitu2(s2, 18, 8, 30, 12);
+    uint32_t sow3 = getbitu2(s3, 18, 8, 30, 12);
+    if ((sow2 != sow1 + 6) || (sow3 != sow2 + 6)) {
+        // Subframes of different frames, start again with the latest one
+        a->mask = 1 << (id - 1);
+        return 0;
+    }
+
+    memset(&eph, 0, sizeof(eph));
+    eph.gnssId = GNSS_ID_BEIDOU;
+    eph.svId = frame->svId;
+    eph.health = getbitu(s1, 42, 1);
+    eph.sva = getbitu(s1, 48, 4);
+    eph.week = getbitu(s1, 60, 13);
+    eph.toc = getbitu2(s1, 73, 9, 90, 8) * 8;
+    eph.tgd = getbits(s1, 98, 10); // TGD1
+    eph.af2 = getbits(s1, 214, 11);
+    eph.af0 = getbits2(s1, 225, 7, 240, 17);
+    eph.af1 = getbits2(s1, 257, 5, 270, 17);
+    eph.iode = getbitu(s1, 287, 5);
+
+    eph.deln = getbits2(s2, 42, 10, 60, 6);
+    eph.cuc = getbits2(s2, 66, 16, 90, 2);
+    eph.M0 = getbits2(s2, 92, 20, 120, 12);
+    eph.e = getbitu2(s2, 132, 10, 150, 22);
+    eph.cus = getbits(s2, 180, 18);
+    eph.crc = getbits2(s2, 198, 4, 210, 14);
+    eph.crs = getbits2(s2, 224, 8, 240, 10);
+    eph.sqrtA = getbitu2(s2, 250, 12, 270, 20);
+    eph.toe = ((getbitu(s2, 290, 2) << 15) | getbitu2(s3, 42, 10, 60, 5)) * 8;
+
+    eph.i0 = getbits2(s3, 65, 17, 90, 15);
+    eph.cic = getbits2(s3, 105, 7, 120, 11);
+    eph.OMGd = getbits2(s3, 131, 11, 150, 13);
+    eph.cis = getbits2(s3, 163, 9, 180, 9);
+    eph.idot = getbits2(s3, 189, 13, 210, 1);
+    eph.OMG0 = getbits2(s3, 211, 21, 240, 11);
+    eph.omg = getbits2(s3, 251, 11, 270, 21);
+
+    a->svId = 0;
+    return _store(&eph);
+}
+
+// ----------------------------------------------------------------
+// Serialisation: header, records in native byte order, CRC-32
+// ----------------------------------------------------------------
+
+int GnssEphemerisCache::save(const char *path) const
+{
+    uint32_t header[3] = { EPH_FILE_MAGIC, EPH_FILE_VERSION, (uint32_t)count() };
+    uint32_t crc = 0;
+    FILE *fp = fopen(path, "wb");
+    int ok;
+
+    if (fp == NULL)
+        return -1;
+    ok = (fwrite(header, sizeof(header), 1, fp) == 1);
+    for (int i = 0; ok && (i < GNSS_EPH_SLOTS); i++) {
+        if (_eph[i].svId) {
+            ok = (fwrite(&_eph[i], sizeof(tGNSS_EPHEMERIS), 1, fp) == 1);
+            crc = gnss_crc32(crc, &_eph[i], sizeof(tGNSS_EPHEMERIS));
+        }
+    }
+    ok = ok && (fwrite(&crc, sizeof(crc), 1, fp) == 1);
+    ok = (fclose(fp) == 0) && ok;
+
+    return ok ? (int)header[2] : -1;
+}
+
+int GnssEphemerisCache::load(const char *path)
+{
+    uint32_t header[3];
+    uint32_t crc = 0;
+    uint32_t stored;
+    tGNSS_EPHEMERIS eph;
+    FILE *fp = fopen(path, "rb");
+    int n = 0;
+
+    if (fp == NULL)
+        return -1;
+    if ((fread(header, sizeof(header), 1, fp) != 1) ||
+            (header[0] != EPH_FILE_MAGIC) || (header[1] != EPH_FILE_VERSION) ||
+            (header[2] > GNSS_EPH_SLOTS)) {
+        fclose(fp);
+        return -1;
+    }
+    // Check the whole file before touching the cache
+    for (uint32_t i = 0; i < header[2]; i++) {
+        if (fread(&eph, sizeof(eph), 1, fp) != 1) {
+            fclose(fp);
+            return -1;
+        }
+        crc = gnss_crc32(crc, &eph, sizeof(eph));
+    }
+    if ((fread(&stored, sizeof(stored), 1, fp) != 1) || (stored != crc)) {
+        fclose(fp);
+        return -1;
+    }
+
+    fseek(fp, sizeof(header), SEEK_SET);
+    for (uint32_t i = 0; i < header[2]; i++) {
+        if (fread(&eph, sizeof(eph), 1, fp) == 1) {
+            int ix = _index(eph.gnssId, eph.svId);
+            if (ix >= 0) {
+                _eph[ix] = eph;
+                n++;
+            }
+        }
+    }
+    fclose(fp);
+
+    return n;
+}
+
+#ifndef GNSS_FIXED_POINT
+// ----------------------------------------------------------------
+// Satellite position (IS-GPS-200, Galileo OS SIS ICD, BDS-SIS-ICD MEO/IGSO)
+// ----------------------------------------------------------------
+
+bool GnssEphemerisCache::sv_position(const tGNSS_EPHEMERIS *eph, double tow, double pos[3], double *dts)
+{
+    double mu, omge, crx, cux, af0, af1, af2;
+
+    switch (eph->gnssId) {
+    case GNSS_ID_GPS:
+        mu = 3.9860050E14;
+        omge = 7.2921151467E-5;
+        crx = ldexp(1.0, -5);
+        cux = ldexp(1.0, -29);
+        af0 = ldexp(1.0, -31);
+        af1 = ldexp(1.0, -43);
+        af2 = ldexp(1.0, -55);
+        break;
+    case GNSS_ID_GALILEO:
+        mu = 3.986004418E14;
+        omge = 7.2921151467E-5;
+        crx = ldexp(1.0, -5);
+        cux = ldexp(1.0, -29);
+        af0 = ldexp(1.0, -34);
+        af1 = ldexp(1.0, -46);
+        af2 = ldexp(1.0, -59);
+        break;
+    case GNSS_ID_BEIDOU:
+        mu = 3.986004418E14;
+        omge = 7.292115E-5;
+        crx = ldexp(1.0, -6);
+        cux = ldexp(1.0, -31);
+        af0 = ldexp(1.0, -33);
+        af1 = ldexp(1.0, -50);
+        af2 = ldexp(1.0, -66);
+        break;
+    default:
+        return false;
+    }
+
+    double sqrtA = eph->sqrtA * ldexp(1.0, -19);
+    double A = sqrtA * sqrtA;
+    double e = eph->e * ldexp(1.0, -33);
+    double tk = tow - eph->toe;
+    if (A <= 0.0)
+        return false;
+    if (tk > 302400.0)
+        tk -= 604800.0;
+    else if (tk < -302400.0)
+        tk += 604800.0;
+
+    double n = sqrt(mu / (A * A * A)) + eph->deln * ldexp(1.0, -43) * SC2RAD;
+    double M = eph->M0 * ldexp(1.0, -31) * SC2RAD + n * tk;
+    double E = M;
+    for (int i = 0; i < 30; i++) {
+        double Ek = E;
+        E = M + e * sin(Ek);
+        if (fabs(E - Ek) < 1E-14)
+            break;
+    }
+    double sinE = sin(E);
+    double cosE = cos(E);
+
+    double u = atan2(sqrt(1.0 - e * e) * sinE, cosE - e) + eph->omg * ldexp(1.0, -31) * SC2RAD;
+    double r = A * (1.0 - e * cosE);
+    double i = eph->i0 * ldexp(1.0, -31) * SC2RAD + eph->idot * ldexp(1.0, -43) * SC2RAD * tk;
+    double sin2u = sin(2.0 * u);
+    double cos2u = cos(2.0 * u);
+    u += (eph->cus * sin2u + eph->cuc * cos2u) * cux;
+    r += (eph->crs * sin2u + eph->crc * cos2u) * crx;
+    i += (eph->cis * sin2u + eph->cic * cos2u) * cux;
+
+    double x = r * cos(u);
+    double y = r * sin(u);
+    double O = eph->OMG0 * ldexp(1.0, -31) * SC2RAD +
+               (eph->OMGd * ldexp(1.0, -43) * SC2RAD - omge) * tk - omge * eph->toe;
+    double sinO = sin(O);
+    double cosO = cos(O);
+    double cosi = cos(i);
+
+    pos[0] = x * cosO - y * cosi * sinO;
+    pos[1] = x * sinO + y * cosi * cosO;
+    pos[2] = y * sin(i);
+
+    if (dts) {
+        double tc = tow - eph->toc;
+        if (tc > 302400.0)
+            tc -= 604800.0;
+        else if (tc < -302400.0)
+            tc += 604800.0;
+        *dts = eph->af0 * af0 + eph->af1 * af1 * tc + eph->af2 * af2 * tc * tc
+               - 2.0 * sqrt(mu * A) * e * sinE / (CLIGHT * CLIGHT);
+    }
+    return true;
+}
+
+double GnssEphemerisCache::elevation(const double pos[3], int32_t lat, int32_t lon, int32_t height)
+{
+    const double a = 6378137.0;
+    const double e2 = 6.69437999014E-3;
+    double phi = lat * 1E-7 * (M_PI / 180.0);
+    double lam = lon * 1E-7 * (M_PI / 180.0);
+    double h = height * 1E-3;
+    double sinp = sin(phi), cosp = cos(phi);
+    double sinl = sin(lam), cosl = cos(lam);
+    double N = a / sqrt(1.0 - e2 * sinp * sinp);
+    double d[3];
+
+    d[0] = pos[0] - (N + h) * cosp * cosl;
+    d[1] = pos[1] - (N + h) * cosp * sinl;
+    d[2] = pos[2] - (N * (1.0 - e2) + h) * sinp;
+
+    double up = d[0] * cosp * cosl + d[1] * cosp * sinl + d[2] * sinp;
+    double range = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+
+    return (range > 0.0) ? asin(up / range) * (180.0 / M_PI) : 0.0;
+}
+#endif
+
+// End Of File
@@ -0,0 +1,183 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GNSS_EPHEMERIS_H
+#define GNSS_EPHEMERIS_H
+
+/**
+ * @file gnss_ephemeris.h
+ * This file defines a cache of broadcast ephemerides assembled from the
+ * navigation subframes reported by UBX-RXM-SFRBX.
+ */
+
+#include "gnss.h"
+
+/** gnssId values used by u-blox receivers
+ */
+#define GNSS_ID_GPS     0
+#define GNSS_ID_GALILEO 2
+#define GNSS_ID_BEIDOU  3
+
+#define GNSS_EPH_MAX_GPS     32
+#define GNSS_EPH_MAX_GALILEO 36
+#define GNSS_EPH_MAX_BEIDOU  63
+#define GNSS_EPH_SLOTS       (GNSS_EPH_MAX_GPS + GNSS_EPH_MAX_GALILEO + GNSS_EPH_MAX_BEIDOU)
+
+#define GNSS_EPH_ASSEMBLY_SLOTS 16
+#define GNSS_EPH_ASSEMBLY_SIZE  120
+
+/** Broadcast ephemeris kept in its transmitted integer form.
+ *  The scale factors depend on the constellation, see GnssEphemerisCache::sv_position().
+ */
+typedef struct GNSS_EPHEMERIS {
+    uint8_t gnssId;
+    uint8_t svId;      // 0: slot empty
+    uint8_t sva;       // URA (GPS, BeiDou) or SISA (Galileo) index
+    uint8_t reserved;
+    uint16_t health;
+    uint16_t iode;     // IODE (GPS), IODnav (Galileo), AODE (BeiDou)
+    uint16_t week;
+    uint16_t reserved2;
+    uint32_t toe;      // s of week
+    uint32_t toc;      // s of week
+    int32_t M0;
+    int32_t deln;
+    int32_t OMG0;
+    int32_t i0;
+    int32_t omg;
+    int32_t OMGd;
+    int32_t idot;
+    uint32_t e;
+    uint32_t sqrtA;
+    int32_t crc;
+    int32_t crs;
+    int32_t cuc;
+    int32_t cus;
+    int32_t cic;
+    int32_t cis;
+    int32_t af0;
+    int32_t af1;
+    int32_t af2;
+    int32_t tgd;
+
+} tGNSS_EPHEMERIS;
+
+/** Ephemeris cache.
+ * Decodes GPS L1 C/A (LNAV), Galileo E1-B (I/NAV) and BeiDou B1I D1
+ * (MEO/IGSO) subframes and keeps the latest complete ephemeris per
+ * satellite in a table indexed by constellation and SV.
+ */
+class GnssEphemerisCache
+{
+public:
+    /** Constructor.
+     */
+    GnssEphemerisCache();
+
+    /** Feed a message returned by getMessage.
+     * @param parser the parser used to decode the message.
+     * @param buf the message.
+     * @param len the length of the message.
+     * @return 1 if a new ephemeris was completed, 0 otherwise.
+     */
+    int process(GnssParser *parser, char *buf, int len);
+
+    /** Add a decoded subframe.
+     * @param frame the subframe.
+     * @return 1 if a new ephemeris was completed, 0 otherwise.
+     */
+    int add_sfrbx(const tUBX_RXM_SFRBX *frame);
+
+    /** Get the ephemeris of a satellite.
+     * @param gnssId the constellation.
+     * @param svId the satellite.
+     * @return the ephemeris or NULL if none is available.
+     */
+    const tGNSS_EPHEMERIS *get(uint8_t gnssId, uint8_t svId) const;
+
+    /** Get the ephemeris of a satellite with a given issue of data.
+     * @param gnssId the constellation.
+     * @param svId the satellite.
+     * @param iode the issue of data.
+     * @return the ephemeris or NULL if none is available.
+     */
+    const tGNSS_EPHEMERIS *get(uint8_t gnssId, uint8_t svId, uint16_t iode) const;
+
+    /** Number of ephemerides in the cache.
+     * @return the number of ephemerides.
+     */
+    int count(void) const;
+
+    /** Remove all ephemerides.
+     */
+    void clear(void);
+
+    /** Write the cache to a file.
+     * @param path the file name.
+     * @return number of ephemerides written, -1 on failure.
+     */
+    int save(const char *path) const;
+
+    /** Read the cache from a file written by save().
+     * @param path the file name.
+     * @return number of ephemerides read, -1 on failure.
+     */
+    int load(const char *path);
+
+#ifndef GNSS_FIXED_POINT
+    /** Compute the satellite position and clock offset.
+     * @param eph the ephemeris.
+     * @param tow time of week in the time system of the constellation (s).
+     * @param pos ECEF position (m).
+     * @param dts clock offset (s), may be NULL.
+     * @return true if successful, false otherwise.
+     */
+    static bool sv_position(const tGNSS_EPHEMERIS *eph, double tow, double pos[3], double *dts);
+
+    /** Compute the elevation of a satellite seen from a receiver.
+     * @param pos ECEF satellite position (m).
+     * @param lat receiver latitude, scaling 1e-7 deg.
+     * @param lon receiver longitude, scaling 1e-7 deg.
+     * @param height receiver height above ellipsoid (mm).
+     * @return elevation (deg).
+     */
+    static double elevation(const double pos[3], int32_t lat, int32_t lon, int32_t height);
+#endif
+
+private:
+    typedef struct {
+        uint8_t gnssId;
+        uint8_t svId;    // 0: slot free
+        uint8_t mask;    // received subframes / word types
+        uint32_t used;
+        uint8_t raw[GNSS_EPH_ASSEMBLY_SIZE];
+    } tASSEMBLY;
+
+    static int _index(uint8_t gnssId, uint8_t svId);
+    tASSEMBLY *_assembly(uint8_t gnssId, uint8_t svId);
+    int _store(const tGNSS_EPHEMERIS *eph);
+    int _add_gps(const tUBX_RXM_SFRBX *frame);
+    int _add_galileo(const tUBX_RXM_SFRBX *frame);
+    int _add_beidou(const tUBX_RXM_SFRBX *frame);
+
+    tGNSS_EPHEMERIS _eph[GNSS_EPH_SLOTS];
+    tASSEMBLY _asm[GNSS_EPH_ASSEMBLY_SLOTS];
+    uint32_t _tick;
+};
+
+#endif
+
+// End Of File
@@ -0,0 +1,172 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file gnss_epoch.cpp
+ * This file implements the navigation epoch assembler.
+ */
+
+#include "gnss_epoch.h"
+
+GnssEpochAssembler::GnssEpochAssembler(GnssParser *parser, uint8_t enabled, int timeout_ms) :
+    _parser(parser), _enabled(enabled), _timeout(timeout_ms),
+    _lastItow(0), _published(false), _incomplete(0)
+{
+    for (int i = 0; i < GNSS_EPOCH_SLOTS; i++) {
+        _used[i] = false;
+        _opened[i] = 0;
+    }
+    _timer.start();
+}
+
+void GnssEpochAssembler::attach(Callback<void(const tGNSS_EPOCH *)> cb)
+{
+    _cb = cb;
+}
+
+void GnssEpochAssembler::set_enabled(uint8_t enabled)
+{
+    _enabled = enabled;
+}
+
+tGNSS_EPOCH *GnssEpochAssembler::_slot(uint32_t itow)
+{
+    int oldest = -1;
+
+    for (int i = 0; i < GNSS_EPOCH_SLOTS; i++) {
+        if (_used[i] && (_slots[i].itow == itow))
+            return &_slots[i];
+    }
+    for (int i = 0; i < GNSS_EPOCH_SLOTS; i++) {
+        if (!_used[i]) {
+            oldest = i;
+            break;
+        }
+        if ((oldest < 0) || (_opened[i] < _opened[oldest]))
+            oldest = i;
+    }
+    // All slots busy, the oldest epoch is pushed out incomplete
+    if (_used[oldest])
+        _publish(oldest, false);
+
+    _used[oldest] = true;
+    _opened[oldest] = _timer.read_ms();
+    _slots[oldest].itow = itow;
+    _slots[oldest].content = 0;
+    _slots[oldest].complete = false;
+    return &_slots[oldest];
+}
+
+void GnssEpochAssembler::_publish(int ix, bool complete)
+{
+    _slots[ix].complete = complete;
+    if (!complete)
+        _incomplete++;
+    _lastItow = _slots[ix].itow;
+    _published = true;
+    _used[ix] = false;
+    if (_cb)
+        _cb(&_slots[ix]);
+}
+
+bool GnssEpochAssembler::process(char *buf, int len)
+{
+    eUBX_MESSAGE type;
+    tGNSS_EPOCH *epoch;
+    uint32_t itow;
+
+    if (PROTOCOL(len) == GnssParser::UBX)
+        len = LENGTH(len);
+    if (len < UBX_FRAME_SIZE)
+        return false;
+
+    // iTOW is at offset 0, after version and reserved bytes in UBX-NAV-ODO
+    type = _parser->get_ubx_message(buf);
+    switch (type) {
+    case UBX_NAV_PVT:
+    case UBX_NAV_STATUS:
+    case UBX_NAV_SAT:
+    case UBX_NAV_EOE:
+        if (len < UBX_FRAME_SIZE + 4)
+            return false;
+        itow = ubx_u4(&buf[UBX_PAYLOAD_INDEX]);
+        break;
+    case UBX_NAV_ODO:
+        if (len < UBX_FRAME_SIZE + 8)
+            return false;
+        itow = ubx_u4(&buf[UBX_PAYLOAD_INDEX + 4]);
+        break;
+    default:
+        poll();
+        return false;
+    }
+
+    // Late message of an epoch that was already published
+    if (_published && (itow == _lastItow)) {
+        poll();
+        return true;
+    }
+
+    if (type == UBX_NAV_EOE) {
+        for (int i = 0; i < GNSS_EPOCH_SLOTS; i++) {
+            if (_used[i] && (_slots[i].itow == itow))
+                _publish(i, (_slots[i].content & _enabled) == _enabled);
+        }
+        poll();
+        return true;
+    }
+
+    epoch = _slot(itow);
+    switch (type) {
+    case UBX_NAV_PVT:
+        epoch->pvt = _parser->decode_ubx_nav_pvt_msg(buf);
+        epoch->content |= GNSS_EPOCH_PVT;
+        break;
+    case UBX_NAV_STATUS:
+        epoch->status = _parser->decode_ubx_nav_status_msg(buf);
+        epoch->content |= GNSS_EPOCH_STATUS;
+        break;
+    case UBX_NAV_ODO:
+        epoch->odo = _parser->decode_ubx_nav_odo_msg(buf);
+        epoch->content |= GNSS_EPOCH_ODO;
+        break;
+    case UBX_NAV_SAT:
+        epoch->sat = _parser->decode_ubx_nav_sat_msg(buf, len);
+        epoch->content |= GNSS_EPOCH_SAT;
+        break;
+    default:
+        break;
+    }
+
+    // Publish immediately once the last expected message arrived
+    if ((epoch->content & _enabled) == _enabled)
+        _publish(epoch - _slots, true);
+
+    poll();
+    return true;
+}
+
+void GnssEpochAssembler::poll(void)
+{
+    int now = _timer.read_ms();
+
+    for (int i = 0; i < GNSS_EPOCH_SLOTS; i++) {
+        if (_used[i] && ((now - _opened[i]) >= _timeout))
+            _publish(i, false);
+    }
+}
+
+// End Of File
@@ -0,0 +1,113 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GNSS_EPOCH_H
+#define GNSS_EPOCH_H
+
+/**
+ * @file gnss_epoch.h
+ * This file defines a class that assembles the navigation messages of one
+ * epoch (same iTOW) into a single record.
+ */
+
+#include "gnss.h"
+
+#define GNSS_EPOCH_SLOTS 4
+#define GNSS_EPOCH_TIMEOUT_MS 500
+
+/** Navigation messages that can be part of an epoch
+*/
+enum eGNSS_EPOCH_CONTENT {
+    GNSS_EPOCH_PVT    = 0x01,
+    GNSS_EPOCH_STATUS = 0x02,
+    GNSS_EPOCH_ODO    = 0x04,
+    GNSS_EPOCH_SAT    = 0x08
+};
+
+typedef struct GNSS_EPOCH {
+    uint32_t itow;
+    uint8_t content;  // eGNSS_EPOCH_CONTENT mask of the received messages
+    bool complete;    // false if closed by UBX-NAV-EOE, timeout or slot reuse
+    tUBX_NAV_PVT pvt;
+    tUBX_NAV_STATUS status;
+    tUBX_NAV_ODO odo;
+    tUBX_NAV_SAT sat;
+
+} tGNSS_EPOCH;
+
+/** Navigation epoch assembler.
+ * Collects the enabled navigation messages of an epoch in one of a fixed
+ * pool of slots and publishes the record as soon as the last expected
+ * message arrived, on UBX-NAV-EOE or after a timeout.
+ */
+class GnssEpochAssembler
+{
+public:
+    /** Constructor.
+     * @param parser the parser used to decode the messages.
+     * @param enabled eGNSS_EPOCH_CONTENT mask of the messages output by the receiver.
+     * @param timeout_ms time after the first message of an epoch it is published anyway.
+     */
+    GnssEpochAssembler(GnssParser *parser, uint8_t enabled, int timeout_ms = GNSS_EPOCH_TIMEOUT_MS);
+
+    /** Attach the function called for every published epoch.
+     * The record is only valid during the call.
+     * @param cb the callback.
+     */
+    void attach(Callback<void(const tGNSS_EPOCH *)> cb);
+
+    /** Change the set of messages expected per epoch.
+     * @param enabled eGNSS_EPOCH_CONTENT mask.
+     */
+    void set_enabled(uint8_t enabled);
+
+    /** Feed a message returned by getMessage.
+     * @param buf the message.
+     * @param len the length of the message.
+     * @return true if the message was part of an epoch, false otherwise.
+     */
+    bool process(char *buf, int len);
+
+    /** Publish the epochs that timed out. Call periodically when no
+     * messages are received.
+     */
+    void poll(void);
+
+    /** Number of epochs published incomplete.
+     * @return the counter.
+     */
+    uint32_t incomplete_count(void) const { return _incomplete; }
+
+private:
+    tGNSS_EPOCH *_slot(uint32_t itow);
+    void _publish(int ix, bool complete);
+
+    GnssParser *_parser;
+    Callback<void(const tGNSS_EPOCH *)> _cb;
+    uint8_t _enabled;
+    int _timeout;
+    Timer _timer;
+    tGNSS_EPOCH _slots[GNSS_EPOCH_SLOTS];
+    bool _used[GNSS_EPOCH_SLOTS];
+    int _opened[GNSS_EPOCH_SLOTS];   //!< time the slot was opened in ms
+    uint32_t _lastItow;              //!< iTOW of the last published epoch
+    bool _published;                 //!< true if _lastItow is valid
+    uint32_t _incomplete;            //!< epochs published incomplete
+};
+
+#endif
+
+// End Of File
@@ -0,0 +1,303 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file gnss_framer.cpp
+ * This file implements the framing of NMEA and UBX messages.
+ */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include "gnss_framer.h"
+
+int GnssFramer::_getMessage(Pipe<char>* pipe, char* buf, int len)
+{
+    int unkn = 0;
+    int sz = pipe->size();
+    int fr = pipe->free();
+    if (len > sz)
+        len = sz;
+    while (len > 0)
+    {
+        // NMEA protocol
+        pipe->set(unkn);
+        int nmea = _parseNmea(pipe,len);
+        if ((nmea != NOT_FOUND) && (unkn > 0))
+            return UNKNOWN | pipe->get(buf,unkn);
+        if (nmea == WAIT && fr)
+            return WAIT;
+        if (nmea > 0)
+            return NMEA | pipe->get(buf,nmea);
+        // UBX protocol
+
+        pipe->set(unkn);
+        int ubx = _parseUbx(pipe,len);
+        if ((ubx != NOT_FOUND) && (unkn > 0))
+            return UNKNOWN | pipe->get(buf,unkn);
+        if (ubx == WAIT && fr)
+            return WAIT;
+        if (ubx > 0)
+            return UBX | pipe->get(buf,ubx);
+
+        // UNKNOWN
+        unkn ++;
+        len--;
+    }
+    if (unkn > 0)
+        return UNKNOWN | pipe->get(buf,unkn);
+    return WAIT;
+}
+
+int GnssFramer::_parseNmea(Pipe<char>* pipe, int len)
+{
+    int o = 0;
+    int c = 0;
+    char ch;
+    if (++o > len)                      return WAIT;
+    if ('$' != pipe->next())            return NOT_FOUND;
+    // This needs to be extended by crc checking
+    for (;;)
+    {
+        if (++o > len)                  return WAIT;
+        ch = pipe->next();
+        if ('*' == ch)                  break; // crc delimiter
+        if (!isprint(ch))               return NOT_FOUND;
+        c ^= ch;
+    }
+    if (++o > len)                      return WAIT;
+    ch = _toHex[(c >> 4) & 0xF]; // high nibble
+    if (ch != pipe->next())             return NOT_FOUND;
+    if (++o > len)                      return WAIT;
+    ch = _toHex[(c >> 0) & 0xF]; // low nibble
+    if (ch != pipe->next())             return NOT_FOUND;
+    if (++o > len)                      return WAIT;
+    if ('\r' != pipe->next())           return NOT_FOUND;
+    if (++o > len)                      return WAIT;
+    if ('\n' != pipe->next())           return NOT_FOUND;
+    return o;
+}
+
+int GnssFramer::_parseUbx(Pipe<char>* pipe, int l)
+{
+    int o = 0;
+    if (++o > l)                return WAIT;
+    if ('\xB5' != pipe->next()) return NOT_FOUND;
+    if (++o > l)                return WAIT;
+    if ('\x62' != pipe->next()) return NOT_FOUND;
+    o += 4;
+    if (o > l)                  return WAIT;
+    int i,j,ca,cb;
+    i = (unsigned char)pipe->next();
+    ca  = i;
+    cb  = ca; // cls
+    i = (unsigned char)pipe->next();
+    ca += i;
+    cb += ca; // id
+    i = (unsigned char)pipe->next();
+    ca += i;
+    cb += ca; // len_lsb
+    j = (unsigned char)pipe->next();
+    ca += j;
+    cb += ca; // len_msb
+    j = i + (j << 8);
+    while (j--)
+    {
+        if (++o > l)            return WAIT;
+        i = (unsigned char)pipe->next();
+        ca += i;
+        cb += ca;
+    }
+    ca &= 0xFF;
+    cb &= 0xFF;
+    if (++o > l)                return WAIT;
+    if (ca != (unsigned char)pipe->next()) return NOT_FOUND;
+    if (++o > l)                return WAIT;
+    if (cb != (unsigned char)pipe->next()) return NOT_FOUND;
+    return o;
+}
+
+const char* GnssFramer::findNmeaItemPos(int ix, const char* start, const char* end)
+{
+    // Find the start
+    for (; (start < end) && (ix > 0); start ++)
+    {
+        if (*start == ',')
+            ix --;
+    }
+    // Found and check bounds
+    if ((ix == 0) && (start < end) &&
+            (*start != ',') && (*start != '*') && (*start != '\r') && (*start != '\n'))
+        return start;
+    else
+        return NULL;
+}
+
+#ifndef GNSS_FIXED_POINT
+bool GnssFramer::getNmeaItem(int ix, char* buf, int len, double& val)
+{
+    char* end = &buf[len];
+    const char* pos = findNmeaItemPos(ix, buf, end);
+    // Find the start
+    if (!pos)
+        return false;
+    val = strtod(pos, &end);
+    // Restore the last character
+    return (end > pos);
+}
+#endif
+
+// Parse a decimal number to an integer times 10^decimals, rounded at the
+// first dropped digit, without floating point
+static bool parseFixed(const char* pos, const char* end, int decimals, int64_t* val)
+{
+    bool neg = false;
+    bool point = false;
+    bool up = false;
+    int digits = 0;
+    int kept = 0;
+    int64_t v = 0;
+
+    while ((pos < end) && isspace(*pos))
+        pos++;
+    if ((pos < end) && ((*pos == '-') || (*pos == '+')))
+        neg = (*pos++ == '-');
+    for (; pos < end; pos++) {
+        if (isdigit(*pos)) {
+            if (!point || (kept < decimals)) {
+                if (v > (INT64_MAX / 100))
+                    return false;
+                v = (v * 10) + (*pos - '0');
+                if (point)
+                    kept++;
+            } else if (kept == decimals) {
+                up = (*pos >= '5');
+                kept++;
+            }
+            digits++;
+        } else if ((*pos == '.') && !point) {
+            point = true;
+        } else {
+            break;
+        }
+    }
+    if (digits == 0)
+        return false;
+    for (; kept < decimals; kept++)
+        v *= 10;
+    if (up)
+        v++;
+    *val = neg ? -v : v;
+    return true;
+}
+
+bool GnssFramer::getNmeaFixed(int ix, char* buf, int len, int32_t& val, int decimals)
+{
+    const char* end = &buf[len];
+    const char* pos = findNmeaItemPos(ix, buf, end);
+    int64_t v;
+
+    if (!pos || !parseFixed(pos, end, decimals, &v) || (v > INT32_MAX) || (v < INT32_MIN))
+        return false;
+    val = (int32_t)v;
+    return true;
+}
+
+bool GnssFramer::getNmeaItem(int ix, char* buf, int len, int& val, int base /*=10*/)
+{
+    char* end = &buf[len];
+    const char* pos = findNmeaItemPos(ix, buf, end);
+    // Find the start
+    if (!pos)
+        return false;
+    val = (int)strtol(pos, &end, base);
+    return (end > pos);
+}
+
+bool GnssFramer::getNmeaItem(int ix, char* buf, int len, char& val)
+{
+    const char* end = &buf[len];
+    const char* pos = findNmeaItemPos(ix, buf, end);
+    // Find the start
+    if (!pos)
+        return false;
+    // Skip leading spaces
+    while ((pos < end) && isspace(*pos))
+        pos++;
+    // Check bound
+    if ((pos < end) &&
+            (*pos != ',') && (*pos != '*') && (*pos != '\r') && (*pos != '\n'))
+    {
+        val = *pos;
+        return true;
+    }
+    return false;
+}
+
+#ifndef GNSS_FIXED_POINT
+bool GnssFramer::getNmeaAngle(int ix, char* buf, int len, double& val)
+{
+    char ch;
+    if (getNmeaItem(ix,buf,len,val) && getNmeaItem(ix+1,buf,len,ch) &&
+            ((ch == 'S') || (ch == 'N') || (ch == 'E') || (ch == 'W')))
+    {
+        val *= 0.01;
+        int i = (int)val;
+        val = (val - i) / 0.6 + i;
+        if (ch == 'S' || ch == 'W')
+            val = -val;
+        return true;
+    }
+    return false;
+}
+#endif
+
+bool GnssFramer::getNmeaAngle(int ix, char* buf, int len, int32_t& val)
+{
+    const char* end = &buf[len];
+    const char* pos = findNmeaItemPos(ix, buf, end);
+    int64_t v;
+    char ch;
+
+    // dddmm.mmmmmmm to 1e-7 deg
+    if (pos && parseFixed(pos, end, 7, &v) && (v >= 0) && (v <= 180000000000LL) &&
+            getNmeaItem(ix+1,buf,len,ch) &&
+            ((ch == 'S') || (ch == 'N') || (ch == 'E') || (ch == 'W')))
+    {
+        int64_t deg = v / 1000000000;
+        int64_t min = v % 1000000000;
+        val = (int32_t)((deg * 10000000) + ((min + 30) / 60));
+        if (ch == 'S' || ch == 'W')
+            val = -val;
+        return true;
+    }
+    return false;
+}
+
+uint32_t gnss_crc32(uint32_t crc, const void *data, int len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        for (int k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+const char GnssFramer::_toHex[] = { '0','1','2','3','4','5','6','7','8','9','A','B','C','D','E','F' };
+
+// End Of File
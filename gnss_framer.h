@@ -0,0 +1,229 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GNSS_FRAMER_H
+#define GNSS_FRAMER_H
+
+/**
+ * @file gnss_framer.h
+ * This file defines the framing of NMEA and UBX messages and the NMEA field
+ * parsing. It does not depend on mbed and builds on the host as well.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "pipe.h"
+
+#define UBX_FRAME_SIZE 8
+#define SYNC_CHAR_INDEX_1 0
+#define SYNC_CHAR_INDEX_2 1
+#define MSG_CLASS_INDEX 2
+#define MSG_ID_INDEX 3
+#define UBX_LENGTH_INDEX 4
+#define UBX_PAYLOAD_INDEX 6
+
+/** Read little endian fields out of a received UBX frame.
+ */
+static inline uint16_t ubx_u2(const char *p)
+{
+    return (uint16_t)((uint8_t)p[0] | ((uint8_t)p[1] << 8));
+}
+
+static inline uint32_t ubx_u4(const char *p)
+{
+    return (uint32_t)(uint8_t)p[0] | ((uint32_t)(uint8_t)p[1] << 8) |
+           ((uint32_t)(uint8_t)p[2] << 16) | ((uint32_t)(uint8_t)p[3] << 24);
+}
+
+static inline double ubx_r8(const char *p)
+{
+    double v;
+    memcpy(&v, p, sizeof(v)); // little endian target
+    return v;
+}
+
+static inline float ubx_r4(const char *p)
+{
+    float v;
+    memcpy(&v, p, sizeof(v)); // little endian target
+    return v;
+}
+
+/** Offset of the iTOW in the payload of a UBX-NAV message, shared by the
+ * capture index and the codec. Messages with a version field in front
+ * carry it at 4, all others at 0.
+ * @param cls the UBX class.
+ * @param id the UBX id.
+ * @return the offset, -1 if the message has no iTOW.
+ */
+static inline int ubx_itow_offset(unsigned char cls, unsigned char id)
+{
+    if (cls != 0x01)
+        return -1;
+    switch (id) {
+    case 0x09:  // NAV-ODO
+    case 0x13:  // NAV-HPPOSECEF
+    case 0x14:  // NAV-HPPOSLLH
+    case 0x3B:  // NAV-SVIN
+    case 0x3C:  // NAV-RELPOSNED
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+/** Convert a UBX R8 time in s to ms, with integer operations only.
+ */
+static inline uint32_t ubx_r8_ms(const char *p)
+{
+    uint64_t bits = (uint64_t)ubx_u4(p) | ((uint64_t)ubx_u4(p + 4) << 32);
+    int shift = 1075 - (int)((bits >> 52) & 0x7FF);   // the value is mantissa / 2^shift
+    uint64_t m = (bits & 0xFFFFFFFFFFFFFULL) | (1ULL << 52);
+
+    if ((bits >> 63) || (shift > 63) || (shift <= 0))
+        return 0;
+    return (uint32_t)(((m * 1000) + (1ULL << (shift - 1))) >> shift);
+}
+
+/** CRC-32 (IEEE 802.3) of the records in the files written by the library.
+ * @param crc the CRC of the preceding data, 0 to start.
+ * @param data the data.
+ * @param len the size of the data.
+ * @return the CRC including the data.
+ */
+uint32_t gnss_crc32(uint32_t crc, const void *data, int len);
+
+/** NMEA and UBX framing, without any hardware.
+ */
+class GnssFramer
+{
+public:
+    enum {
+        // getLine Responses
+        WAIT      = -1, //!< wait for more incoming data (the start of a message was found, or no data available)
+        NOT_FOUND =  0, //!< a parser concluded the the current offset of the pipe doe not contain a valid message
+
+#define LENGTH(x)   (x & 0x00FFFF)  //!< extract/mask the length
+#define PROTOCOL(x) (x & 0xFF0000)  //!< extract/mask the type
+
+        UNKNOWN   = 0x000000,       //!< message type is unknown
+        UBX       = 0x100000,       //!< message if of protocol NMEA
+        NMEA      = 0x200000        //!< message if of protocol UBX
+    };
+
+    /** get the first character of a NMEA field.
+     * @param ix the index of the field to find.
+     * @param start the start of the buffer.
+     * @param end the end of the buffer.
+     * @return the pointer to the first character of the field.
+     */
+    static const char* findNmeaItemPos(int ix, const char* start, const char* end);
+
+#ifndef GNSS_FIXED_POINT
+    /** Extract a double value from a buffer containing a NMEA message.
+     * @param ix the index of the field to extract.
+     * @param buf the NMEA message.
+     * @param len the size of the NMEA message.
+     * @param val the extracted value.
+     * @return true if successful, false otherwise.
+     */
+    static bool getNmeaItem(int ix, char* buf, int len, double& val);
+#endif
+
+    /** Extract a decimal value as a scaled integer from a buffer containing a NMEA message.
+     * @param ix the index of the field to extract.
+     * @param buf the NMEA message.
+     * @param len the size of the NMEA message.
+     * @param val the extracted value times 10^decimals, rounded.
+     * @param decimals the number of decimals to keep, e.g. 3 for an altitude in mm.
+     * @return true if successful, false otherwise.
+     */
+    static bool getNmeaFixed(int ix, char* buf, int len, int32_t& val, int decimals);
+
+    /** Extract a interger value from a buffer containing a NMEA message.
+     * @param ix the index of the field to extract.
+     * @param buf the NMEA message.
+     * @param len the size of the NMEA message.
+     * @param val the extracted value.
+     * @param base the numeric base to be used (e.g. 8, 10 or 16).
+     * @return true if successful, false otherwise.
+     */
+    static bool getNmeaItem(int ix, char* buf, int len, int& val, int base/*=10*/);
+
+    /** Extract a char value from a buffer containing a NMEA message.
+     * @param ix the index of the field to extract.
+     * @param buf the NMEA message.
+     * @param len the size of the NMEA message.
+     * @param val the extracted value.
+     * @return true if successful, false otherwise.
+     */
+    static bool getNmeaItem(int ix, char* buf, int len, char& val);
+
+#ifndef GNSS_FIXED_POINT
+    /** Extract a latitude/longitude value from a buffer containing a NMEA message.
+     * @param ix the index of the field to extract (will extract ix and ix + 1),
+     * @param buf the NMEA message,
+     * @param len the size of the NMEA message,
+     * @param val the extracted latitude or longitude,
+     * @return true if successful, false otherwise.
+     */
+    static bool getNmeaAngle(int ix, char* buf, int len, double& val);
+#endif
+
+    /** Extract a latitude/longitude value from a buffer containing a NMEA message.
+     * @param ix the index of the field to extract (will extract ix and ix + 1),
+     * @param buf the NMEA message,
+     * @param len the size of the NMEA message,
+     * @param val the extracted latitude or longitude, scaling 1e-7 deg as in tUBX_NAV_PVT,
+     * @return true if successful, false otherwise.
+     */
+    static bool getNmeaAngle(int ix, char* buf, int len, int32_t& val);
+
+protected:
+    /** Get a line from the physical interface.
+     * @param pipe the receiveing pipe to parse messages .
+     * @param buf the buffer to store it.
+     * @param len size of the buffer.
+     * @return type and length if something was found,
+     *         WAIT if not enough data is available,
+     *         NOT_FOUND if nothing was found.
+     */
+    static int _getMessage(Pipe<char>* pipe, char* buf, int len);
+
+    /** Check if the current offset of the pipe contains a NMEA message.
+     * @param pipe the receiveing pipe to parse messages.
+     * @param len numer of bytes to parse at maximum.
+     * @return length if something was found (including the NMEA frame),
+     *         WAIT if not enough data is available,
+     *         NOT_FOUND if nothing was found.
+     */
+    static int _parseNmea(Pipe<char>* pipe, int len);
+
+    /** Check if the current offset of the pipe contains a UBX message.
+     * @param pipe the receiveing pipe to parse messages.
+     * @param len numer of bytes to parse at maximum.
+     * @return length if something was found (including the UBX frame),
+     *         WAIT if not enough data is available,
+     *         NOT_FOUND if nothing was found.
+     */
+    static int _parseUbx(Pipe<char>* pipe, int len);
+
+    static const char _toHex[16]; //!< num to hex conversion
+};
+
+#endif
+
+// End Of File
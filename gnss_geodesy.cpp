@@ -0,0 +1,233 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file gnss_geodesy.cpp
+ * This file implements the batch geodesy kernels.
+ */
+
+#include "gnss_geodesy.h"
+#include <math.h>
+
+#ifndef GNSS_FIXED_POINT
+
+#define WGS84_A 6378137.0
+#define WGS84_F (1.0 / 298.257223563)
+#define WGS84_B (WGS84_A * (1.0 - WGS84_F))
+#define WGS84_E2 (WGS84_F * (2.0 - WGS84_F))                // first eccentricity squared
+#define WGS84_EP2 (WGS84_E2 / (1.0 - WGS84_E2))             // second eccentricity squared
+
+#define PI 3.14159265358979323846
+#define RAD_PER_UNIT (PI / 180e7)                           // 1e-7 deg to rad
+#define UNIT_PER_RAD (180e7 / PI)
+
+// pi/2 in two parts, the first one with 33 bits so that q * PIO2_HI is exact
+#define PIO2_HI 1.57079632673412561417e+00
+#define PIO2_LO 6.07710050650619224932e-11
+
+// Round to the nearest integer without a library call
+static inline int32_t round_int(double v)
+{
+    return (int32_t)(v + copysign(0.5, v));
+}
+
+/* Sine and cosine. The angle is reduced by multiples of pi/2 to |r| <= pi/4,
+ * where the Taylor series to r^17 and r^18 are exact to double precision.
+ * The quadrant selects and negates the results without branches.
+ */
+static inline void sin_cos(double a, double *s, double *c)
+{
+    int32_t q = round_int(a * (2.0 / PI));
+    double qd = q;
+    double r = (a - qd * PIO2_HI) - qd * PIO2_LO;
+    double r2 = r * r;
+
+    double sp = r + r * r2 * (-1.0 / 6 + r2 * (1.0 / 120 + r2 * (-1.0 / 5040 + r2 * (1.0 / 362880 +
+                r2 * (-1.0 / 39916800 + r2 * (1.0 / 6227020800.0 + r2 * (-1.0 / 1307674368000.0 +
+                r2 * (1.0 / 355687428096000.0))))))));
+    double cp = 1.0 + r2 * (-1.0 / 2 + r2 * (1.0 / 24 + r2 * (-1.0 / 720 + r2 * (1.0 / 40320 +
+                r2 * (-1.0 / 3628800 + r2 * (1.0 / 479001600 + r2 * (-1.0 / 87178291200.0 +
+                r2 * (1.0 / 20922789888000.0 + r2 * (-1.0 / 6402373705728000.0)))))))));
+
+    // Selected by weights of 0 and 1 and signs from the quadrant bits, a
+    // select of computed values would become a branch
+    double w = (double)(q & 1);
+    *s = (sp * (1.0 - w) + cp * w) * (1.0 - (double)(q & 2));
+    *c = (cp * (1.0 - w) + sp * w) * (1.0 - (double)((q + 1) & 2));
+}
+
+/* Arctangent of y/x. The ratio of the smaller to the larger magnitude is in
+ * [0, 1] and halved twice with atan(t) = 2 atan(t / (1 + sqrt(1 + t^2))) to
+ * [0, 0.2], where the Taylor series to t^21 is exact to double precision.
+ */
+static inline double atan_2(double y, double x)
+{
+    double ax = fabs(x);
+    double ay = fabs(y);
+    double mx = (ay > ax) ? ay : ax;
+    double mn = (ay > ax) ? ax : ay;
+    double t = mn / (mx + ((mx == 0) ? 1.0 : 0.0));
+
+    t = t / (1.0 + sqrt(1.0 + t * t));
+    t = t / (1.0 + sqrt(1.0 + t * t));
+    double t2 = t * t;
+    double a = 4.0 * (t + t * t2 * (-1.0 / 3 + t2 * (1.0 / 5 + t2 * (-1.0 / 7 + t2 * (1.0 / 9 +
+               t2 * (-1.0 / 11 + t2 * (1.0 / 13 + t2 * (-1.0 / 15 + t2 * (1.0 / 17 +
+               t2 * (-1.0 / 19 + t2 * (1.0 / 21)))))))))));
+
+    // Again only constants are selected
+    a = ((ay > ax) ? PI / 2 : 0.0) + a * ((ay > ax) ? -1.0 : 1.0);
+    a = ((x < 0) ? PI : 0.0) + a * ((x < 0) ? -1.0 : 1.0);
+    return copysign(a, y);
+}
+
+// Earth centered, earth fixed coordinates of one position
+static inline void ecef(double lat, double lon, double h, double *x, double *y, double *z)
+{
+    double sLat, cLat, sLon, cLon;
+
+    sin_cos(lat * RAD_PER_UNIT, &sLat, &cLat);
+    sin_cos(lon * RAD_PER_UNIT, &sLon, &cLon);
+    double n = WGS84_A / sqrt(1.0 - WGS84_E2 * sLat * sLat);
+    double r = (n + h) * cLat;
+    *x = r * cLon;
+    *y = r * sLon;
+    *z = (n * (1.0 - WGS84_E2) + h) * sLat;
+}
+
+void GnssGeodesy::llh_to_ecef(const int32_t *GNSS_RESTRICT lat, const int32_t *GNSS_RESTRICT lon,
+                              const int32_t *GNSS_RESTRICT height, int n,
+                              double *GNSS_RESTRICT x, double *GNSS_RESTRICT y, double *GNSS_RESTRICT z)
+{
+    for (int i = 0; i < n; i++)
+        ecef(lat[i], lon[i], height[i] * 1e-3, &x[i], &y[i], &z[i]);
+}
+
+/* Bowring's method with one iteration: the parametric latitude of the
+ * point on the ellipsoid gives the geodetic latitude, the height is the
+ * distance to the ellipsoid along its normal.
+ */
+void GnssGeodesy::ecef_to_llh(const double *GNSS_RESTRICT x, const double *GNSS_RESTRICT y,
+                              const double *GNSS_RESTRICT z, int n,
+                              int32_t *GNSS_RESTRICT lat, int32_t *GNSS_RESTRICT lon, int32_t *GNSS_RESTRICT height)
+{
+    for (int i = 0; i < n; i++) {
+        double p = sqrt(x[i] * x[i] + y[i] * y[i]);
+        double za = z[i] * WGS84_A;
+        double pb = p * WGS84_B;
+        double rt = 1.0 / sqrt(za * za + pb * pb);
+        double s = za * rt;
+        double c = pb * rt;
+        double num = z[i] + WGS84_EP2 * WGS84_B * s * s * s;
+        double den = p - WGS84_E2 * WGS84_A * c * c * c;
+        double rl = 1.0 / sqrt(num * num + den * den);
+        double sLat = num * rl;
+        double cLat = den * rl;
+        double h = p * cLat + z[i] * sLat - WGS84_A * sqrt(1.0 - WGS84_E2 * sLat * sLat);
+
+        lat[i] = round_int(atan_2(num, den) * UNIT_PER_RAD);
+        lon[i] = round_int(atan_2(y[i], x[i]) * UNIT_PER_RAD);
+        height[i] = round_int(h * 1e3);
+    }
+}
+
+void GnssGeodesy::llh_to_enu(const int32_t *GNSS_RESTRICT lat, const int32_t *GNSS_RESTRICT lon,
+                             const int32_t *GNSS_RESTRICT height, int n,
+                             int32_t refLat, int32_t refLon, int32_t refHeight,
+                             double *GNSS_RESTRICT e, double *GNSS_RESTRICT north, double *GNSS_RESTRICT u)
+{
+    double rx, ry, rz;
+    double sLat, cLat, sLon, cLon;
+
+    ecef(refLat, refLon, refHeight * 1e-3, &rx, &ry, &rz);
+    sin_cos(refLat * RAD_PER_UNIT, &sLat, &cLat);
+    sin_cos(refLon * RAD_PER_UNIT, &sLon, &cLon);
+    for (int i = 0; i < n; i++) {
+        double x, y, z;
+        ecef(lat[i], lon[i], height[i] * 1e-3, &x, &y, &z);
+        x -= rx;
+        y -= ry;
+        z -= rz;
+        e[i] = -sLon * x + cLon * y;
+        north[i] = -sLat * cLon * x - sLat * sLon * y + cLat * z;
+        u[i] = cLat * cLon * x + cLat * sLon * y + sLat * z;
+    }
+}
+
+/* The differences are taken in integers, so short distances keep the
+ * full resolution of the positions.
+ */
+void GnssGeodesy::distance(const int32_t *lat1, const int32_t *lon1,
+                           const int32_t *lat2, const int32_t *lon2, int n, double *GNSS_RESTRICT m)
+{
+    for (int i = 0; i < n; i++) {
+        double s1, c1, s2, c2, sdLat, cdLat, sdLon, cdLon;
+        sin_cos(lat1[i] * RAD_PER_UNIT, &s1, &c1);
+        sin_cos(lat2[i] * RAD_PER_UNIT, &s2, &c2);
+        sin_cos(((double)lat2[i] - lat1[i]) * (RAD_PER_UNIT / 2), &sdLat, &cdLat);
+        sin_cos(((double)lon2[i] - lon1[i]) * (RAD_PER_UNIT / 2), &sdLon, &cdLon);
+        double h = sdLat * sdLat + c1 * c2 * sdLon * sdLon;
+        m[i] = (2.0 * GNSS_GEODESY_EARTH_RADIUS) * atan_2(sqrt(h), sqrt(fabs(1.0 - h)));
+    }
+}
+
+void GnssGeodesy::bearing(const int32_t *lat1, const int32_t *lon1,
+                          const int32_t *lat2, const int32_t *lon2, int n, double *GNSS_RESTRICT deg)
+{
+    for (int i = 0; i < n; i++) {
+        double s1, c1, s2, c2, sdLon, cdLon;
+        sin_cos(lat1[i] * RAD_PER_UNIT, &s1, &c1);
+        sin_cos(lat2[i] * RAD_PER_UNIT, &s2, &c2);
+        sin_cos(((double)lon2[i] - lon1[i]) * RAD_PER_UNIT, &sdLon, &cdLon);
+        double b = atan_2(sdLon * c2, c1 * s2 - s1 * c2 * cdLon) * (180.0 / PI);
+        deg[i] = b + ((b < 0) ? 360.0 : 0.0);
+    }
+}
+
+double GnssGeodesy::odometer(const int32_t *lat, const int32_t *lon, int n, double *cumulative)
+{
+    double step[256];
+    double total = 0.0;
+
+    if (n <= 0)
+        return 0.0;
+    if (cumulative)
+        cumulative[0] = 0.0;
+    for (int i = 0; i < n - 1; i += 256) {
+        int count = (n - 1 - i < 256) ? n - 1 - i : 256;
+        distance(lat + i, lon + i, lat + i + 1, lon + i + 1, count, step);
+        for (int j = 0; j < count; j++) {
+            total += step[j];
+            if (cumulative)
+                cumulative[i + j + 1] = total;
+        }
+    }
+    return total;
+}
+
+void GnssGeodesy::sincos(double a, double *s, double *c)
+{
+    sin_cos(a, s, c);
+}
+
+double GnssGeodesy::atan2(double y, double x)
+{
+    return atan_2(y, x);
+}
+
+#endif
+
+// End Of File
@@ -0,0 +1,401 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file gnss_geofence.cpp
+ * This file implements the geofence engine.
+ *
+ * Positions are compared in local units of 1e-7 deg of latitude (about
+ * 11 mm), the longitude difference is scaled with the cosine of the
+ * latitude of the fence.
+ */
+
+#include "gnss_geofence.h"
+
+GnssGeofence::GnssGeofence(int maxFences, int maxVertices, uint32_t hysteresis_m) :
+    _maxFences(maxFences), _maxVertices(maxVertices), _count(0), _vertices(0), _activeCount(0),
+    _margin(GNSS_M_TO_UNITS(hysteresis_m)), _dirty(true), _gridLat(0), _gridLon(0), _cellLat(1), _cellLon(1),
+    _rows(0), _cols(0), _start(NULL), _items(NULL), _startSize(0), _itemsSize(0), _stamp(0), _tested(0)
+{
+    _fences = new tFENCE[maxFences];
+    _vLat = new int32_t[maxVertices];
+    _vLon = new int32_t[maxVertices];
+    _active = new uint16_t[maxFences];
+}
+
+GnssGeofence::~GnssGeofence(void)
+{
+    delete[] _fences;
+    delete[] _vLat;
+    delete[] _vLon;
+    delete[] _active;
+    delete[] _start;
+    delete[] _items;
+}
+
+void GnssGeofence::attach(Callback<void(const tGNSS_GEOFENCE_EVENT *)> cb)
+{
+    _cb = cb;
+}
+
+void GnssGeofence::clear(void)
+{
+    _count = 0;
+    _vertices = 0;
+    _activeCount = 0;
+    _dirty = true;
+}
+
+int GnssGeofence::add_circle(uint16_t id, int32_t lat, int32_t lon, uint32_t radius_m, uint32_t dwell_s)
+{
+    tFENCE *f = &_fences[_count];
+    int64_t r = GNSS_M_TO_UNITS(radius_m);
+    int64_t r1 = r - _margin;
+    int64_t r2 = r + _margin;
+
+    if ((_count >= _maxFences) || (r2 >= GNSS_FAR))
+        return 0;
+    f->polygon = 0;
+    f->lat = lat;
+    f->lon = lon;
+    f->cosQ = gnss_cos_q14(lat);
+    if (f->cosQ < 16)
+        f->cosQ = 16;
+    f->inner2 = (r1 > 0) ? r1 * r1 : -1;
+    f->outer2 = r2 * r2;
+
+    int64_t dLon = (r << GNSS_COS_SHIFT) / f->cosQ;
+    f->minLat = (lat - r < -900000000) ? -900000000 : (int32_t)(lat - r);
+    f->maxLat = (lat + r > 900000000) ? 900000000 : (int32_t)(lat + r);
+    f->minLon = (lon - dLon < -1800000000) ? -1800000000 : (int32_t)(lon - dLon);
+    f->maxLon = (lon + dLon > 1800000000) ? 1800000000 : (int32_t)(lon + dLon);
+    f->id = id;
+    return _add(f, dwell_s);
+}
+
+int GnssGeofence::add_polygon(uint16_t id, const int32_t *lat, const int32_t *lon, int count, uint32_t dwell_s)
+{
+    tFENCE *f = &_fences[_count];
+
+    if ((_count >= _maxFences) || (count < 3) || (_vertices + count > _maxVertices))
+        return 0;
+    f->polygon = 1;
+    f->first = _vertices;
+    f->count = count;
+    f->minLat = f->maxLat = lat[0];
+    f->minLon = f->maxLon = lon[0];
+    for (int i = 0; i < count; i++) {
+        _vLat[_vertices + i] = lat[i];
+        _vLon[_vertices + i] = lon[i];
+        if (lat[i] < f->minLat) f->minLat = lat[i];
+        if (lat[i] > f->maxLat) f->maxLat = lat[i];
+        if (lon[i] < f->minLon) f->minLon = lon[i];
+        if (lon[i] > f->maxLon) f->maxLon = lon[i];
+    }
+    f->lat = f->minLat + (f->maxLat - f->minLat) / 2;
+    f->lon = f->minLon + (f->maxLon - f->minLon) / 2;
+    f->cosQ = gnss_cos_q14(f->lat);
+    if (f->cosQ < 16)
+        f->cosQ = 16;
+    _vertices += count;
+    f->id = id;
+    return _add(f, dwell_s);
+}
+
+int GnssGeofence::_add(tFENCE *f, uint32_t dwell_s)
+{
+    f->inside = 0;
+    f->dwelled = 0;
+    f->dwell_ms = dwell_s * 1000;
+    f->entered = 0;
+    f->stamp = 0;
+    _count++;
+    _dirty = true;
+    return 1;
+}
+
+void GnssGeofence::_build(void)
+{
+    int64_t minLat = 0, maxLat = 0, minLon = 0, maxLon = 0;
+    int total = 0;
+    int maxItems;
+
+    _dirty = false;
+    _rows = 0;
+    _cols = 0;
+    if (_count == 0)
+        return;
+
+    minLat = _fences[0].minLat;
+    maxLat = _fences[0].maxLat;
+    minLon = _fences[0].minLon;
+    maxLon = _fences[0].maxLon;
+    for (int i = 1; i < _count; i++) {
+        const tFENCE *f = &_fences[i];
+        if (f->minLat < minLat) minLat = f->minLat;
+        if (f->maxLat > maxLat) maxLat = f->maxLat;
+        if (f->minLon < minLon) minLon = f->minLon;
+        if (f->maxLon > maxLon) maxLon = f->maxLon;
+    }
+
+    // Cells of at least GNSS_GEOFENCE_MIN_CELL, at most GNSS_GEOFENCE_GRID per axis
+    _rows = (int)((maxLat - minLat) / GNSS_GEOFENCE_MIN_CELL) + 1;
+    _cols = (int)((maxLon - minLon) / GNSS_GEOFENCE_MIN_CELL) + 1;
+    if (_rows > GNSS_GEOFENCE_GRID)
+        _rows = GNSS_GEOFENCE_GRID;
+    if (_cols > GNSS_GEOFENCE_GRID)
+        _cols = GNSS_GEOFENCE_GRID;
+    _gridLat = minLat;
+    _gridLon = minLon;
+
+    // Halve the grid while the fences cover too many cells, a fence covers
+    // at least one cell so the limit grows with the number of fences
+    maxItems = GNSS_GEOFENCE_MAX_ITEMS + GNSS_GEOFENCE_ITEMS_PER_FENCE * _count;
+    for (;;) {
+        int r0, r1, c0, c1;
+
+        _cellLat = (maxLat - minLat) / _rows + 1;
+        _cellLon = (maxLon - minLon) / _cols + 1;
+        total = 0;
+        for (int i = 0; i < _count; i++) {
+            _span(&_fences[i], &r0, &r1, &c0, &c1);
+            total += (r1 - r0 + 1) * (c1 - c0 + 1);
+        }
+        if ((total <= maxItems) || ((_rows == 1) && (_cols == 1)))
+            break;
+        _rows = (_rows + 1) / 2;
+        _cols = (_cols + 1) / 2;
+    }
+    if (_startSize < _rows * _cols + 1) {
+        delete[] _start;
+        _startSize = _rows * _cols + 1;
+        _start = new int[_startSize];
+    }
+    if (_itemsSize < total) {
+        delete[] _items;
+        _itemsSize = total;
+        _items = new uint16_t[_itemsSize];
+    }
+
+    // Count the fences per cell, then place them
+    memset(_start, 0, (_rows * _cols + 1) * sizeof(int));
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < _count; i++) {
+            int r0, r1, c0, c1;
+            _span(&_fences[i], &r0, &r1, &c0, &c1);
+            for (int r = r0; r <= r1; r++) {
+                for (int c = c0; c <= c1; c++) {
+                    if (pass == 0)
+                        _start[r * _cols + c + 1]++;
+                    else
+                        _items[_start[r * _cols + c]++] = i;
+                }
+            }
+        }
+        if (pass == 0) {
+            for (int c = 0; c < _rows * _cols; c++)
+                _start[c + 1] += _start[c];
+        } else {
+            // The fill moved every start to the next cell
+            for (int c = _rows * _cols; c > 0; c--)
+                _start[c] = _start[c - 1];
+            _start[0] = 0;
+        }
+    }
+}
+
+// Rows and columns of the cells covered by the bounding box of a fence
+void GnssGeofence::_span(const tFENCE *f, int *r0, int *r1, int *c0, int *c1) const
+{
+    *r0 = (int)((f->minLat - _gridLat) / _cellLat);
+    *r1 = (int)((f->maxLat - _gridLat) / _cellLat);
+    *c0 = (int)((f->minLon - _gridLon) / _cellLon);
+    *c1 = (int)((f->maxLon - _gridLon) / _cellLon);
+}
+
+int GnssGeofence::_cell(int32_t lat, int32_t lon) const
+{
+    int64_t r = (lat - _gridLat);
+    int64_t c = (lon - _gridLon);
+
+    if ((r < 0) || (c < 0))
+        return -1;
+    r /= _cellLat;
+    c /= _cellLon;
+    if ((r >= _rows) || (c >= _cols))
+        return -1;
+    return (int)(r * _cols + c);
+}
+
+int GnssGeofence::update(const tUBX_NAV_PVT *pvt)
+{
+    if (((pvt->fixType != 0x03) && (pvt->fixType != 0x04)) || !(pvt->flag1 & 0x01))
+        return 0;
+    return update(pvt->itow, pvt->lat, pvt->lon);
+}
+
+int GnssGeofence::update(uint32_t itow, int32_t lat, int32_t lon)
+{
+    int events = 0;
+    int cell;
+
+    if (_dirty)
+        _build();
+    _stamp++;
+    _tested = 0;
+
+    // Fences near the position
+    cell = _cell(lat, lon);
+    if (cell >= 0) {
+        for (int i = _start[cell]; i < _start[cell + 1]; i++)
+            events += _test(&_fences[_items[i]], itow, lat, lon);
+    }
+    // Fences the position was inside of, a removal moves the last one down
+    for (int i = _activeCount - 1; i >= 0; i--) {
+        if (i >= _activeCount)
+            continue;
+        tFENCE *f = &_fences[_active[i]];
+        if (f->stamp != _stamp)
+            events += _test(f, itow, lat, lon);
+    }
+
+    return events;
+}
+
+bool GnssGeofence::inside(uint16_t id) const
+{
+    for (int i = 0; i < _activeCount; i++) {
+        if (_fences[_active[i]].id == id)
+            return true;
+    }
+    return false;
+}
+
+int GnssGeofence::_test(tFENCE *f, uint32_t itow, int32_t lat, int32_t lon)
+{
+    int c;
+
+    f->stamp = _stamp;
+    _tested++;
+    c = _classify(f, lat, lon);
+
+    if (!f->inside && (c > 0)) {
+        f->inside = 1;
+        f->dwelled = 0;
+        f->entered = itow;
+        _active[_activeCount++] = f - _fences;
+        _event(f, GNSS_GEOFENCE_ENTER, itow, lat, lon);
+        return 1;
+    }
+    if (f->inside && (c < 0)) {
+        f->inside = 0;
+        for (int i = 0; i < _activeCount; i++) {
+            if (_active[i] == f - _fences) {
+                _active[i] = _active[--_activeCount];
+                break;
+            }
+        }
+        _event(f, GNSS_GEOFENCE_EXIT, itow, lat, lon);
+        return 1;
+    }
+    if (f->inside && f->dwell_ms && !f->dwelled) {
+        uint32_t ms = (itow >= f->entered) ? itow - f->entered : itow + GNSS_GEOFENCE_WEEK_MS - f->entered;
+        if (ms >= f->dwell_ms) {
+            f->dwelled = 1;
+            _event(f, GNSS_GEOFENCE_DWELL, itow, lat, lon);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 1: inside by more than the hysteresis, -1: outside by more, 0: near the boundary
+int GnssGeofence::_classify(const tFENCE *f, int32_t lat, int32_t lon) const
+{
+    int64_t m = _margin;
+    int64_t dy = (int64_t)lat - f->lat;
+    int64_t dx = (((int64_t)lon - f->lon) * f->cosQ) >> GNSS_COS_SHIFT;
+
+    if ((dx > GNSS_FAR) || (dx < -GNSS_FAR) || (dy > GNSS_FAR) || (dy < -GNSS_FAR))
+        return -1;
+
+    if (!f->polygon) {
+        int64_t d2 = dx * dx + dy * dy;
+        if (d2 <= f->inner2)
+            return 1;
+        return (d2 >= f->outer2) ? -1 : 0;
+    }
+
+    // Outside the bounding box plus the hysteresis
+    if ((lat < f->minLat - m) || (lat > f->maxLat + m) ||
+        (lon < f->minLon - ((m << GNSS_COS_SHIFT) / f->cosQ)) || (lon > f->maxLon + ((m << GNSS_COS_SHIFT) / f->cosQ)))
+        return -1;
+
+    // Vertices relative to the position, crossings of a ray to the east
+    bool in = false;
+    bool near = false;
+    const int32_t *vLat = &_vLat[f->first];
+    const int32_t *vLon = &_vLon[f->first];
+    int64_t ax = (((int64_t)vLon[f->count - 1] - lon) * f->cosQ) >> GNSS_COS_SHIFT;
+    int64_t ay = (int64_t)vLat[f->count - 1] - lat;
+    for (int i = 0; i < f->count; i++) {
+        int64_t bx = (((int64_t)vLon[i] - lon) * f->cosQ) >> GNSS_COS_SHIFT;
+        int64_t by = (int64_t)vLat[i] - lat;
+
+        if ((ay > 0) != (by > 0)) {
+            int64_t cross = ax * by - ay * bx;
+            if ((cross > 0) == (by > ay))
+                in = !in;
+        }
+        if (!near && !(((ax > m) && (bx > m)) || ((ax < -m) && (bx < -m)) ||
+                       ((ay > m) && (by > m)) || ((ay < -m) && (by < -m)))) {
+            int64_t ex = bx - ax;
+            int64_t ey = by - ay;
+            int64_t len2 = ex * ex + ey * ey;
+            int64_t t = -(ax * ex + ay * ey);
+            if ((ax * ax + ay * ay <= m * m) || (bx * bx + by * by <= m * m)) {
+                near = true;
+            } else if ((t > 0) && (t < len2)) {
+                int64_t cross = ax * ey - ay * ex;
+                if (cross < 0)
+                    cross = -cross;
+                near = (cross <= m * (int64_t)gnss_isqrt(len2));
+            }
+        }
+        ax = bx;
+        ay = by;
+    }
+
+    if (near)
+        return 0;
+    return in ? 1 : -1;
+}
+
+void GnssGeofence::_event(const tFENCE *f, uint8_t event, uint32_t itow, int32_t lat, int32_t lon)
+{
+    tGNSS_GEOFENCE_EVENT e;
+
+    if (!_cb)
+        return;
+    e.id = f->id;
+    e.event = event;
+    e.itow = itow;
+    e.lat = lat;
+    e.lon = lon;
+    _cb(&e);
+}
+
+// End Of File
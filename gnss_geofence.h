@@ -0,0 +1,184 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GNSS_GEOFENCE_H
+#define GNSS_GEOFENCE_H
+
+/**
+ * @file gnss_geofence.h
+ * This file defines the test of positions against circular and polygonal
+ * geofences. The fences are indexed in a grid of up to GNSS_GEOFENCE_GRID
+ * x GNSS_GEOFENCE_GRID cells over their bounding box, a fix is only tested
+ * against the fences of its cell and the fences it is inside of. The grid
+ * is sized to the bounding box and made coarser while the fences would be
+ * listed in more than GNSS_GEOFENCE_MAX_ITEMS cells plus
+ * GNSS_GEOFENCE_ITEMS_PER_FENCE cells per fence.
+ */
+
+#include "gnss.h"
+
+#ifndef GNSS_GEOFENCE_GRID
+#define GNSS_GEOFENCE_GRID 64               // cells per axis
+#endif
+#ifndef GNSS_GEOFENCE_MAX_ITEMS
+#define GNSS_GEOFENCE_MAX_ITEMS 1024        // fence entries of all cells, unless one cell
+#endif
+#ifndef GNSS_GEOFENCE_ITEMS_PER_FENCE
+#define GNSS_GEOFENCE_ITEMS_PER_FENCE 4     // fence entries added per fence
+#endif
+#define GNSS_GEOFENCE_MIN_CELL 10000        // 1e-7 deg, about 110 m
+#define GNSS_GEOFENCE_HYSTERESIS_M 10       // default distance to the boundary for a change
+#define GNSS_GEOFENCE_WEEK_MS 604800000
+
+/** Geofence events
+*/
+enum eGNSS_GEOFENCE_EVENT {
+    GNSS_GEOFENCE_ENTER,
+    GNSS_GEOFENCE_EXIT,
+    GNSS_GEOFENCE_DWELL      // inside for the dwell time of the fence
+};
+
+typedef struct GNSS_GEOFENCE_EVENT {
+    uint16_t id;             // id given when the fence was added
+    uint8_t event;           // eGNSS_GEOFENCE_EVENT
+    uint32_t itow;           // time of the fix
+    int32_t lat;             // scaling 1e-7
+    int32_t lon;             // scaling 1e-7
+
+} tGNSS_GEOFENCE_EVENT;
+
+/** Geofence engine.
+ * Add the fences, then feed every fix with update(). A fence is entered
+ * when the fix is inside by more than the hysteresis distance and left
+ * when it is outside by more than that distance. Distances use a local
+ * flat earth, fences should be smaller than about 10 degrees.
+ */
+class GnssGeofence
+{
+public:
+    /** Constructor.
+     * @param maxFences maximum number of fences, up to 65535.
+     * @param maxVertices maximum number of polygon vertices of all fences.
+     * @param hysteresis_m distance to the boundary required for a change.
+     */
+    GnssGeofence(int maxFences, int maxVertices, uint32_t hysteresis_m = GNSS_GEOFENCE_HYSTERESIS_M);
+
+    ~GnssGeofence(void);
+
+    /** Attach the function called for every event.
+     * @param cb the callback.
+     */
+    void attach(Callback<void(const tGNSS_GEOFENCE_EVENT *)> cb);
+
+    /** Add a circular fence.
+     * @param id the id reported with the events.
+     * @param lat latitude of the center, scaling 1e-7 deg.
+     * @param lon longitude of the center, scaling 1e-7 deg.
+     * @param radius_m the radius (m).
+     * @param dwell_s time inside before GNSS_GEOFENCE_DWELL, 0: no dwell event.
+     * @return 1 if successful, 0 if there is no room.
+     */
+    int add_circle(uint16_t id, int32_t lat, int32_t lon, uint32_t radius_m, uint32_t dwell_s = 0);
+
+    /** Add a polygonal fence.
+     * @param id the id reported with the events.
+     * @param lat latitudes of the vertices, scaling 1e-7 deg.
+     * @param lon longitudes of the vertices, scaling 1e-7 deg.
+     * @param count number of vertices, at least 3.
+     * @param dwell_s time inside before GNSS_GEOFENCE_DWELL, 0: no dwell event.
+     * @return 1 if successful, 0 if there is no room.
+     */
+    int add_polygon(uint16_t id, const int32_t *lat, const int32_t *lon, int count, uint32_t dwell_s = 0);
+
+    /** Remove all fences.
+     */
+    void clear(void);
+
+    /** Test a navigation solution, invalid fixes are ignored.
+     * @param pvt the decoded UBX-NAV-PVT.
+     * @return number of events.
+     */
+    int update(const tUBX_NAV_PVT *pvt);
+
+    /** Test a position.
+     * @param itow GPS time of week (ms).
+     * @param lat latitude, scaling 1e-7 deg.
+     * @param lon longitude, scaling 1e-7 deg.
+     * @return number of events.
+     */
+    int update(uint32_t itow, int32_t lat, int32_t lon);
+
+    /** Check if the last fixes are inside a fence.
+     * @param id the id of the fence.
+     * @return true if inside.
+     */
+    bool inside(uint16_t id) const;
+
+    /** Number of fences tested by the last update, for profiling.
+     * @return the counter.
+     */
+    int tested(void) const { return _tested; }
+
+private:
+    typedef struct {
+        uint16_t id;
+        uint8_t polygon;
+        uint8_t inside;
+        uint8_t dwelled;
+        int32_t lat, lon;           //!< center of a circle
+        int64_t inner2, outer2;     //!< squared radius less and plus the hysteresis, local units
+        int32_t cosQ;               //!< cos(lat) * 2^14 of the longitude scale
+        int first, count;           //!< vertices of a polygon
+        int32_t minLat, maxLat, minLon, maxLon;
+        uint32_t dwell_ms;
+        uint32_t entered;           //!< iTOW of the enter event
+        uint32_t stamp;             //!< last update that tested the fence
+    } tFENCE;
+
+    int _add(tFENCE *f, uint32_t dwell_s);
+    void _build(void);
+    void _span(const tFENCE *f, int *r0, int *r1, int *c0, int *c1) const;
+    int _cell(int32_t lat, int32_t lon) const;
+    int _test(tFENCE *f, uint32_t itow, int32_t lat, int32_t lon);
+    int _classify(const tFENCE *f, int32_t lat, int32_t lon) const;
+    void _event(const tFENCE *f, uint8_t event, uint32_t itow, int32_t lat, int32_t lon);
+
+    Callback<void(const tGNSS_GEOFENCE_EVENT *)> _cb;
+    tFENCE *_fences;
+    int32_t *_vLat, *_vLon;
+    uint16_t *_active;              //!< fences the position is inside of
+    int _maxFences, _maxVertices;
+    int _count, _vertices, _activeCount;
+    int64_t _margin;                //!< hysteresis in local units
+    bool _dirty;                    //!< the grid needs to be rebuilt
+
+    // Grid, the fences of cell i are _items[_start[i] .. _start[i + 1] - 1]
+    int64_t _gridLat, _gridLon;     //!< south west corner
+    int64_t _cellLat, _cellLon;     //!< cell size
+    int _rows, _cols;
+    int *_start;
+    uint16_t *_items;
+    int _startSize, _itemsSize;     //!< allocated entries
+    uint32_t _stamp;
+    int _tested;
+
+    GnssGeofence(const GnssGeofence &);
+    GnssGeofence &operator=(const GnssGeofence &);
+};
+
+#endif
+
+// End Of File
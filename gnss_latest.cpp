@@ -0,0 +1,51 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file gnss_latest.cpp
+ * This file implements the latest fix snapshot.
+ */
+
+#include "gnss_latest.h"
+
+bool GnssLatestFix::update(GnssParser *parser, char *buf, int len)
+{
+    if (PROTOCOL(len) == GnssParser::UBX)
+        len = LENGTH(len);
+    if (len < UBX_FRAME_SIZE)
+        return false;
+
+    switch (parser->get_ubx_message(buf)) {
+    case UBX_NAV_PVT:
+        _pvt.write(parser->decode_ubx_nav_pvt_msg(buf));
+        return true;
+    case UBX_NAV_STATUS:
+        _status.write(parser->decode_ubx_nav_status_msg(buf));
+        return true;
+    default:
+        return false;
+    }
+}
+
+void GnssLatestFix::publish(const tGNSS_EPOCH *epoch)
+{
+    if (epoch->content & GNSS_EPOCH_PVT)
+        _pvt.write(epoch->pvt);
+    if (epoch->content & GNSS_EPOCH_STATUS)
+        _status.write(epoch->status);
+}
+
+// End Of File
@@ -0,0 +1,74 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GNSS_LATEST_H
+#define GNSS_LATEST_H
+
+/**
+ * @file gnss_latest.h
+ * This file defines a store of the latest navigation solution that is
+ * written by the parsing thread and read by any number of threads.
+ */
+
+#include "gnss.h"
+#include "gnss_epoch.h"
+#include "seqlock.h"
+
+/** Latest fix snapshot.
+ * The parsing thread is the only writer, readers never block it.
+ */
+class GnssLatestFix
+{
+public:
+    /** Decode and publish a message returned by getMessage if it is
+     * a UBX-NAV-PVT or UBX-NAV-STATUS message.
+     * @param parser the parser used to decode the message.
+     * @param buf the message.
+     * @param len the length of the message.
+     * @return true if the message was published, false otherwise.
+     */
+    bool update(GnssParser *parser, char *buf, int len);
+
+    /** Publish the content of an assembled epoch.
+     * @param epoch the epoch record.
+     */
+    void publish(const tGNSS_EPOCH *epoch);
+
+    /** Get the latest UBX-NAV-PVT.
+     * @param pvt the latest solution.
+     * @return true if a solution is available, false otherwise.
+     */
+    bool get_pvt(tUBX_NAV_PVT &pvt) const { return _pvt.read(pvt); }
+
+    /** Get the latest UBX-NAV-STATUS.
+     * @param status the latest status.
+     * @return true if a status is available, false otherwise.
+     */
+    bool get_status(tUBX_NAV_STATUS &status) const { return _status.read(status); }
+
+    /** Number of UBX-NAV-PVT published, to detect a new solution cheaply.
+     * @return the counter.
+     */
+    uint32_t pvt_sequence(void) const { return _pvt.sequence(); }
+
+private:
+    SeqLock<tUBX_NAV_PVT> _pvt;
+    SeqLock<tUBX_NAV_STATUS> _status;
+};
+
+#endif
+
+// End Of File
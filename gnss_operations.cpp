@@ -1,11 +1,5 @@
 #include "gnss_operations.h"
 
-#ifndef UBLOX_WEARABLE_FRAMEWORK
-#define SEND_LOGGING_MESSAGE printf
-#else
-#include "MessageView.h"
-#endif
-
 #define FIRST_BYTE 0x000000FF
 #define SECOND_BYTE 0x0000FF00
 #define THIRD_BYTE 0x00FF0000
@@ -162,6 +156,72 @@ int GnssOperations::disable_ubx_nav_pvt()
     return (conf == 0) ? 0 : 1;
 }
 
+/**
+ *
+ * Disable UBX-NAV-STATUS
+ * @param return 	SUCCESS: 1
+ * 					FAILURE: 0
+ */
+int GnssOperations::disable_ubx_nav_status()
+{
+    int conf = RETRY;
+    unsigned char ubx_nav_status[]= {0x01, 0x03, 0x00};
+    conf = RETRY;
+    int length =0;
+
+    while(conf)
+    {
+
+        length = GnssSerial::sendUbx(0x06, 0x01, ubx_nav_status, sizeof(ubx_nav_status));
+        if(length >= (int)(sizeof(ubx_nav_status) + UBX_FRAME_SIZE))
+        {
+            SEND_LOGGING_MESSAGE("UBX-NAV-STATUS was disabled\r\n");
+            thread_sleep_for(500);
+            break;
+        }
+        else
+        {
+            SEND_LOGGING_MESSAGE("disabling UBX-NAV-STATUS...\r\n");
+            conf = conf - 1;
+        }
+    }
+
+    return (conf == 0) ? 0 : 1;
+}
+
+/**
+ *
+ * Disable UBX-NAV-SAT
+ * @param return 	SUCCESS: 1
+ * 					FAILURE: 0
+ */
+int GnssOperations::disable_ubx_nav_sat()
+{
+    int conf = RETRY;
+    unsigned char ubx_nav_sat[]= {0x01, 0x35, 0x00};
+    conf = RETRY;
+    int length =0;
+
+    while(conf)
+    {
+
+        length = GnssSerial::sendUbx(0x06, 0x01, ubx_nav_sat, sizeof(ubx_nav_sat));
+        if(length >= (int)(sizeof(ubx_nav_sat) + UBX_FRAME_SIZE))
+        {
+            SEND_LOGGING_MESSAGE("UBX-NAV-SAT was disabled\r\n");
+            thread_sleep_for(500);
+            break;
+        }
+        else
+        {
+            SEND_LOGGING_MESSAGE("disabling UBX-NAV-SAT...\r\n");
+            conf = conf - 1;
+        }
+    }
+
+    return (conf == 0) ? 0 : 1;
+}
+
 int GnssOperations::enable_ubx_nav5(unsigned int acc)
 {
     int conf = RETRY;
@@ -428,6 +488,103 @@ int GnssOperations::cfg_batch_feature(tUBX_CFG_BATCH *obj)
     return (length >= (int)(sizeof(cfg_batch_feature) + UBX_FRAME_SIZE)) ? 1 : 0;
 }
 
+int GnssOperations::batch_fill_level()
+{
+    char buf[UBX_WAIT_BUFFER_SIZE];
+    int length = 0;
+
+    // Poll UBX-MON-BATCH
+    length = GnssSerial::sendUbx(0x0A, 0x32, NULL, 0);
+    if (length < UBX_FRAME_SIZE) {
+        return -1;
+    }
+    length = waitUbx(0x0A, 0x32, buf, sizeof(buf), 500);
+    if (length < (UBX_FRAME_SIZE + 12)) {
+        return -1;
+    }
+
+    return decode_ubx_mon_batch_msg(buf).fillLevel;
+}
+
+bool GnssOperations::batch_ready(const tUBX_CFG_BATCH *cfg)
+{
+    int fill = batch_fill_level();
+
+    return (fill > 0) && ((uint32_t)fill >= cfg->notifThrs);
+}
+
+int GnssOperations::drain_batch(tUBX_LOG_BATCH *records, int max, tGNSS_BATCH_DRAIN *status, int timeout_ms)
+{
+    // Request the batch with UBX-MON-BATCH sent first
+    const unsigned char ubx_log_retrieve_batch[] = {0x00, 0x01, 0x00, 0x00};
+    char buf[UBX_WAIT_BUFFER_SIZE];
+    tGNSS_BATCH_DRAIN drain = {-1, 0, 0, false};
+    uint16_t nextMsgCnt = 0;
+    bool counting = false;
+    Timer timer;
+    int ret;
+
+    ret = GnssSerial::sendUbx(0x21, 0x10, ubx_log_retrieve_batch, sizeof(ubx_log_retrieve_batch));
+    if (ret < (int)(sizeof(ubx_log_retrieve_batch) + UBX_FRAME_SIZE)) {
+        if (status) {
+            *status = drain;
+        }
+        return 0;
+    }
+
+    timer.start();
+    while (!drain.complete && (timer.read_ms() < timeout_ms))
+    {
+        ret = getMessage(buf, sizeof(buf));
+        if (ret == WAIT) {
+            thread_sleep_for(1);
+            continue;
+        }
+        if ((ret <= 0) || (PROTOCOL(ret) != UBX)) {
+            continue;
+        }
+
+        switch (get_ubx_message(buf)) {
+        case UBX_MON_BATCH: {
+            tUBX_MON_BATCH mon = decode_ubx_mon_batch_msg(buf);
+            drain.expected = mon.fillLevel;
+            timer.reset();
+        }
+        break;
+        case UBX_LOG_BATCH: {
+            tUBX_LOG_BATCH record = decode_ubx_log_batch_msg(buf);
+            if (counting && (record.msgCnt != nextMsgCnt)) {
+                drain.gaps += (uint16_t)(record.msgCnt - nextMsgCnt);
+            }
+            nextMsgCnt = record.msgCnt + 1;
+            counting = true;
+            if (drain.received < max) {
+                records[drain.received] = record;
+            }
+            drain.received++;
+            timer.reset();
+        }
+        break;
+        default:
+            break;
+        }
+
+        if ((drain.expected >= 0) && ((drain.received + drain.gaps) >= drain.expected)) {
+            drain.complete = true;
+        }
+    }
+
+    if (drain.received > max) {
+        SEND_LOGGING_MESSAGE("UBX-LOG-BATCH records dropped, array too small\r\n");
+        drain.received = max;
+    }
+    if (status) {
+        *status = drain;
+    }
+
+    return drain.received;
+}
+
 /*
  *  Power mode configuration for GNSS receiver
  *
@@ -438,6 +595,7 @@ int GnssOperations::cfg_batch_feature(tUBX_CFG_BATCH *obj)
 int GnssOperations::cfg_power_mode(Powermodes power_mode, bool minimumAcqTimeZero)
 {
     int length = 0;
+    int acked = 1;
     const int minimumAcqTime_index = 22;
     unsigned char semi_continuous_pms[] = {0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
     unsigned char semi_continuous_pm2[] = {0x02, 0x06, 0x00, 0x00, 0x02, 0x00, 0x43, 0x01, 0x10, 0x27, 0x00, 0x00, 0x10,
@@ -474,7 +632,7 @@ int GnssOperations::cfg_power_mode(Powermodes power_mode, bool minimumAcqTimeZer
     case SEMI_CONTINOUS:
         SEND_LOGGING_MESSAGE("Configuring SEMI_CONTINOUS");
         length = GnssSerial::sendUbx(0x06, 0x86, semi_continuous_pms, sizeof(semi_continuous_pms));
-        thread_sleep_for(500);
+        acked &= waitAck(0x06, 0x86, 500);
 
         if(minimumAcqTimeZero) {
             semi_continuous_pm2[minimumAcqTime_index] = 0x00;
@@ -482,15 +640,15 @@ int GnssOperations::cfg_power_mode(Powermodes power_mode, bool minimumAcqTimeZer
         }
 
         length = GnssSerial::sendUbx(0x06, 0x3B, semi_continuous_pm2, sizeof(semi_continuous_pm2));
-        thread_sleep_for(500);
+        acked &= waitAck(0x06, 0x3B, 500);
         length = GnssSerial::sendUbx(0x06, 0x08, semi_continuous_rate, sizeof(semi_continuous_rate));
-        thread_sleep_for(500);
+        acked &= waitAck(0x06, 0x08, 500);
         break;
 
     case AGGRESSIVE_CONTINUOS:
         SEND_LOGGING_MESSAGE("Configuring AGGRESSIVE_CONTINUOS");
         length = GnssSerial::sendUbx(0x06, 0x86, aggresive_continuous_pms, sizeof(aggresive_continuous_pms));
-        thread_sleep_for(500);
+        acked &= waitAck(0x06, 0x86, 500);
 
         if(minimumAcqTimeZero) {
             semi_continuous_pm2[minimumAcqTime_index] = 0x00;
@@ -498,15 +656,15 @@ int GnssOperations::cfg_power_mode(Powermodes power_mode, bool minimumAcqTimeZer
         }
 
         length = GnssSerial::sendUbx(0x06, 0x3B, aggresive_continuous_pm2, sizeof(aggresive_continuous_pm2));
-        thread_sleep_for(500);
+        acked &= waitAck(0x06, 0x3B, 500);
         length = GnssSerial::sendUbx(0x06, 0x08, aggressive_continuous_rate, sizeof(aggressive_continuous_rate));
-        thread_sleep_for(500);
+        acked &= waitAck(0x06, 0x08, 500);
         break;
 
     case CONSERVATIVE_CONTINOUS:
         SEND_LOGGING_MESSAGE("Configuring CONSERVATIVE_CONTINOUS");
         length = GnssSerial::sendUbx(0x06, 0x86, conservative_continuous_pms, sizeof(conservative_continuous_pms));
-        thread_sleep_for(500);
+        acked &= waitAck(0x06, 0x86, 500);
 
         if(minimumAcqTimeZero) {
             semi_continuous_pm2[minimumAcqTime_index] = 0x00;
@@ -514,31 +672,31 @@ int GnssOperations::cfg_power_mode(Powermodes power_mode, bool minimumAcqTimeZer
         }
 
         length = GnssSerial::sendUbx(0x06, 0x3B, conservative_continuous_pm2, sizeof(conservative_continuous_pm2));
-        thread_sleep_for(500);
+        acked &= waitAck(0x06, 0x3B, 500);
         length = GnssSerial::sendUbx(0x06, 0x08, conservative_continuous_rate, sizeof(conservative_continuous_rate));
-        thread_sleep_for(500);
+        acked &= waitAck(0x06, 0x08, 500);
         break;
 
     case FULL_POWER:
         SEND_LOGGING_MESSAGE("Configuring FULL_POWER");
         length = GnssSerial::sendUbx(0x06, 0x86, full_power_pms, sizeof(full_power_pms));
-        thread_sleep_for(500);
+        acked &= waitAck(0x06, 0x86, 500);
         length = GnssSerial::sendUbx(0x06, 0x08, full_power_rate, sizeof(full_power_rate));
-        thread_sleep_for(500);
+        acked &= waitAck(0x06, 0x08, 500);
         break;
     case FULL_POWER_BLOCK_LEVEL:
         SEND_LOGGING_MESSAGE("Configuring FULL_POWER_BLOCK_LEVEL");
         length = GnssSerial::sendUbx(0x06, 0x86, full_power_block_level_pms, sizeof(full_power_block_level_pms));
-        thread_sleep_for(500);
+        acked &= waitAck(0x06, 0x86, 500);
         length = GnssSerial::sendUbx(0x06, 0x08, full_power_block_level_rate, sizeof(full_power_block_level_rate));
-        thread_sleep_for(500);
+        acked &= waitAck(0x06, 0x08, 500);
         break;
     case FULL_POWER_BUILDING_LEVEL:
         SEND_LOGGING_MESSAGE("Configuring FULL_POWER_BUILDING_LEVEL");
         length = GnssSerial::sendUbx(0x06, 0x86, full_power_building_level_pms, sizeof(full_power_building_level_pms));
-        thread_sleep_for(500);
+        acked &= waitAck(0x06, 0x86, 500);
         length = GnssSerial::sendUbx(0x06, 0x08, full_power_building_level_rate, sizeof(full_power_building_level_rate));
-        thread_sleep_for(500);
+        acked &= waitAck(0x06, 0x08, 500);
         break;
     case AVAILABLE_OPERATION:
     default : {
@@ -547,7 +705,8 @@ int GnssOperations::cfg_power_mode(Powermodes power_mode, bool minimumAcqTimeZer
     break;
     }
 
-    return (length >= (int)(sizeof(semi_continuous_pms) + UBX_FRAME_SIZE)) ? 1 : 0;
+    // Every message has to be acknowledged, a NAK leaves the previous mode partly active
+    return ((length >= (int)(sizeof(semi_continuous_pms) + UBX_FRAME_SIZE)) && acked) ? 1 : 0;
 }
 
 bool GnssOperations::verify_gnss_mode() {
@@ -617,3 +776,255 @@ void GnssOperations::power_on_gnss()
 {
     GnssSerial::_powerOn();
 }
+
+bool GnssOperations::has_cfg_valset()
+{
+    tUBX_CFG_KEYVAL item = {UBX_CFG_UART1_BAUDRATE, 0};
+
+    if (_cfgInterface < 0) {
+        _cfgInterface = cfg_valget(&item, 1, UBX_CFG_GET_RAM);
+        SEND_LOGGING_MESSAGE((_cfgInterface == 1) ? "UBX-CFG-VALSET supported\r\n" : "UBX-CFG-VALSET not supported\r\n");
+    }
+
+    return (_cfgInterface == 1);
+}
+
+int GnssOperations::_cfg_valset_frame(const tUBX_CFG_KEYVAL *items, int count, uint8_t layers, uint8_t transaction)
+{
+    unsigned char ubx_cfg_valset[4 + (UBX_CFG_VALSET_MAX_KEYS * 12)];
+    int index = 0;
+    int length = 0;
+
+    ubx_cfg_valset[index++] = (transaction == UBX_CFG_TRANSACTION_NONE) ? 0x00 : 0x01; // version
+    ubx_cfg_valset[index++] = layers;
+    ubx_cfg_valset[index++] = transaction;
+    ubx_cfg_valset[index++] = 0x00;
+
+    for (int i = 0; i < count; i++) {
+        int size = UBX_CFG_KEY_SIZE(items[i].key);
+        for (int j = 0; j < 4; j++) {
+            ubx_cfg_valset[index++] = (unsigned char)(items[i].key >> (j * 8));
+        }
+        for (int j = 0; j < size; j++) {
+            ubx_cfg_valset[index++] = (unsigned char)(items[i].value >> (j * 8));
+        }
+    }
+
+    length = GnssSerial::sendUbx(0x06, 0x8A, ubx_cfg_valset, index);
+    if (length < (index + UBX_FRAME_SIZE)) {
+        return 0;
+    }
+
+    return waitAck(0x06, 0x8A, 500);
+}
+
+int GnssOperations::cfg_valset(const tUBX_CFG_KEYVAL *items, int count, uint8_t layers)
+{
+    int conf = RETRY;
+    int sent = 0;
+
+    if (count <= UBX_CFG_VALSET_MAX_KEYS) {
+        while (conf) {
+            if (_cfg_valset_frame(items, count, layers, UBX_CFG_TRANSACTION_NONE)) {
+                SEND_LOGGING_MESSAGE("UBX-CFG-VALSET was applied\r\n");
+                break;
+            }
+            SEND_LOGGING_MESSAGE("applying UBX-CFG-VALSET...\r\n");
+            conf = conf - 1;
+        }
+        return (conf == 0) ? 0 : 1;
+    }
+
+    // Several frames: the receiver applies them atomically at the end of the transaction
+    while (sent < count) {
+        int chunk = count - sent;
+        uint8_t transaction = (sent == 0) ? UBX_CFG_TRANSACTION_BEGIN : UBX_CFG_TRANSACTION_CONTINUE;
+
+        if (chunk > UBX_CFG_VALSET_MAX_KEYS) {
+            chunk = UBX_CFG_VALSET_MAX_KEYS;
+        } else {
+            transaction = UBX_CFG_TRANSACTION_END;
+        }
+
+        if (!_cfg_valset_frame(&items[sent], chunk, layers, transaction)) {
+            SEND_LOGGING_MESSAGE("UBX-CFG-VALSET transaction failed\r\n");
+            if (sent > 0) {
+                _cfg_abort(0x8A);
+            }
+            return 0;
+        }
+        sent += chunk;
+    }
+    SEND_LOGGING_MESSAGE("UBX-CFG-VALSET transaction was applied\r\n");
+
+    return 1;
+}
+
+int GnssOperations::cfg_valget(tUBX_CFG_KEYVAL *items, int count, uint8_t layer)
+{
+    unsigned char ubx_cfg_valget[4 + (UBX_CFG_VALGET_MAX_KEYS * 4)];
+    char buf[UBX_WAIT_BUFFER_SIZE];
+    int done = 0;
+
+    while (done < count) {
+        int chunk = count - done;
+        int index = 0;
+        int length = 0;
+
+        if (chunk > UBX_CFG_VALGET_MAX_KEYS) {
+            chunk = UBX_CFG_VALGET_MAX_KEYS;
+        }
+
+        ubx_cfg_valget[index++] = 0x00; // version
+        ubx_cfg_valget[index++] = layer;
+        ubx_cfg_valget[index++] = 0x00; // position
+        ubx_cfg_valget[index++] = 0x00;
+        for (int i = 0; i < chunk; i++) {
+            for (int j = 0; j < 4; j++) {
+                ubx_cfg_valget[index++] = (unsigned char)(items[done + i].key >> (j * 8));
+            }
+        }
+
+        length = GnssSerial::sendUbx(0x06, 0x8B, ubx_cfg_valget, index);
+        if (length < (index + UBX_FRAME_SIZE)) {
+            return 0;
+        }
+
+        length = waitUbx(0x06, 0x8B, buf, sizeof(buf), 500);
+        if (length < (UBX_FRAME_SIZE + 4)) {
+            return 0;
+        }
+
+        // Response: version, layer, position followed by the key/value pairs
+        index = UBX_PAYLOAD_INDEX + 4;
+        while (index + 4 <= length - 2) {
+            uint32_t key = ubx_u4(&buf[index]);
+            int size = UBX_CFG_KEY_SIZE(key);
+            uint64_t value = 0;
+
+            index += 4;
+            if (index + size > length - 2) {
+                return 0;
+            }
+            for (int j = 0; j < size; j++) {
+                value |= ((uint64_t)(uint8_t)buf[index++]) << (j * 8);
+            }
+            for (int i = 0; i < chunk; i++) {
+                if (items[done + i].key == key) {
+                    items[done + i].value = value;
+                }
+            }
+        }
+        done += chunk;
+    }
+
+    return 1;
+}
+
+int GnssOperations::_cfg_valdel_frame(const uint32_t *keys, int count, uint8_t layers, uint8_t transaction)
+{
+    unsigned char ubx_cfg_valdel[4 + (UBX_CFG_VALSET_MAX_KEYS * 4)];
+    int index = 0;
+    int length = 0;
+
+    ubx_cfg_valdel[index++] = (transaction == UBX_CFG_TRANSACTION_NONE) ? 0x00 : 0x01; // version
+    ubx_cfg_valdel[index++] = layers;
+    ubx_cfg_valdel[index++] = transaction;
+    ubx_cfg_valdel[index++] = 0x00;
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < 4; j++) {
+            ubx_cfg_valdel[index++] = (unsigned char)(keys[i] >> (j * 8));
+        }
+    }
+
+    length = GnssSerial::sendUbx(0x06, 0x8C, ubx_cfg_valdel, index);
+    if (length < (index + UBX_FRAME_SIZE)) {
+        return 0;
+    }
+
+    return waitAck(0x06, 0x8C, 500);
+}
+
+int GnssOperations::cfg_valdel(const uint32_t *keys, int count, uint8_t layers)
+{
+    int sent = 0;
+
+    if (count <= UBX_CFG_VALSET_MAX_KEYS) {
+        return _cfg_valdel_frame(keys, count, layers, UBX_CFG_TRANSACTION_NONE);
+    }
+
+    while (sent < count) {
+        int chunk = count - sent;
+        uint8_t transaction = (sent == 0) ? UBX_CFG_TRANSACTION_BEGIN : UBX_CFG_TRANSACTION_CONTINUE;
+
+        if (chunk > UBX_CFG_VALSET_MAX_KEYS) {
+            chunk = UBX_CFG_VALSET_MAX_KEYS;
+        } else {
+            transaction = UBX_CFG_TRANSACTION_END;
+        }
+
+        if (!_cfg_valdel_frame(&keys[sent], chunk, layers, transaction)) {
+            if (sent > 0) {
+                _cfg_abort(0x8C);
+            }
+            return 0;
+        }
+        sent += chunk;
+    }
+
+    return 1;
+}
+
+// A transactionless frame without keys drops the frames of the open transaction
+int GnssOperations::_cfg_abort(unsigned char id)
+{
+    unsigned char ubx_cfg_abort[] = {0x01, 0x00, UBX_CFG_TRANSACTION_NONE, 0x00};
+    int length = GnssSerial::sendUbx(0x06, id, ubx_cfg_abort, sizeof(ubx_cfg_abort));
+
+    if (length < (int)(sizeof(ubx_cfg_abort) + UBX_FRAME_SIZE)) {
+        return 0;
+    }
+
+    return waitAck(0x06, id, 500);
+}
+
+int GnssOperations::cfg_nav_messages(bool pvt, bool status, bool sat, bool odo)
+{
+    if (has_cfg_valset()) {
+        const tUBX_CFG_KEYVAL items[] = {
+            {UBX_CFG_MSGOUT_UBX_NAV_PVT_UART1, pvt ? 1u : 0u},
+            {UBX_CFG_MSGOUT_UBX_NAV_STATUS_UART1, status ? 1u : 0u},
+            {UBX_CFG_MSGOUT_UBX_NAV_SAT_UART1, sat ? 1u : 0u},
+            {UBX_CFG_MSGOUT_UBX_NAV_ODO_UART1, odo ? 1u : 0u},
+            {UBX_CFG_ODO_USE_ODO, odo ? 1u : 0u}
+        };
+        return cfg_valset(items, sizeof(items) / sizeof(items[0]), UBX_CFG_LAYER_RAM);
+    }
+
+    // Legacy block configuration (M8)
+    int ret = 1;
+    if (pvt) {
+        ret &= enable_ubx_nav_pvt();
+    } else {
+        ret &= disable_ubx_nav_pvt();
+    }
+    if (status) {
+        ret &= enable_ubx_nav_status();
+    } else {
+        ret &= disable_ubx_nav_status();
+    }
+    if (sat) {
+        ret &= enable_ubx_nav_sat();
+    } else {
+        ret &= disable_ubx_nav_sat();
+    }
+    if (odo) {
+        ret &= enable_ubx_odo();
+        ret &= enable_ubx_nav_odo();
+    } else {
+        ret &= disable_ubx_nav_odo();
+        ret &= disable_ubx_odo();
+    }
+
+    return ret;
+}
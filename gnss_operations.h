@@ -1,7 +1,24 @@
 
 #include "gnss.h"
 
+// Logging of the operations and of the classes built on them
+#ifdef UBLOX_WEARABLE_FRAMEWORK
+#include "MessageView.h"
+#elif defined(GNSS_TRACE_LEVEL)
+#define SEND_LOGGING_MESSAGE GNSS_TRACE_MESSAGE
+#else
+#define SEND_LOGGING_MESSAGE printf
+#endif
+
 #define UBX_FRAME_SIZE 8
+#define UBX_CFG_VALSET_MAX_KEYS 64
+#define UBX_CFG_VALGET_MAX_KEYS 32
+
+/** Size in bytes of the value of a UBX-CFG-VALSET/VALGET key, encoded in bits 28..30 of the key id
+ */
+#define UBX_CFG_KEY_SIZE(key) ((((key) >> 28) & 0x07) == 5 ? 8 : \
+                               (((key) >> 28) & 0x07) == 4 ? 4 : \
+                               (((key) >> 28) & 0x07) == 3 ? 2 : 1)
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -39,6 +56,70 @@ enum Powermodes {
     AVAILABLE_OPERATION
 };
 
+/** Configuration keys of the UBX-CFG-VALSET/VALGET/VALDEL interface (generation 9 receivers)
+*/
+enum eUBX_CFG_KEY {
+    UBX_CFG_UART1_BAUDRATE              = 0x40520001,
+    UBX_CFG_UART1INPROT_UBX             = 0x10730001,
+    UBX_CFG_UART1INPROT_NMEA            = 0x10730002,
+    UBX_CFG_UART1OUTPROT_UBX            = 0x10740001,
+    UBX_CFG_UART1OUTPROT_NMEA           = 0x10740002,
+    UBX_CFG_RATE_MEAS                   = 0x30210001,
+    UBX_CFG_RATE_NAV                    = 0x30210002,
+    UBX_CFG_NAVSPG_DYNMODEL             = 0x20110021,
+    UBX_CFG_NAVSPG_ACKAIDING            = 0x10110025,
+    UBX_CFG_ODO_USE_ODO                 = 0x10220001,
+    UBX_CFG_PM_OPERATEMODE              = 0x20D00001,
+    UBX_CFG_PM_POSUPDATEPERIOD          = 0x40D00002,
+    UBX_CFG_PM_ONTIME                   = 0x30D00005,
+    UBX_CFG_MSGOUT_UBX_NAV_PVT_UART1    = 0x20910007,
+    UBX_CFG_MSGOUT_UBX_NAV_STATUS_UART1 = 0x2091001B,
+    UBX_CFG_MSGOUT_UBX_NAV_SAT_UART1    = 0x20910016,
+    UBX_CFG_MSGOUT_UBX_NAV_ODO_UART1    = 0x2091007F,
+    UBX_CFG_MSGOUT_UBX_NAV_EOE_UART1    = 0x20910160,
+    UBX_CFG_MSGOUT_UBX_RXM_RAWX_UART1   = 0x209102A5,
+    UBX_CFG_MSGOUT_UBX_RXM_SFRBX_UART1  = 0x20910232
+};
+
+/** Configuration layers of the UBX-CFG-VALSET/VALDEL interface
+*/
+enum eUBX_CFG_LAYER {
+    UBX_CFG_LAYER_RAM   = 0x01,
+    UBX_CFG_LAYER_BBR   = 0x02,
+    UBX_CFG_LAYER_FLASH = 0x04
+};
+
+/** Layer to read from with UBX-CFG-VALGET
+*/
+enum eUBX_CFG_GET_LAYER {
+    UBX_CFG_GET_RAM     = 0,
+    UBX_CFG_GET_BBR     = 1,
+    UBX_CFG_GET_FLASH   = 2,
+    UBX_CFG_GET_DEFAULT = 7
+};
+
+/** Transaction flags of the UBX-CFG-VALSET/VALDEL interface
+*/
+enum eUBX_CFG_TRANSACTION {
+    UBX_CFG_TRANSACTION_NONE     = 0,
+    UBX_CFG_TRANSACTION_BEGIN    = 1,
+    UBX_CFG_TRANSACTION_CONTINUE = 2,
+    UBX_CFG_TRANSACTION_END      = 3
+};
+
+typedef struct UBX_CFG_KEYVAL {
+    uint32_t key;
+    uint64_t value;
+
+} tUBX_CFG_KEYVAL;
+
+typedef struct GNSS_BATCH_DRAIN {
+    int expected;   // fill level reported by UBX-MON-BATCH, -1 if unknown
+    int received;   // records stored in the caller's array
+    int gaps;       // records missing according to msgCnt
+    bool complete;  // all expected records were accounted for
+
+} tGNSS_BATCH_DRAIN;
 
 class GnssOperations : public GnssSerial {
 
@@ -87,6 +168,20 @@ public:
      */
     int disable_ubx_nav_pvt();
 
+    /** Disable GNSS receiver UBX-NAV-STATUS messages
+     *  @param void
+     *  @return int 	1: Successful
+     * 	                0: Failure
+     */
+    int disable_ubx_nav_status();
+
+    /** Disable GNSS receiver UBX-NAV-SAT messages
+     *  @param void
+     *  @return int 	1: Successful
+     * 	                0: Failure
+     */
+    int disable_ubx_nav_sat();
+
     /** Enable GNSS receiver UBX-NAV5 messages
      *  Navigation Engine Settings
      *  @param  uint 	acc 	Defines positioning accuracy
@@ -157,6 +252,32 @@ public:
      */
     int cfg_batch_feature(tUBX_CFG_BATCH *obj);
 
+    /** Poll the fill level of the receiver batch buffer
+     *  Uses UBX-MON-BATCH
+     *  @param 	void
+     *  @return int     number of records in the buffer, -1 on failure
+     */
+    int batch_fill_level();
+
+    /** Check if the batch buffer reached the notification threshold
+     *  Alternative to watching the PIO configured with cfg_batch_feature()
+     *  @param 	tUBX_CFG_BATCH  the configuration used with cfg_batch_feature()
+     *  @return bool    true: batch ready to be drained
+     */
+    bool batch_ready(const tUBX_CFG_BATCH *cfg);
+
+    /** Retrieve and decode the whole receiver batch in one pass
+     *  Sends UBX-LOG-RETRIEVEBATCH and stream decodes the UBX-LOG-BATCH
+     *  records as they arrive. Returns as soon as all records reported
+     *  by UBX-MON-BATCH are accounted for or the link was idle for timeout_ms.
+     *  @param 	records     array to store the decoded records
+     *          max         size of the array
+     *          status      optional drain statistics
+     *          timeout_ms  maximum idle time between two records
+     *  @return int     number of records stored
+     */
+    int drain_batch(tUBX_LOG_BATCH *records, int max, tGNSS_BATCH_DRAIN *status = NULL, int timeout_ms = 500);
+
     /** Configure GNSS receiver power mode
      *  Power mode setup
      *  @param 	Powermodes     SEMI_CONTINOUS
@@ -201,6 +322,58 @@ public:
      */
     void power_on_gnss();
 
+    /** Check if the receiver supports the UBX-CFG-VALSET/VALGET interface
+     *  The result of the first probe is cached.
+     *  @param 	void
+     *  @return bool    true:  generation 9 receiver
+     *                  false: legacy (M8) receiver, use the block configuration messages
+     */
+    bool has_cfg_valset();
+
+    /** Set configuration items using UBX-CFG-VALSET
+     *  More than UBX_CFG_VALSET_MAX_KEYS items are sent in one transaction over several frames,
+     *  a NAK of one frame aborts the transaction and nothing is applied
+     *  @param 	items   key/value pairs to set
+     *          count   number of items
+     *          layers  combination of eUBX_CFG_LAYER
+     *  @return int     1: Successful
+     *                  0: Failure
+     */
+    int cfg_valset(const tUBX_CFG_KEYVAL *items, int count, uint8_t layers = UBX_CFG_LAYER_RAM);
+
+    /** Get configuration items using UBX-CFG-VALGET
+     *  @param 	items   keys to poll, values are filled in
+     *          count   number of items
+     *          layer   eUBX_CFG_GET_LAYER to read from
+     *  @return int     1: Successful
+     *                  0: Failure
+     */
+    int cfg_valget(tUBX_CFG_KEYVAL *items, int count, uint8_t layer = UBX_CFG_GET_RAM);
+
+    /** Delete configuration items using UBX-CFG-VALDEL
+     *  @param 	keys    keys to delete
+     *          count   number of keys
+     *          layers  UBX_CFG_LAYER_BBR and/or UBX_CFG_LAYER_FLASH
+     *  @return int     1: Successful
+     *                  0: Failure
+     */
+    int cfg_valdel(const uint32_t *keys, int count, uint8_t layers);
+
+    /** Enable or disable the navigation messages in a single step
+     *  Uses one UBX-CFG-VALSET frame on generation 9 receivers and falls back to UBX-CFG-MSG otherwise.
+     *  @param 	pvt, status, sat, odo   message output to enable
+     *  @return int     1: Successful
+     *                  0: Failure
+     */
+    int cfg_nav_messages(bool pvt, bool status, bool sat, bool odo);
+
+private:
+    int _cfg_valset_frame(const tUBX_CFG_KEYVAL *items, int count, uint8_t layers, uint8_t transaction);
+    int _cfg_valdel_frame(const uint32_t *keys, int count, uint8_t layers, uint8_t transaction);
+    int _cfg_abort(unsigned char id);
+
+    int _cfgInterface = -1; //!< -1: not probed, 0: legacy, 1: CFG-VALSET
+
 };
 #ifdef __cplusplus
 }
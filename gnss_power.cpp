@@ -0,0 +1,255 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file gnss_power.cpp
+ * This file implements the duty-cycle controller.
+ */
+
+#include "gnss_power.h"
+
+#define DEG_1E7_TO_UM 11132 // length of 1e-7 deg of latitude in um
+
+GnssPowerController::GnssPowerController(GnssOperations *gnss, const tGNSS_POWER_CONFIG *cfg) :
+    _gnss(gnss), _cfg(*cfg), _state(GNSS_POWER_FULL), _from(GNSS_POWER_FULL),
+    _pending(true), _woken(false), _entered(0), _moved(0), _fixed(0),
+    _lat(0), _lon(0), _havePos(false), _batchItow(0)
+{
+    memset(_ttff, 0, sizeof(_ttff));
+    _timer.start();
+}
+
+void GnssPowerController::attach(Callback<void(eGNSS_POWER_STATE, eGNSS_POWER_STATE)> cb)
+{
+    _cb = cb;
+}
+
+void GnssPowerController::set_rate(uint32_t rate_ms)
+{
+    _cfg.rate_ms = rate_ms;
+    // The ON/OFF period is part of the receiver configuration
+    if (_state == GNSS_POWER_ON_OFF_BATCH)
+        _apply(GNSS_POWER_ON_OFF_BATCH);
+    _enter(_target());
+}
+
+eGNSS_POWER_STATE GnssPowerController::update(const tUBX_NAV_PVT *pvt)
+{
+    bool valid = ((pvt->fixType == 0x03) || (pvt->fixType == 0x04)) && (pvt->flag1 & 0x01);
+
+    _fix(valid, pvt->lat, pvt->lon, pvt->speed);
+    return _state;
+}
+
+eGNSS_POWER_STATE GnssPowerController::update(const tUBX_LOG_BATCH *rec)
+{
+    int32_t speed = 0;
+
+    // The batch only holds valid fixes, the speed comes from the displacement
+    if (_havePos && (rec->itow > _batchItow)) {
+        uint64_t dn = (rec->lat > _lat) ? (int64_t)rec->lat - _lat : (int64_t)_lat - rec->lat;
+        uint64_t de = (rec->lon > _lon) ? (int64_t)rec->lon - _lon : (int64_t)_lon - rec->lon;
+        de = (de * gnss_cos_q14(_lat)) >> GNSS_COS_SHIFT;
+        speed = (int32_t)(gnss_isqrt(dn * dn + de * de) * DEG_1E7_TO_UM / (rec->itow - _batchItow));
+    }
+    _batchItow = rec->itow;
+    _fix(true, rec->lat, rec->lon, speed);
+    return _state;
+}
+
+void GnssPowerController::_fix(bool valid, int32_t lat, int32_t lon, int32_t speed)
+{
+    int now = _timer.read_ms();
+
+    if (!valid)
+        return;
+    _fixed = now;
+
+    if (_pending) {
+        tGNSS_POWER_TTFF *t = &_ttff[_from][_state];
+        uint32_t ms = now - _entered;
+        t->count++;
+        t->last_ms = ms;
+        t->total_ms += ms;
+        if (ms > t->max_ms)
+            t->max_ms = ms;
+        _pending = false;
+    }
+
+    if (_woken) {
+        // Only a position change tells if the device moved while off, the
+        // longitude difference scaled to a distance as the latitude one
+        _woken = false;
+        if (_havePos) {
+            int64_t dLat = (int64_t)lat - _lat;
+            int64_t dLon = (((int64_t)lon - _lon) * gnss_cos_q14(_lat)) >> GNSS_COS_SHIFT;
+            if ((dLat > GNSS_POWER_WAKE_DISTANCE) || (dLat < -GNSS_POWER_WAKE_DISTANCE) ||
+                    (dLon > GNSS_POWER_WAKE_DISTANCE) || (dLon < -GNSS_POWER_WAKE_DISTANCE))
+                _moved = now;
+        } else {
+            _moved = now;
+        }
+    } else if (speed > _cfg.moving_speed) {
+        _moved = now;
+    }
+    _lat = lat;
+    _lon = lon;
+    _havePos = true;
+
+    _enter(_target());
+}
+
+eGNSS_POWER_STATE GnssPowerController::poll(void)
+{
+    int now = _timer.read_ms();
+    uint32_t lost = GNSS_POWER_LOST_FIX_MS;
+
+    if (_state == GNSS_POWER_OFF) {
+        if ((uint32_t)(now - _entered) >= _cfg.wake_s * 1000) {
+            _woken = true;
+            _enter(GNSS_POWER_FULL);
+        }
+    } else if (_state != GNSS_POWER_FULL) {
+        // Fixes of the ON/OFF mode arrive with the batch drains
+        if (lost < 3 * _cfg.rate_ms)
+            lost = 3 * _cfg.rate_ms;
+        if ((uint32_t)(now - _fixed) >= lost) {
+            SEND_LOGGING_MESSAGE("No fix in low power mode, switching to full power\r\n");
+            _enter(GNSS_POWER_FULL);
+        }
+    }
+
+    return _state;
+}
+
+void GnssPowerController::wake(void)
+{
+    _moved = _timer.read_ms();
+    _woken = false;
+    _enter((_state == GNSS_POWER_OFF) ? GNSS_POWER_FULL : _target());
+}
+
+const tGNSS_POWER_TTFF *GnssPowerController::ttff(eGNSS_POWER_STATE from, eGNSS_POWER_STATE to) const
+{
+    if ((from >= GNSS_POWER_STATES) || (to >= GNSS_POWER_STATES))
+        return NULL;
+    return &_ttff[from][to];
+}
+
+eGNSS_POWER_STATE GnssPowerController::_target(void)
+{
+    uint32_t still = _timer.read_ms() - _moved;
+
+    // Acquisition needs full power
+    if ((_state == GNSS_POWER_FULL) && _pending)
+        return GNSS_POWER_FULL;
+    if (_cfg.off_s && (still >= (_cfg.still_s + _cfg.off_s) * 1000))
+        return GNSS_POWER_OFF;
+    if (_cfg.rate_ms < GNSS_POWER_CYCLIC_MIN_MS)
+        return GNSS_POWER_FULL;
+    if ((still >= _cfg.still_s * 1000) || (_cfg.rate_ms >= GNSS_POWER_ON_OFF_MIN_MS))
+        return GNSS_POWER_ON_OFF_BATCH;
+    return GNSS_POWER_CYCLIC;
+}
+
+int GnssPowerController::_apply(eGNSS_POWER_STATE state)
+{
+    bool gen9;
+
+    if (_state == GNSS_POWER_OFF) {
+        // init() powers the module on and restores the link
+        if (!_gnss->init())
+            return 0;
+    }
+    if ((_state == GNSS_POWER_ON_OFF_BATCH) && (state != GNSS_POWER_ON_OFF_BATCH) && (state != GNSS_POWER_OFF))
+        _gnss->disable_ubx_batch_feature();
+
+    gen9 = (state != GNSS_POWER_OFF) && _gnss->has_cfg_valset();
+
+    switch (state)
+    {
+    case GNSS_POWER_FULL:
+        SEND_LOGGING_MESSAGE("Power state FULL\r\n");
+        if (gen9) {
+            const tUBX_CFG_KEYVAL items[] = {{UBX_CFG_PM_OPERATEMODE, 0}};
+            return _gnss->cfg_valset(items, 1);
+        }
+        return _gnss->cfg_power_mode(FULL_POWER, false);
+
+    case GNSS_POWER_CYCLIC:
+        SEND_LOGGING_MESSAGE("Power state CYCLIC\r\n");
+        if (gen9) {
+            const tUBX_CFG_KEYVAL items[] = {{UBX_CFG_PM_OPERATEMODE, 2}, {UBX_CFG_PM_POSUPDATEPERIOD, 1}};
+            return _gnss->cfg_valset(items, 2);
+        }
+        return _gnss->cfg_power_mode(AGGRESSIVE_CONTINUOS, false);
+
+    case GNSS_POWER_ON_OFF_BATCH: {
+        SEND_LOGGING_MESSAGE("Power state ON_OFF_BATCH\r\n");
+        uint16_t period = _cfg.rate_ms / 1000;
+        int ok;
+        if (gen9) {
+            const tUBX_CFG_KEYVAL items[] = {{UBX_CFG_PM_OPERATEMODE, 1}, {UBX_CFG_PM_POSUPDATEPERIOD, period},
+                {UBX_CFG_PM_ONTIME, _cfg.on_time_s}};
+            ok = _gnss->cfg_valset(items, 3);
+        } else {
+            // UBX-CFG-PMS interval mode
+            unsigned char ubx_cfg_pms[] = {0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+            ubx_cfg_pms[2] = period & 0xFF;
+            ubx_cfg_pms[3] = (period >> 8) & 0xFF;
+            ubx_cfg_pms[4] = _cfg.on_time_s & 0xFF;
+            ubx_cfg_pms[5] = (_cfg.on_time_s >> 8) & 0xFF;
+            _gnss->sendUbx(0x06, 0x86, ubx_cfg_pms, sizeof(ubx_cfg_pms));
+            ok = _gnss->waitAck(0x06, 0x86, 500);
+        }
+        if (_state != GNSS_POWER_ON_OFF_BATCH)
+            _gnss->enable_ubx_batch_feature();
+        return ok;
+    }
+
+    case GNSS_POWER_OFF:
+        SEND_LOGGING_MESSAGE("Power state OFF\r\n");
+        _gnss->cutOffPower();
+        return 1;
+
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+void GnssPowerController::_enter(eGNSS_POWER_STATE state)
+{
+    eGNSS_POWER_STATE from = _state;
+
+    if (state == _state)
+        return;
+    if (!_apply(state)) {
+        SEND_LOGGING_MESSAGE("Power state change failed\r\n");
+        return;
+    }
+
+    _from = from;
+    _state = state;
+    _entered = _timer.read_ms();
+    _fixed = _entered;
+    _pending = (state != GNSS_POWER_OFF);
+    if (_cb)
+        _cb(from, state);
+}
+
+// End Of File
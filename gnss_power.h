@@ -0,0 +1,164 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GNSS_POWER_H
+#define GNSS_POWER_H
+
+/**
+ * @file gnss_power.h
+ * This file defines a controller that selects the receiver power mode from
+ * the motion state, the fix quality and the required update rate.
+ */
+
+#include "gnss_operations.h"
+
+#define GNSS_POWER_CYCLIC_MIN_MS   1000    // fastest rate of cyclic tracking
+#define GNSS_POWER_ON_OFF_MIN_MS   10000   // ON/OFF is used from this rate on
+#define GNSS_POWER_LOST_FIX_MS     30000   // no fix in a low power mode before going back to full power
+#define GNSS_POWER_WAKE_DISTANCE   4500    // 1e-7 deg, about 50 m: moved while powered off
+
+/** Power states of the controller
+*/
+enum eGNSS_POWER_STATE {
+    GNSS_POWER_FULL,          // continuous tracking, used for acquisition
+    GNSS_POWER_CYCLIC,        // cyclic tracking (UBX-CFG-PMS aggressive 1 Hz)
+    GNSS_POWER_ON_OFF_BATCH,  // ON/OFF operation, fixes collected in the batch buffer
+    GNSS_POWER_OFF,           // supply cut off with cutOffPower()
+    GNSS_POWER_STATES
+};
+
+typedef struct GNSS_POWER_CONFIG {
+    uint32_t rate_ms;       // required interval between positions
+    int32_t moving_speed;   // mm/s, ground speed above which the device is moving
+    uint32_t still_s;       // time without motion before the ON/OFF mode is used
+    uint32_t off_s;         // further time without motion before the power is cut, 0: never
+    uint32_t wake_s;        // interval of the position checks while powered off
+    uint16_t on_time_s;     // on time of the ON/OFF mode
+
+} tGNSS_POWER_CONFIG;
+
+/** Time to first fix after entering a state, per transition
+*/
+typedef struct GNSS_POWER_TTFF {
+    uint32_t count;     // number of fixes measured
+    uint32_t last_ms;
+    uint32_t max_ms;
+    uint32_t total_ms;  // divide by count for the mean
+
+} tGNSS_POWER_TTFF;
+
+/** Duty-cycle controller.
+ * Feed every UBX-NAV-PVT with update() (or the drained UBX-LOG-BATCH
+ * records in the ON/OFF state) and call poll() periodically. The receiver
+ * is reconfigured on every state change, and the time from the change to
+ * the first valid fix is recorded per transition.
+ */
+class GnssPowerController
+{
+public:
+    /** Constructor, starts in GNSS_POWER_FULL.
+     * @param gnss the receiver.
+     * @param cfg the configuration, copied.
+     */
+    GnssPowerController(GnssOperations *gnss, const tGNSS_POWER_CONFIG *cfg);
+
+    /** Attach the function called after every state change.
+     * @param cb the callback, receives the previous and the new state.
+     */
+    void attach(Callback<void(eGNSS_POWER_STATE, eGNSS_POWER_STATE)> cb);
+
+    /** Change the required update rate.
+     * @param rate_ms interval between positions.
+     */
+    void set_rate(uint32_t rate_ms);
+
+    /** Feed a navigation solution.
+     * @param pvt the decoded UBX-NAV-PVT.
+     * @return the current state.
+     */
+    eGNSS_POWER_STATE update(const tUBX_NAV_PVT *pvt);
+
+    /** Feed a batched fix, the speed is derived from the previous record.
+     * @param rec the decoded UBX-LOG-BATCH.
+     * @return the current state.
+     */
+    eGNSS_POWER_STATE update(const tUBX_LOG_BATCH *rec);
+
+    /** Handle the time based transitions: wake up while powered off and
+     * fall back to full power after losing the fix.
+     * @return the current state.
+     */
+    eGNSS_POWER_STATE poll(void);
+
+    /** Leave the low power states at once, e.g. on a motion interrupt.
+     */
+    void wake(void);
+
+    /** Get the current state.
+     * @return the state.
+     */
+    eGNSS_POWER_STATE state(void) const { return _state; }
+
+    /** Get the time to first fix statistics of a transition.
+     * @param from the previous state.
+     * @param to the new state.
+     * @return the statistics.
+     */
+    const tGNSS_POWER_TTFF *ttff(eGNSS_POWER_STATE from, eGNSS_POWER_STATE to) const;
+
+protected:
+    /** Select the state for the current motion and rate.
+     * @return the target state.
+     */
+    eGNSS_POWER_STATE _target(void);
+
+    /** Configure the receiver for a state.
+     * @param state the new state.
+     * @return 1 if successful, 0 otherwise.
+     */
+    int _apply(eGNSS_POWER_STATE state);
+
+    /** Change the state if needed.
+     * @param state the new state.
+     */
+    void _enter(eGNSS_POWER_STATE state);
+
+    /** Common handling of a position.
+     */
+    void _fix(bool valid, int32_t lat, int32_t lon, int32_t speed);
+
+    GnssOperations *_gnss;
+    tGNSS_POWER_CONFIG _cfg;
+
+private:
+    Callback<void(eGNSS_POWER_STATE, eGNSS_POWER_STATE)> _cb;
+    eGNSS_POWER_STATE _state;
+    eGNSS_POWER_STATE _from;         //!< state before the last change
+    bool _pending;                   //!< waiting for the first fix after a change
+    bool _woken;                     //!< first fix after a wake up from GNSS_POWER_OFF
+    Timer _timer;
+    int _entered;                    //!< time of the last change in ms
+    int _moved;                      //!< time the device was last moving in ms
+    int _fixed;                      //!< time of the last valid fix in ms
+    int32_t _lat, _lon;              //!< last valid position
+    bool _havePos;
+    uint32_t _batchItow;             //!< iTOW of the previous batch record
+    tGNSS_POWER_TTFF _ttff[GNSS_POWER_STATES][GNSS_POWER_STATES];
+};
+
+#endif
+
+// End Of File
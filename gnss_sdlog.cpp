@@ -0,0 +1,112 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file gnss_sdlog.cpp
+ * This file implements the asynchronous traffic logger.
+ */
+
+#include "gnss_sdlog.h"
+
+GnssSdLogger::GnssSdLogger(void) :
+    _thread(osPriorityLow, GNSS_SDLOG_STACK_SIZE), _ready(0),
+    _active(0), _fill(0), _dropped(0)
+{
+    _busy[0] = false;
+    _busy[1] = false;
+}
+
+bool GnssSdLogger::start(Callback<int(const void *, int)> sink)
+{
+    _sink = sink;
+    return (_thread.start(callback(this, &GnssSdLogger::_run)) == osOK);
+}
+
+void GnssSdLogger::_run(void)
+{
+    int next = 0;
+
+    // Buffers are handed off alternately
+    for (;;) {
+        _ready.acquire();
+        _sink(_buf[next], GNSS_SDLOG_BUFFER_SIZE);
+        _busy[next] = false;
+        next ^= 1;
+    }
+}
+
+bool GnssSdLogger::_handOff(void)
+{
+    // Zero the rest, reads as padding
+    memset(&_buf[_active][_fill], 0, GNSS_SDLOG_BUFFER_SIZE - _fill);
+    _busy[_active] = true;
+    _ready.release();
+    _active ^= 1;
+    _fill = 0;
+    return !_busy[_active];
+}
+
+void GnssSdLogger::log(uint8_t dir, const void *buf, int len)
+{
+    const char *p = (const char *)buf;
+    tGNSS_SDLOG_CHUNK chunk;
+
+    chunk.time = (uint32_t)Kernel::get_ms_count();
+    chunk.dir = dir;
+    chunk.reserved = 0;
+
+    _mutex.lock();
+    while (len > 0) {
+        if (_busy[_active]) {
+            _dropped += len;
+            break;
+        }
+        int room = GNSS_SDLOG_BLOCK - (_fill % GNSS_SDLOG_BLOCK);
+        if (room <= (int)sizeof(chunk)) {
+            memset(&_buf[_active][_fill], 0, room);
+            _fill += room;
+            if ((_fill == GNSS_SDLOG_BUFFER_SIZE) && !_handOff()) {
+                _dropped += len;
+                break;
+            }
+            continue;
+        }
+        int n = room - (int)sizeof(chunk);
+        if (n > len)
+            n = len;
+        chunk.len = n;
+        memcpy(&_buf[_active][_fill], &chunk, sizeof(chunk));
+        memcpy(&_buf[_active][_fill + sizeof(chunk)], p, n);
+        _fill += sizeof(chunk) + n;
+        p += n;
+        len -= n;
+        if ((_fill == GNSS_SDLOG_BUFFER_SIZE) && !_handOff() && (len > 0)) {
+            _dropped += len;
+            break;
+        }
+    }
+    _mutex.unlock();
+}
+
+void GnssSdLogger::flush(void)
+{
+    _mutex.lock();
+    if ((_fill > 0) && !_busy[_active])
+        _handOff();
+    _mutex.unlock();
+}
+
+// End Of File
@@ -0,0 +1,104 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GNSS_SDLOG_H
+#define GNSS_SDLOG_H
+
+/**
+ * @file gnss_sdlog.h
+ * This file defines an asynchronous logger of the receiver traffic that
+ * writes whole card blocks from a low priority thread.
+ */
+
+#include "mbed.h"
+
+#define GNSS_SDLOG_BLOCK 512                                     // card block size
+#define GNSS_SDLOG_BLOCKS 4                                      // blocks per buffer
+#define GNSS_SDLOG_BUFFER_SIZE (GNSS_SDLOG_BLOCK * GNSS_SDLOG_BLOCKS)
+#define GNSS_SDLOG_STACK_SIZE 1024
+
+/** Direction of a chunk
+*/
+enum eGNSS_SDLOG_DIR {
+    GNSS_SDLOG_RX = 0x01,
+    GNSS_SDLOG_TX = 0x02
+};
+
+/** Chunk header, followed by len bytes of data. Chunks never cross a
+ * block boundary; a header with len 0 or less than a header left in a
+ * block marks the padding up to the next block.
+ */
+typedef struct GNSS_SDLOG_CHUNK {
+    uint32_t time;     // ms since start of the kernel
+    uint8_t dir;       // eGNSS_SDLOG_DIR
+    uint8_t reserved;
+    uint16_t len;
+
+} tGNSS_SDLOG_CHUNK;
+
+/** Double buffered traffic logger.
+ * log() only copies into the active buffer and never waits for the card;
+ * if both buffers are waiting to be written the data is dropped and counted.
+ */
+class GnssSdLogger
+{
+public:
+    /** Constructor.
+     */
+    GnssSdLogger(void);
+
+    /** Start the writer thread.
+     * @param sink function writing a buffer to the card, called with
+     *        GNSS_SDLOG_BUFFER_SIZE bytes.
+     * @return true if successful, false otherwise.
+     */
+    bool start(Callback<int(const void *, int)> sink);
+
+    /** Copy traffic into the log.
+     * @param dir eGNSS_SDLOG_DIR.
+     * @param buf the data.
+     * @param len the length of the data.
+     */
+    void log(uint8_t dir, const void *buf, int len);
+
+    /** Pad the active buffer and pass it to the writer thread, e.g. before
+     * powering down.
+     */
+    void flush(void);
+
+    /** Number of bytes dropped because the card was too slow.
+     * @return the counter.
+     */
+    uint32_t dropped(void) const { return _dropped; }
+
+private:
+    void _run(void);
+    bool _handOff(void);
+
+    Callback<int(const void *, int)> _sink;
+    Thread _thread;
+    Semaphore _ready;
+    Mutex _mutex;
+    int _active;                  //!< buffer being filled
+    int _fill;                    //!< bytes used in the active buffer
+    volatile bool _busy[2];       //!< buffer waits for or is in the writer
+    uint32_t _dropped;
+    char _buf[2][GNSS_SDLOG_BUFFER_SIZE];
+};
+
+#endif
+
+// End Of File
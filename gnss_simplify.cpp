@@ -0,0 +1,203 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file gnss_simplify.cpp
+ * This file implements the online line simplification.
+ */
+
+#include "gnss_simplify.h"
+
+#define DIR_BITS 24                                  // size of the direction vectors
+
+// Scale a vector down to less than 2^bits per component
+static void shrink(int64_t *x, int64_t *y, int bits)
+{
+    while ((*x >= (1LL << bits)) || (*x <= -(1LL << bits)) || (*y >= (1LL << bits)) || (*y <= -(1LL << bits))) {
+        *x /= 2;
+        *y /= 2;
+    }
+}
+
+// Direction u within the cone counter clockwise from lo to hi, narrower than 180 deg
+static bool in_cone(int64_t ux, int64_t uy, int64_t loX, int64_t loY, int64_t hiX, int64_t hiY)
+{
+    return ((loX * uy - loY * ux) >= 0) && ((ux * hiY - uy * hiX) >= 0) &&
+           ((ux * (loX + hiX) + uy * (loY + hiY)) > 0);
+}
+
+GnssTrackSimplifier::GnssTrackSimplifier(Callback<void(const tGNSS_SIMPLIFY_POINT *)> sink, uint32_t error_m, uint32_t max_s) :
+    _sink(sink), _error(GNSS_M_TO_UNITS(error_m)), _max_ms(max_s * 1000), _added(0), _kept(0)
+{
+    reset();
+}
+
+void GnssTrackSimplifier::reset(void)
+{
+    _haveAnchor = false;
+    _haveLast = false;
+    _open = true;
+    _empty = false;
+    _maxD = 0;
+}
+
+void GnssTrackSimplifier::add(const tUBX_NAV_PVT *pvt)
+{
+    tGNSS_SIMPLIFY_POINT p;
+
+    if (((pvt->fixType != 0x03) && (pvt->fixType != 0x04)) || !(pvt->flag1 & 0x01))
+        return;
+    p.itow = pvt->itow;
+    p.lat = pvt->lat;
+    p.lon = pvt->lon;
+    p.height = pvt->height;
+    p.speed = pvt->speed;
+    add(&p);
+}
+
+void GnssTrackSimplifier::add(const tUBX_LOG_BATCH *rec)
+{
+    tGNSS_SIMPLIFY_POINT p;
+
+    p.itow = rec->itow;
+    p.lat = rec->lat;
+    p.lon = rec->lon;
+    p.height = rec->height;
+    p.speed = 0;
+    add(&p);
+}
+
+void GnssTrackSimplifier::add(const tGNSS_SIMPLIFY_POINT *p)
+{
+    _added++;
+    if (!_haveAnchor) {
+        _keep(p);
+        return;
+    }
+    if (!_fits(p)) {
+        // The segment ends at the fix before, the new one starts there
+        if (_haveLast)
+            _keep(&_last);
+        if (!_fits(p)) {
+            _keep(p);
+            return;
+        }
+    }
+    _last = *p;
+    _haveLast = true;
+
+    // Keep a fix at least every max_s
+    if (_max_ms) {
+        uint32_t ms = (p->itow >= _anchor.itow) ? p->itow - _anchor.itow : p->itow + 604800000 - _anchor.itow;
+        if (ms >= _max_ms)
+            _keep(p);
+    }
+}
+
+void GnssTrackSimplifier::flush(void)
+{
+    if (_haveLast)
+        _keep(&_last);
+}
+
+void GnssTrackSimplifier::_keep(const tGNSS_SIMPLIFY_POINT *p)
+{
+    _anchor = *p;
+    _haveAnchor = true;
+    _haveLast = false;
+    _open = true;
+    _empty = false;
+    _maxD = 0;
+    _cosQ = gnss_cos_q14(p->lat);
+    _kept++;
+    _sink(p);
+}
+
+// Check if the fix can end the segment, then narrow the cone with it
+bool GnssTrackSimplifier::_fits(const tGNSS_SIMPLIFY_POINT *p)
+{
+    int64_t y = (int64_t)p->lat - _anchor.lat;
+    int64_t x = (((int64_t)p->lon - _anchor.lon) * _cosQ) >> GNSS_COS_SHIFT;
+    int64_t d2, d;
+
+    if ((x > GNSS_FAR) || (x < -GNSS_FAR) || (y > GNSS_FAR) || (y < -GNSS_FAR))
+        return false;
+    d2 = x * x + y * y;
+    d = gnss_isqrt(d2);
+
+    // Fixes further from the start than the end would lie beyond the segment
+    if ((_maxD > _error) && (_maxD > d))
+        return false;
+    if (!_open) {
+        int64_t ux = x;
+        int64_t uy = y;
+        shrink(&ux, &uy, DIR_BITS);
+        if (_empty || (d2 == 0) || !in_cone(ux, uy, _loX, _loY, _hiX, _hiY))
+            return false;
+    }
+    if (d > _maxD)
+        _maxD = d;
+
+    if (d <= _error)
+        return true;
+
+    // Tangents of the error circle, v rotated by +-asin(e / d) and scaled by d
+    int64_t e = _error;
+    int64_t vx = x;
+    int64_t vy = y;
+    while ((vx >= (1LL << 20)) || (vx <= -(1LL << 20)) || (vy >= (1LL << 20)) || (vy <= -(1LL << 20))) {
+        vx /= 2;
+        vy /= 2;
+        e /= 2;
+    }
+    int64_t s = gnss_isqrt(vx * vx + vy * vy - e * e);
+    int64_t loX = vx * s + vy * e;
+    int64_t loY = vy * s - vx * e;
+    int64_t hiX = vx * s - vy * e;
+    int64_t hiY = vy * s + vx * e;
+    shrink(&loX, &loY, DIR_BITS);
+    shrink(&hiX, &hiY, DIR_BITS);
+
+    if (_open) {
+        _loX = loX;
+        _loY = loY;
+        _hiX = hiX;
+        _hiY = hiY;
+        _open = false;
+        return true;
+    }
+
+    // Intersection, each limit is the one inside the other cone
+    bool lo2 = in_cone(loX, loY, _loX, _loY, _hiX, _hiY);
+    bool hi2 = in_cone(hiX, hiY, _loX, _loY, _hiX, _hiY);
+    bool lo1 = in_cone(_loX, _loY, loX, loY, hiX, hiY);
+    bool hi1 = in_cone(_hiX, _hiY, loX, loY, hiX, hiY);
+    if ((!lo2 && !lo1) || (!hi2 && !hi1)) {
+        _empty = true;
+        return true;
+    }
+    if (lo2) {
+        _loX = loX;
+        _loY = loY;
+    }
+    if (hi2) {
+        _hiX = hiX;
+        _hiY = hiY;
+    }
+    return true;
+}
+
+// End Of File
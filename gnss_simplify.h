@@ -0,0 +1,116 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GNSS_SIMPLIFY_H
+#define GNSS_SIMPLIFY_H
+
+/**
+ * @file gnss_simplify.h
+ * This file defines an online line simplification of the track. Only the
+ * fixes needed to keep every dropped fix within a maximum cross-track
+ * error of the kept polyline are passed on.
+ */
+
+#include "gnss.h"
+
+#define GNSS_SIMPLIFY_ERROR_M 10       // default maximum cross-track error
+#define GNSS_SIMPLIFY_MAX_S 300        // default maximum time between kept fixes
+
+typedef struct GNSS_SIMPLIFY_POINT {
+    uint32_t itow;       // GPS time of week (ms)
+    int32_t lat;         // scaling 1e-7
+    int32_t lon;         // scaling 1e-7
+    int32_t height;      // mm
+    int32_t speed;       // mm/s
+
+} tGNSS_SIMPLIFY_POINT;
+
+/** Sleeve (cone intersection) line simplification.
+ * The segment from the last kept fix is extended while its direction fits
+ * all fixes since then: every fix further than the error from the start
+ * narrows the cone of directions to the tangents of its error circle. A
+ * fix that leaves the cone ends the segment at the fix before. Constant
+ * memory and no allocation, a fix costs a few integer operations and a
+ * kept fix one cosine.
+ */
+class GnssTrackSimplifier
+{
+public:
+    /** Constructor.
+     * @param sink function receiving the kept fixes.
+     * @param error_m maximum cross-track error (m).
+     * @param max_s maximum time between kept fixes, 0: none.
+     */
+    GnssTrackSimplifier(Callback<void(const tGNSS_SIMPLIFY_POINT *)> sink,
+                        uint32_t error_m = GNSS_SIMPLIFY_ERROR_M, uint32_t max_s = GNSS_SIMPLIFY_MAX_S);
+
+    /** Add a navigation solution, invalid fixes are ignored.
+     * @param pvt the decoded UBX-NAV-PVT.
+     */
+    void add(const tUBX_NAV_PVT *pvt);
+
+    /** Add a batched fix, the speed is not part of UBX-LOG-BATCH and passed as 0.
+     * @param rec the decoded UBX-LOG-BATCH.
+     */
+    void add(const tUBX_LOG_BATCH *rec);
+
+    /** Add a fix.
+     * @param p the fix.
+     */
+    void add(const tGNSS_SIMPLIFY_POINT *p);
+
+    /** Pass the pending end of the current segment, e.g. at the end of a trip.
+     */
+    void flush(void);
+
+    /** Start over, the next fix is kept.
+     */
+    void reset(void);
+
+    /** Number of fixes added.
+     * @return the counter.
+     */
+    uint32_t added(void) const { return _added; }
+
+    /** Number of fixes kept.
+     * @return the counter.
+     */
+    uint32_t kept(void) const { return _kept; }
+
+private:
+    void _keep(const tGNSS_SIMPLIFY_POINT *p);
+    bool _fits(const tGNSS_SIMPLIFY_POINT *p);
+
+    Callback<void(const tGNSS_SIMPLIFY_POINT *)> _sink;
+    int64_t _error;                 //!< maximum error, 1e-7 deg of latitude
+    uint32_t _max_ms;
+    tGNSS_SIMPLIFY_POINT _anchor;   //!< last kept fix, start of the segment
+    tGNSS_SIMPLIFY_POINT _last;     //!< possible end of the segment
+    bool _haveAnchor;
+    bool _haveLast;
+    int32_t _cosQ;                  //!< longitude scale at the anchor
+    bool _open;                     //!< no direction constraint yet
+    bool _empty;                    //!< no direction fits all fixes
+    int64_t _loX, _loY;             //!< cone of directions, counter clockwise from lo to hi
+    int64_t _hiX, _hiY;
+    int64_t _maxD;                  //!< largest distance from the anchor
+    uint32_t _added;
+    uint32_t _kept;
+};
+
+#endif
+
+// End Of File
@@ -0,0 +1,129 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file gnss_stationary.cpp
+ * This file implements the stationary detection.
+ */
+
+#include "gnss_stationary.h"
+
+#define WEEK_MS 604800000
+#define FLAG_MASK 0xC3                              // gnssFixOK, diffSoln and carrSoln, not psmState and headVehValid
+
+static uint32_t elapsed(uint32_t from, uint32_t to)
+{
+    return (to >= from) ? to - from : to + WEEK_MS - from;
+}
+
+static bool valid(const tUBX_NAV_PVT *pvt)
+{
+    return ((pvt->fixType == 0x03) || (pvt->fixType == 0x04)) && (pvt->flag1 & 0x01);
+}
+
+GnssStationaryFilter::GnssStationaryFilter(Callback<void(const tUBX_NAV_PVT *, int)> sink, uint32_t speed,
+                                           uint32_t radius_m, uint32_t enter_s, uint32_t heartbeat_s) :
+    _sink(sink), _speed(speed), _radius2(GNSS_M_TO_UNITS(radius_m) * GNSS_M_TO_UNITS(radius_m)),
+    _enter_ms(enter_s * 1000), _heartbeat_ms(heartbeat_s * 1000), _added(0), _passed(0)
+{
+    reset();
+}
+
+void GnssStationaryFilter::reset(void)
+{
+    _stationary = false;
+    _haveLast = false;
+    _haveAnchor = false;
+    _fast = false;
+}
+
+int GnssStationaryFilter::add(const tUBX_NAV_PVT *pvt)
+{
+    int32_t speed = (pvt->speed < 0) ? -pvt->speed : pvt->speed;
+    uint8_t flags = pvt->flag1 & FLAG_MASK;
+
+    _added++;
+    // The same epoch again, e.g. from a second port
+    if (_haveLast && (pvt->itow == _lastItow))
+        return GNSS_STATIONARY_NONE;
+    _lastItow = pvt->itow;
+    _haveLast = true;
+
+    if (!_stationary) {
+        if (!valid(pvt) || (speed >= _speed) || !_haveAnchor ||
+            (pvt->fixType != _fixType) || (flags != _flags) || !_near(pvt)) {
+            _anchor(pvt);
+        } else if (elapsed(_since, pvt->itow) >= _enter_ms) {
+            _stationary = true;
+            _fast = false;
+            return _pass(pvt, GNSS_STATIONARY_START);
+        }
+        return _pass(pvt, GNSS_STATIONARY_MOVING);
+    }
+
+    // Without a valid fix motion can't be seen, stay stationary
+    if (valid(pvt)) {
+        bool fast = (speed >= _speed);
+        if (!_near(pvt) || (speed >= 2 * _speed) || (fast && _fast)) {
+            _stationary = false;
+            _anchor(pvt);
+            return _pass(pvt, GNSS_STATIONARY_END);
+        }
+        _fast = fast;
+    }
+    if ((pvt->fixType != _fixType) || (flags != _flags)) {
+        _fixType = pvt->fixType;
+        _flags = flags;
+        return _pass(pvt, GNSS_STATIONARY_FIX_CHANGE);
+    }
+    if (_heartbeat_ms && (elapsed(_sent, pvt->itow) >= _heartbeat_ms))
+        return _pass(pvt, GNSS_STATIONARY_HEARTBEAT);
+    return GNSS_STATIONARY_NONE;
+}
+
+int GnssStationaryFilter::_pass(const tUBX_NAV_PVT *pvt, int reason)
+{
+    _sent = pvt->itow;
+    _passed++;
+    _sink(pvt, reason);
+    return reason;
+}
+
+// The fix the following ones have to stay close to
+void GnssStationaryFilter::_anchor(const tUBX_NAV_PVT *pvt)
+{
+    _haveAnchor = valid(pvt);
+    if (!_haveAnchor)
+        return;
+    _lat = pvt->lat;
+    _lon = pvt->lon;
+    _cosQ = gnss_cos_q14(pvt->lat);
+    _since = pvt->itow;
+    _fixType = pvt->fixType;
+    _flags = pvt->flag1 & FLAG_MASK;
+}
+
+bool GnssStationaryFilter::_near(const tUBX_NAV_PVT *pvt) const
+{
+    int64_t y = (int64_t)pvt->lat - _lat;
+    int64_t x = (((int64_t)pvt->lon - _lon) * _cosQ) >> GNSS_COS_SHIFT;
+
+    if ((x > GNSS_FAR) || (x < -GNSS_FAR) || (y > GNSS_FAR) || (y < -GNSS_FAR))
+        return false;
+    return (x * x + y * y) <= _radius2;
+}
+
+// End Of File
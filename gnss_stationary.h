@@ -0,0 +1,117 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GNSS_STATIONARY_H
+#define GNSS_STATIONARY_H
+
+/**
+ * @file gnss_stationary.h
+ * This file defines a filter of the navigation solutions that detects a
+ * stationary receiver and then only passes heartbeats and state changes,
+ * and drops repeated solutions of the same epoch.
+ */
+
+#include "gnss.h"
+
+#define GNSS_STATIONARY_SPEED 300          // default speed limit (mm/s)
+#define GNSS_STATIONARY_RADIUS_M 15        // default position jitter limit
+#define GNSS_STATIONARY_ENTER_S 10         // default time still before stationary
+#define GNSS_STATIONARY_HEARTBEAT_S 60     // default time between heartbeats
+
+/** Reasons a solution is passed on
+*/
+enum eGNSS_STATIONARY_REASON {
+    GNSS_STATIONARY_NONE,                  // suppressed
+    GNSS_STATIONARY_MOVING,                // not stationary, every solution is passed
+    GNSS_STATIONARY_START,                 // the receiver became stationary
+    GNSS_STATIONARY_HEARTBEAT,             // still stationary
+    GNSS_STATIONARY_FIX_CHANGE,            // the fix type or flags changed while stationary
+    GNSS_STATIONARY_END                    // motion detected, the first solution of full rate
+};
+
+/** Stationary detection and duplicate suppression.
+ * The receiver is stationary when the speed stays below the limit, the
+ * position within the jitter radius of the first fix and the fix type and
+ * flags unchanged for the enter time. Motion is detected at once by a fix
+ * outside the radius or at twice the speed limit, or by two fixes in a row
+ * above the speed limit.
+ */
+class GnssStationaryFilter
+{
+public:
+    /** Constructor.
+     * @param sink function receiving the passed solutions and the eGNSS_STATIONARY_REASON.
+     * @param speed speed limit (mm/s).
+     * @param radius_m position jitter limit (m).
+     * @param enter_s time still before stationary.
+     * @param heartbeat_s time between heartbeats while stationary, 0: none.
+     */
+    GnssStationaryFilter(Callback<void(const tUBX_NAV_PVT *, int)> sink,
+                         uint32_t speed = GNSS_STATIONARY_SPEED, uint32_t radius_m = GNSS_STATIONARY_RADIUS_M,
+                         uint32_t enter_s = GNSS_STATIONARY_ENTER_S, uint32_t heartbeat_s = GNSS_STATIONARY_HEARTBEAT_S);
+
+    /** Filter a navigation solution.
+     * @param pvt the decoded UBX-NAV-PVT.
+     * @return the eGNSS_STATIONARY_REASON it was passed with, GNSS_STATIONARY_NONE if suppressed.
+     */
+    int add(const tUBX_NAV_PVT *pvt);
+
+    /** Start over, moving and with no previous solution.
+     */
+    void reset(void);
+
+    /** Check the state.
+     * @return true if stationary.
+     */
+    bool stationary(void) const { return _stationary; }
+
+    /** Number of solutions added.
+     * @return the counter.
+     */
+    uint32_t added(void) const { return _added; }
+
+    /** Number of solutions passed on.
+     * @return the counter.
+     */
+    uint32_t passed(void) const { return _passed; }
+
+private:
+    int _pass(const tUBX_NAV_PVT *pvt, int reason);
+    void _anchor(const tUBX_NAV_PVT *pvt);
+    bool _near(const tUBX_NAV_PVT *pvt) const;
+
+    Callback<void(const tUBX_NAV_PVT *, int)> _sink;
+    int32_t _speed;
+    int64_t _radius2;               //!< squared jitter limit, local units
+    uint32_t _enter_ms;
+    uint32_t _heartbeat_ms;
+    bool _stationary;
+    bool _haveLast;
+    bool _haveAnchor;
+    uint32_t _lastItow;             //!< epoch of the last solution, for duplicates
+    uint8_t _fixType, _flags;       //!< fix of the anchor
+    int32_t _lat, _lon;             //!< anchor, first still fix
+    int32_t _cosQ;                  //!< longitude scale at the anchor
+    uint32_t _since;                //!< iTOW of the anchor
+    uint32_t _sent;                 //!< iTOW of the last passed solution
+    bool _fast;                     //!< the last fix was above the speed limit
+    uint32_t _added;
+    uint32_t _passed;
+};
+
+#endif
+
+// End Of File
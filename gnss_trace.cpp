@@ -0,0 +1,89 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file gnss_trace.cpp
+ * This file implements the deferred binary trace.
+ */
+
+#include "mbed.h"
+#include "gnss_trace.h"
+
+volatile uint32_t GnssTrace::_head = 0;
+uint32_t GnssTrace::_tail = 0;
+uint32_t GnssTrace::_lost = 0;
+GnssTrace::tSLOT GnssTrace::_ring[GNSS_TRACE_RING];
+
+void GnssTrace::write(const char *fmt, uint32_t a0, uint32_t a1)
+{
+    // Also interrupt safe on cores without LDREX/STREX (Cortex-M0+), where
+    // std::atomic would need the missing __atomic_fetch_add_4
+    uint32_t ix = core_util_atomic_incr_u32(&_head, 1) - 1;
+    tSLOT *s = &_ring[ix % GNSS_TRACE_RING];
+
+    s->seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s->e.fmt = fmt;
+    s->e.time = us_ticker_read();
+    s->e.arg[0] = a0;
+    s->e.arg[1] = a1;
+    s->seq.store(ix + 1, std::memory_order_release);
+}
+
+bool GnssTrace::read(tGNSS_TRACE_ENTRY *e)
+{
+    for (;;) {
+        uint32_t head = _head;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (_tail == head)
+            return false;
+        if ((head - _tail) > GNSS_TRACE_RING) {
+            _lost += head - _tail - GNSS_TRACE_RING;
+            _tail = head - GNSS_TRACE_RING;
+        }
+
+        tSLOT *s = &_ring[_tail % GNSS_TRACE_RING];
+        uint32_t seq = s->seq.load(std::memory_order_acquire);
+        if ((seq == 0) || ((int32_t)(seq - (_tail + 1)) < 0))
+            return false;           // writer still busy, try again later
+        if (seq == _tail + 1) {
+            *e = s->e;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (s->seq.load(std::memory_order_relaxed) == seq) {
+                _tail++;
+                return true;
+            }
+        }
+        // Overwritten while reading
+        _lost++;
+        _tail++;
+    }
+}
+
+int GnssTrace::print(FILE *fp)
+{
+    tGNSS_TRACE_ENTRY e;
+    int n = 0;
+
+    while (read(&e)) {
+        fprintf(fp, "%10lu ", (unsigned long)e.time);
+        fprintf(fp, e.fmt, e.arg[0], e.arg[1]);
+        n++;
+    }
+    return n;
+}
+
+// End Of File
@@ -0,0 +1,109 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GNSS_TRACE_H
+#define GNSS_TRACE_H
+
+/**
+ * @file gnss_trace.h
+ * This file defines a deferred binary trace. A trace entry holds the
+ * address of the format string, a time stamp and up to two arguments; the
+ * text is only formatted when the ring is drained, by a low priority task
+ * or on the host (the address is resolved with the map file of the image).
+ *
+ * Define GNSS_TRACE_LEVEL to route SEND_LOGGING_MESSAGE into the trace.
+ * Entries above the level are removed by the compiler, arguments included.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+
+#define GNSS_TRACE_NONE  0
+#define GNSS_TRACE_ERROR 1
+#define GNSS_TRACE_INFO  2
+#define GNSS_TRACE_DEBUG 3
+
+#ifndef GNSS_TRACE_RING
+#define GNSS_TRACE_RING 64   // entries, power of two
+#endif
+
+/** Add a trace entry, e.g. GNSS_TRACE(GNSS_TRACE_DEBUG, "baud %d\r\n", rate).
+ */
+#ifdef GNSS_TRACE_LEVEL
+#define GNSS_TRACE(level, ...) do { if ((level) <= GNSS_TRACE_LEVEL) GnssTrace::write(__VA_ARGS__); } while (0)
+#else
+#define GNSS_TRACE(level, ...) do { } while (0)
+#endif
+
+/** Replacement of SEND_LOGGING_MESSAGE when GNSS_TRACE_LEVEL is defined.
+ */
+#define GNSS_TRACE_MESSAGE(...) GNSS_TRACE(GNSS_TRACE_INFO, __VA_ARGS__)
+
+typedef struct GNSS_TRACE_ENTRY {
+    const char *fmt;   // format string, also the message id
+    uint32_t time;     // us_ticker_read()
+    uint32_t arg[2];
+
+} tGNSS_TRACE_ENTRY;
+
+/** Trace ring.
+ * Any number of writers (threads and interrupts) never wait, one reader
+ * drains the ring. When the ring is full the oldest entries are
+ * overwritten and counted as lost.
+ */
+class GnssTrace
+{
+public:
+    /** Add an entry.
+     * @param fmt the format string, must be a string literal.
+     * @param a0 first argument.
+     * @param a1 second argument.
+     */
+    static void write(const char *fmt, uint32_t a0 = 0, uint32_t a1 = 0);
+
+    /** Take the oldest entry (single reader).
+     * @param e the entry to fill.
+     * @return true if an entry was read, false if the ring is empty.
+     */
+    static bool read(tGNSS_TRACE_ENTRY *e);
+
+    /** Format and print all pending entries, call from a low priority task.
+     * @param fp the output.
+     * @return number of entries printed.
+     */
+    static int print(FILE *fp = stdout);
+
+    /** Number of entries overwritten before they were read.
+     * @return the counter.
+     */
+    static uint32_t lost(void) { return _lost; }
+
+private:
+    typedef struct {
+        std::atomic<uint32_t> seq;   //!< index + 1 once complete, 0 while written
+        tGNSS_TRACE_ENTRY e;
+    } tSLOT;
+
+    static volatile uint32_t _head;  //!< entries started, core_util_atomic_incr_u32()
+    static uint32_t _tail;
+    static uint32_t _lost;
+    static tSLOT _ring[GNSS_TRACE_RING];
+};
+
+#endif
+
+// End Of File
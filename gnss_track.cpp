@@ -0,0 +1,209 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file gnss_track.cpp
+ * This file implements the compact binary track format.
+ */
+
+#include "gnss_track.h"
+
+#define GNSS_TRACK_CRC_OFFSET 8
+#define MS_PER_DAY 86400000UL
+
+static inline int put_varint(uint8_t *p, int32_t v)
+{
+    uint32_t z = ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);   // zigzag
+    int n = 0;
+
+    while (z >= 0x80) {
+        p[n++] = (uint8_t)(z | 0x80);
+        z >>= 7;
+    }
+    p[n++] = (uint8_t)z;
+    return n;
+}
+
+static long gps_days(int year, int month, int day)
+{
+    // Days since 1 March of year 0, then since 6 January 1980
+    int y = year - (month <= 2);
+    int m = (month + 9) % 12;
+    long days = 365L * y + y / 4 - y / 100 + y / 400 + (153 * m + 2) / 5 + day - 1;
+    long epoch = 365L * 1979 + 1979 / 4 - 1979 / 100 + 1979 / 400 + (153 * 10 + 2) / 5 + 6 - 1;
+
+    return days - epoch;
+}
+
+#ifdef __MBED__
+
+// ----------------------------------------------------------------
+// Encoder
+// ----------------------------------------------------------------
+
+GnssTrackEncoder::GnssTrackEncoder(Callback<void(const uint8_t *, int)> sink) :
+    _sink(sink), _week(0), _bytes(0)
+{
+    _reset();
+}
+
+void GnssTrackEncoder::_reset(void)
+{
+    _len = GNSS_TRACK_HEADER_SIZE;
+    _count = 0;
+    _itow = 0;
+    _dItow = 0;
+    _lat = 0;
+    _lon = 0;
+    _height = 0;
+    _speed = 0;
+}
+
+void GnssTrackEncoder::set_week(uint16_t week)
+{
+    // The week is part of the block header
+    if ((week != _week) && _count)
+        flush();
+    _week = week;
+}
+
+void GnssTrackEncoder::add(const tUBX_NAV_PVT *pvt)
+{
+    // validDate and validTime
+    if ((pvt->valid & 0x03) != 0x03)
+        return;
+    set_week(gps_week(pvt));
+    add(pvt->itow, pvt->lat, pvt->lon, pvt->height, pvt->speed);
+}
+
+void GnssTrackEncoder::add(const tUBX_LOG_BATCH *rec)
+{
+    add(rec->itow, rec->lat, rec->lon, rec->height, 0);
+}
+
+void GnssTrackEncoder::add(uint32_t itow, int32_t lat, int32_t lon, int32_t height, int32_t speed)
+{
+    if ((_count == GNSS_TRACK_MAX_RECORDS) || ((_len + GNSS_TRACK_MAX_RECORD_SIZE) > GNSS_TRACK_BLOCK_SIZE))
+        flush();
+
+    uint32_t dItow = itow - _itow;
+    _len += put_varint(&_block[_len], (int32_t)(dItow - _dItow));
+    _len += put_varint(&_block[_len], (int32_t)((uint32_t)lat - (uint32_t)_lat));
+    _len += put_varint(&_block[_len], (int32_t)((uint32_t)lon - (uint32_t)_lon));
+    _len += put_varint(&_block[_len], (int32_t)((uint32_t)height - (uint32_t)_height));
+    _len += put_varint(&_block[_len], (int32_t)((uint32_t)speed - (uint32_t)_speed));
+    _itow = itow;
+    _dItow = dItow;
+    _lat = lat;
+    _lon = lon;
+    _height = height;
+    _speed = speed;
+    _count++;
+}
+
+void GnssTrackEncoder::flush(void)
+{
+    uint16_t length = _len - GNSS_TRACK_HEADER_SIZE;
+    uint32_t crc;
+
+    if (_count == 0)
+        return;
+    _block[0] = 'G';
+    _block[1] = 'T';
+    _block[2] = GNSS_TRACK_VERSION;
+    _block[3] = _count;
+    _block[4] = _week & 0xFF;
+    _block[5] = (_week >> 8) & 0xFF;
+    _block[6] = length & 0xFF;
+    _block[7] = (length >> 8) & 0xFF;
+    crc = gnss_crc32(0, _block, GNSS_TRACK_CRC_OFFSET);
+    crc = gnss_crc32(crc, &_block[GNSS_TRACK_HEADER_SIZE], length);
+    for (int i = 0; i < 4; i++)
+        _block[GNSS_TRACK_CRC_OFFSET + i] = (crc >> (8 * i)) & 0xFF;
+
+    _sink(_block, _len);
+    _bytes += _len;
+    _reset();
+}
+
+uint16_t GnssTrackEncoder::gps_week(const tUBX_NAV_PVT *pvt)
+{
+    long days = gps_days(pvt->year, pvt->month, pvt->day);
+    uint16_t week = (uint16_t)(days / 7);
+    uint32_t utcTow = (uint32_t)(days % 7) * MS_PER_DAY +
+                      ((pvt->hour * 60UL + pvt->min) * 60UL + pvt->sec) * 1000UL;
+
+    // GPS time already in the next week while the UTC date is not
+    if ((pvt->itow + (MS_PER_DAY * 7 / 2)) < utcTow)
+        week++;
+    return week;
+}
+
+#endif
+
+// ----------------------------------------------------------------
+// Decoder
+// ----------------------------------------------------------------
+
+int GnssTrackDecoder::decode(const uint8_t *buf, int len, tGNSS_TRACK_COLUMNS *out)
+{
+    if (len < GNSS_TRACK_HEADER_SIZE)
+        return 0;
+    if ((buf[0] != 'G') || (buf[1] != 'T') || (buf[2] != GNSS_TRACK_VERSION) ||
+            (buf[3] == 0) || (buf[3] > GNSS_TRACK_MAX_RECORDS))
+        return -1;
+
+    int count = buf[3];
+    int length = buf[6] | (buf[7] << 8);
+    uint32_t crc = buf[8] | (buf[9] << 8) | (buf[10] << 16) | ((uint32_t)buf[11] << 24);
+    if (len < GNSS_TRACK_HEADER_SIZE + length)
+        return 0;
+    if (gnss_crc32(gnss_crc32(0, buf, GNSS_TRACK_CRC_OFFSET), &buf[GNSS_TRACK_HEADER_SIZE], length) != crc)
+        return -1;
+
+    // Pass 1: varints to delta columns
+    const uint8_t *p = &buf[GNSS_TRACK_HEADER_SIZE];
+    const uint8_t *end = p + length;
+    int32_t *cols[5] = { (int32_t *)out->itow, out->lat, out->lon, out->height, out->speed };
+    for (int i = 0; i < count; i++) {
+        for (int c = 0; c < 5; c++) {
+            int n = get_varint(p, end, &cols[c][i]);
+            if (n < 0)
+                return -1;
+            p += n;
+        }
+    }
+
+    // Pass 2: prefix sums, iTOW twice as it holds the delta of delta
+    for (int c = 0; c < 5; c++) {
+        uint32_t *col = (uint32_t *)cols[c];
+        for (int i = 1; i < count; i++)
+            col[i] += col[i - 1];
+    }
+    for (int i = 1; i < count; i++)
+        out->itow[i] += out->itow[i - 1];
+
+    out->count = count;
+    out->week = buf[4] | (buf[5] << 8);
+    return GNSS_TRACK_HEADER_SIZE + length;
+}
+
+uint16_t GnssTrackDecoder::gps_week(int year, int month, int day)
+{
+    return (uint16_t)(gps_days(year, month, day) / 7);
+}
+
+// End Of File
@@ -0,0 +1,182 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GNSS_TRACK_H
+#define GNSS_TRACK_H
+
+/**
+ * @file gnss_track.h
+ * This file defines a compact binary track format. A track is a sequence
+ * of independent blocks:
+ *
+ *   header  'G' 'T' version count week(U2) length(U2) crc32(U4)
+ *           the CRC covers the first 8 header bytes and the records
+ *   records iTOW delta of delta, then lat, lon, height and speed deltas,
+ *           each as zigzag varint
+ *
+ * The deltas restart at zero in every block, so a block can be decoded
+ * without the ones before it. The format and the decoder only need
+ * gnss_framer.h and also build on the host, the encoder needs mbed.
+ */
+
+#include "gnss_framer.h"
+#ifdef __MBED__
+#include "gnss.h"
+#endif
+
+#define GNSS_TRACK_VERSION 2
+#define GNSS_TRACK_HEADER_SIZE 12
+#define GNSS_TRACK_BLOCK_SIZE 512      // header included
+#define GNSS_TRACK_MAX_RECORDS 128     // records per block
+#define GNSS_TRACK_MAX_RECORD_SIZE 25  // 5 varints of up to 5 bytes
+
+/** Decoded block, one array per field
+*/
+typedef struct GNSS_TRACK_COLUMNS {
+    int count;
+    uint16_t week;   // GPS week of the first record, 0 if unknown
+    uint32_t itow[GNSS_TRACK_MAX_RECORDS];
+    int32_t lat[GNSS_TRACK_MAX_RECORDS];     // scaling 1e-7
+    int32_t lon[GNSS_TRACK_MAX_RECORDS];     // scaling 1e-7
+    int32_t height[GNSS_TRACK_MAX_RECORDS];  // mm
+    int32_t speed[GNSS_TRACK_MAX_RECORDS];   // mm/s
+
+} tGNSS_TRACK_COLUMNS;
+
+#ifdef __MBED__
+
+/** Streaming track encoder.
+ * Uses a single block buffer and passes every completed block to the sink.
+ */
+class GnssTrackEncoder
+{
+public:
+    /** Constructor.
+     * @param sink function receiving the completed blocks.
+     */
+    GnssTrackEncoder(Callback<void(const uint8_t *, int)> sink);
+
+    /** Set the GPS week of the following records, needed for records
+     * without a date (UBX-LOG-BATCH).
+     * @param week the GPS week.
+     */
+    void set_week(uint16_t week);
+
+    /** Add a fix, the GPS week is derived from the UTC date and time and
+     * the iTOW. Fixes without a valid date and time are skipped.
+     * @param pvt the decoded UBX-NAV-PVT.
+     */
+    void add(const tUBX_NAV_PVT *pvt);
+
+    /** Add a batched fix, the speed is not part of UBX-LOG-BATCH and stored as 0.
+     * @param rec the decoded UBX-LOG-BATCH.
+     */
+    void add(const tUBX_LOG_BATCH *rec);
+
+    /** Add a fix.
+     * @param itow GPS time of week (ms).
+     * @param lat latitude, scaling 1e-7 deg.
+     * @param lon longitude, scaling 1e-7 deg.
+     * @param height height (mm).
+     * @param speed ground speed (mm/s).
+     */
+    void add(uint32_t itow, int32_t lat, int32_t lon, int32_t height, int32_t speed);
+
+    /** Pass the current block to the sink even if not full.
+     */
+    void flush(void);
+
+    /** GPS week of a fix. The UTC date is behind the GPS time by the leap
+     * seconds, so the week is corrected when the iTOW already wrapped.
+     * @param pvt the decoded UBX-NAV-PVT with a valid date and time.
+     * @return the GPS week.
+     */
+    static uint16_t gps_week(const tUBX_NAV_PVT *pvt);
+
+    /** Number of bytes passed to the sink so far.
+     * @return the counter.
+     */
+    uint32_t bytes(void) const { return _bytes; }
+
+private:
+    void _reset(void);
+
+    Callback<void(const uint8_t *, int)> _sink;
+    uint8_t _block[GNSS_TRACK_BLOCK_SIZE];
+    int _len;
+    int _count;
+    uint16_t _week;
+    uint32_t _bytes;
+    uint32_t _itow;     //!< previous values
+    uint32_t _dItow;
+    int32_t _lat, _lon, _height, _speed;
+};
+
+#endif
+
+/** Track decoder.
+ * Works in two passes: the varints are expanded into delta columns, then
+ * one prefix sum per column restores the values. The second pass has no
+ * dependencies between the columns and vectorises on the host.
+ */
+class GnssTrackDecoder
+{
+public:
+    /** Decode one block.
+     * @param buf the data, starting with a block header.
+     * @param len the length of the data.
+     * @param out the columns to fill.
+     * @return length of the block, 0 if more data is needed, -1 if the
+     *         block is invalid.
+     */
+    static int decode(const uint8_t *buf, int len, tGNSS_TRACK_COLUMNS *out);
+
+    /** Read one zigzag varint of the records.
+     * @param p the first byte.
+     * @param end the end of the data.
+     * @param v the decoded value.
+     * @return number of bytes read, -1 if the varint is truncated or too long.
+     */
+    static inline int get_varint(const uint8_t *p, const uint8_t *end, int32_t *v)
+    {
+        uint32_t z = 0;
+        int n = 0;
+
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (p + n >= end)
+                return -1;
+            uint8_t b = p[n++];
+            z |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) {
+                *v = (int32_t)((z >> 1) ^ (0 - (z & 1)));
+                return n;
+            }
+        }
+        return -1;
+    }
+
+    /** GPS week of a UTC date.
+     * @param year the year.
+     * @param month the month 1..12.
+     * @param day the day 1..31.
+     * @return the GPS week.
+     */
+    static uint16_t gps_week(int year, int month, int day);
+};
+
+#endif
+
+// End Of File
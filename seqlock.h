@@ -0,0 +1,95 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2017 u-blox
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+/** seqlock, this class publishes the latest value of a plain struct from
+    a single writer to any number of readers. The writer never waits for
+    the readers, readers never take a lock and retry if they raced with
+    the writer.
+*/
+#include <string.h>
+#include <stdint.h>
+#include <atomic>
+
+template <class T>
+class SeqLock
+{
+public:
+    /* Constructor
+    */
+    SeqLock(void) : _seq(0)
+    {
+        memset(&_v, 0, sizeof(_v));
+    }
+
+    // writing thread/context API (single writer)
+    //-------------------------------------------------------------
+
+    /** Publish a new value.
+        \param v the value to publish.
+    */
+    void write(const T& v)
+    {
+        uint32_t s = _seq.load(std::memory_order_relaxed);
+        _seq.store(s + 1, std::memory_order_relaxed); // odd: write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&_v, &v, sizeof(T));
+        _seq.store(s + 2, std::memory_order_release);
+    }
+
+    // reading threads API
+    // --------------------------------------------------------
+
+    /** Read the latest value.
+        \param v the value read.
+        \param retries number of retries if the writer was active.
+        \return true if a consistent value was read, false if nothing
+                was published yet or the writer was busy on all retries.
+    */
+    bool read(T& v, int retries = 8) const
+    {
+        do {
+            uint32_t s1 = _seq.load(std::memory_order_acquire);
+            if (s1 & 1)
+                continue;
+            memcpy(&v, &_v, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint32_t s2 = _seq.load(std::memory_order_relaxed);
+            if (s1 == s2)
+                return (s1 != 0);
+        } while (retries-- > 0);
+        return false;
+    }
+
+    /** Get the number of values published so far, can be used by a
+        reader to check for a new value without copying it.
+        \return the number of published values.
+    */
+    uint32_t sequence(void) const
+    {
+        return _seq.load(std::memory_order_acquire) >> 1;
+    }
+
+private:
+    std::atomic<uint32_t> _seq; //!< sequence, odd while a write is in progress
+    T                     _v;   //!< the value
+};
+
+#endif
+
+// End Of File